@@ -0,0 +1,864 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "st_json.h"
+#include "st_json_bind.h"
+#include "st_json_reader.h"
+using namespace std;
+using namespace ST_JSON;
+
+/* keeps the optimizer from dropping the measured work */
+static volatile size_t gSink = 0;
+
+/*
+ * Allocations are counted by taking over malloc, realloc and calloc, which glibc lets a program do,
+ * and only while CountAllocs runs, so the timed loops pay no more than a load. Sanitizers replace
+ * them themselves.
+ */
+#if !defined(__GLIBC__) || defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define ST_JSON_BENCH_NO_ALLOC_COUNT
+#endif
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(memory_sanitizer) || __has_feature(thread_sanitizer)
+#define ST_JSON_BENCH_NO_ALLOC_COUNT
+#endif
+#endif
+
+static atomic<bool> gCounting(false);
+static atomic<size_t> gAllocs(0);
+
+#ifndef ST_JSON_BENCH_NO_ALLOC_COUNT
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_calloc(size_t count, size_t size);
+
+void* malloc(size_t size) noexcept {
+	if (gCounting.load(memory_order_relaxed))
+		gAllocs.fetch_add(1, memory_order_relaxed);
+	return __libc_malloc(size);
+}
+
+void* realloc(void* ptr, size_t size) noexcept {
+	if (gCounting.load(memory_order_relaxed))
+		gAllocs.fetch_add(1, memory_order_relaxed);
+	return __libc_realloc(ptr, size);
+}
+
+void* calloc(size_t count, size_t size) noexcept {
+	if (gCounting.load(memory_order_relaxed))
+		gAllocs.fetch_add(1, memory_order_relaxed);
+	return __libc_calloc(count, size);
+}
+}
+#endif
+
+/* the allocations one call of f makes, -1 where they cannot be counted */
+template <typename F>
+static double CountAllocs(F&& f) {
+#ifdef ST_JSON_BENCH_NO_ALLOC_COUNT
+	f();
+	return -1.0;
+#else
+	gAllocs.store(0);
+	gCounting.store(true);
+	f();
+	gCounting.store(false);
+	return static_cast<double>(gAllocs.load());
+#endif
+}
+
+template <typename F>
+static double MeasureSeconds(size_t iterations, F&& f) {
+	auto begin = chrono::steady_clock::now();
+	for (size_t i = 0; i < iterations; ++i)
+		f();
+	auto end = chrono::steady_clock::now();
+	return chrono::duration<double>(end - begin).count();
+}
+
+struct BenchResult {
+	string _name;
+	size_t _bytes;
+	size_t _iterations;
+	double _seconds;
+	double _allocs; /* per op, -1 if not counted */
+};
+
+/* every line reported, for the results file */
+static vector<BenchResult> gResults;
+
+static void Report(const char* name, size_t bytes, size_t iterations, double seconds, double allocs = -1.0) {
+	printf("%-28s %10.1f MB/s %12.0f ns/op", name, bytes * iterations / seconds / (1024.0 * 1024.0),
+	       seconds * 1e9 / iterations);
+	if (allocs >= 0.0)
+		printf(" %10.0f allocs/op", allocs);
+	printf("\n");
+	BenchResult result = { name, bytes, iterations, seconds, allocs };
+	gResults.push_back(result);
+}
+
+/* a JSON array of every result, so two runs can be compared by name */
+static bool WriteResults(const char* path) {
+	FILE* f = fopen(path, "wb");
+	if (!f)
+		return false;
+	JsonWriter writer;
+	writer.Init(f);
+	writer.StartArray();
+	for (size_t i = 0; i < gResults.size(); ++i) {
+		const BenchResult& r = gResults[i];
+		writer.StartObject();
+		writer.Key("name", 4);
+		writer.String(r._name.data(), r._name.size());
+		writer.Key("bytes", 5);
+		writer.Number(static_cast<double>(r._bytes));
+		writer.Key("iterations", 10);
+		writer.Number(static_cast<double>(r._iterations));
+		writer.Key("mb_per_s", 8);
+		writer.Number(r._bytes * r._iterations / r._seconds / (1024.0 * 1024.0));
+		writer.Key("ns_per_op", 9);
+		writer.Number(r._seconds * 1e9 / r._iterations);
+		writer.Key("allocs_per_op", 13);
+		if (r._allocs >= 0.0)
+			writer.Number(r._allocs);
+		else
+			writer.Null();
+		writer.EndObject();
+	}
+	writer.EndArray();
+	bool ok = writer.Flush();
+	writer.Free();
+	return fclose(f) == 0 && ok;
+}
+
+/* parse and Free timed apart; the allocations are those of one parse */
+static void BenchParse(const char* name, const string& json, size_t iterations) {
+	JsonValue v;
+	v.Init();
+	RetType ret;
+	double allocs = CountAllocs([&]() {
+		ret = JsonParse(&v, json.c_str());
+	});
+	if (ret != RetType::PARSE_OK) {
+		printf("%-28s parse failed\n", name);
+		return;
+	}
+	v.Free();
+	double parse = 0.0, release = 0.0;
+	for (size_t i = 0; i < iterations; ++i) {
+		JsonValue value;
+		value.Init();
+		parse += MeasureSeconds(1, [&]() {
+			JsonParse(&value, json.c_str());
+			gSink += GetType(&value) == JsonType::JSON_ARRAY ? GetArraySize(&value) : 0;
+		});
+		release += MeasureSeconds(1, [&]() {
+			value.Free();
+		});
+	}
+	Report(name, json.size(), iterations, parse, allocs);
+	char label[64];
+	snprintf(label, sizeof(label), "free %s", name + (strncmp(name, "parse ", 6) == 0 ? 6 : 0));
+	Report(label, json.size(), iterations, release);
+}
+
+/* the allocations are those of the first parse; later ones reuse the arena */
+static void BenchParseDocument(const char* name, const string& json, size_t iterations) {
+	JsonDocument doc;
+	doc.Init();
+	double allocs = CountAllocs([&]() {
+		JsonParse(&doc, json.c_str());
+	});
+	double seconds = MeasureSeconds(iterations, [&]() {
+		JsonParse(&doc, json.c_str());
+		gSink += GetType(&doc._root) == JsonType::JSON_ARRAY ? GetArraySize(&doc._root) : 0;
+	});
+	Report(name, json.size(), iterations, seconds, allocs);
+	doc.Free();
+}
+
+/* heap blocks and bytes a tree from JsonParse holds; short strings live in their value */
+static void CountTree(const JsonValue* v, size_t* blocks, size_t* bytes) {
+	switch (GetType(v)) {
+		case JsonType::JSON_STRING:
+			if (!(v->_flags & JSON_VALUE_SHORT)) {
+				++*blocks;
+				*bytes += GetStringSize(v) + 1;
+			}
+			break;
+		case JsonType::JSON_ARRAY:
+			*blocks += GetArraySize(v) != 0;
+			*bytes += GetArraySize(v) * sizeof(JsonValue);
+			for (size_t i = 0; i < GetArraySize(v); ++i)
+				CountTree(GetArrayElement(v, i), blocks, bytes);
+			break;
+		case JsonType::JSON_OBJECT:
+			*blocks += GetObjSize(v) != 0;
+			*bytes += GetObjSize(v) * sizeof(JsonObjMember);
+			for (size_t i = 0; i < GetObjSize(v); ++i) {
+				++*blocks;
+				*bytes += GetObjKeySize(v, i) + 1;
+				CountTree(GetObjValue(v, i), blocks, bytes);
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+/* for a JsonValue or a JsonFrozenValue, the accessors are the same */
+template <typename V>
+static double SumTree(const V* v) {
+	double sum = 0.0;
+	switch (GetType(v)) {
+		case JsonType::JSON_NUMBER: return GetNumber(v);
+		case JsonType::JSON_STRING: return static_cast<double>(GetStringSize(v) + GetString(v)[0]);
+		case JsonType::JSON_ARRAY:
+			for (size_t i = 0; i < GetArraySize(v); ++i)
+				sum += SumTree(GetArrayElement(v, i));
+			return sum;
+		case JsonType::JSON_OBJECT:
+			for (size_t i = 0; i < GetObjSize(v); ++i)
+				sum += SumTree(GetObjValue(v, i));
+			return sum;
+		default: return 1.0;
+	}
+}
+
+/* reads every number and string of a parsed tree, and reports what the tree costs in memory */
+static void BenchTraverse(const char* name, const string& json, size_t iterations) {
+	JsonValue v;
+	v.Init();
+	JsonParse(&v, json.c_str());
+	size_t blocks = 0, bytes = sizeof(JsonValue);
+	CountTree(&v, &blocks, &bytes);
+	double seconds = MeasureSeconds(iterations, [&]() {
+		gSink += static_cast<size_t>(SumTree(&v));
+	});
+	Report(name, json.size(), iterations, seconds);
+	printf("%-28s %10.1f MB %12zu blocks\n", "  tree", bytes / (1024.0 * 1024.0), blocks);
+	v.Free();
+}
+
+/* how many of the keys parsed into a document were already stored */
+static void ReportKeys(const char* name, const string& json) {
+	JsonDocument doc;
+	JsonKeyStats stats;
+	doc.Init();
+	JsonParse(&doc, json.c_str());
+	GetKeyStats(&doc, &stats);
+	printf("%-28s %9.1f%% of %zu keys shared, %zu distinct\n", name, stats._hitRate * 100.0, stats._lookups,
+	       stats._distinct);
+	doc.Free();
+}
+
+/* the input is destroyed by every parse, so each iteration restores it first */
+static void BenchParseInsitu(const char* name, const string& json, size_t iterations) {
+	JsonDocument doc;
+	doc.Init();
+	string buffer = json;
+	double seconds = MeasureSeconds(iterations, [&]() {
+		memcpy(&buffer[0], json.data(), json.size());
+		JsonParseInsitu(&doc, &buffer[0]);
+		gSink += GetType(&doc._root) == JsonType::JSON_ARRAY ? GetArraySize(&doc._root) : 0;
+	});
+	Report(name, json.size(), iterations, seconds);
+	doc.Free();
+}
+
+/* feeds the input in TCP-segment-sized chunks */
+static void BenchParsePush(const char* name, const string& json, size_t iterations) {
+	const size_t chunk = 1460;
+	double seconds = MeasureSeconds(iterations, [&]() {
+		JsonValue value;
+		JsonPushParser parser;
+		parser.Init(&value);
+		for (size_t i = 0; i < json.size(); i += chunk)
+			parser.Feed(json.data() + i, chunk < json.size() - i ? chunk : json.size() - i);
+		parser.Finish();
+		gSink += GetType(&value) == JsonType::JSON_ARRAY ? GetArraySize(&value) : 0;
+		parser.Free();
+		value.Free();
+	});
+	Report(name, json.size(), iterations, seconds);
+}
+
+static bool CountLine(JsonLine* line, void* user) {
+	*static_cast<size_t*>(user) += line->_ret == RetType::PARSE_OK;
+	return true;
+}
+
+static void BenchParseLines(const char* name, const string& json, size_t threads, size_t iterations) {
+	double seconds = MeasureSeconds(iterations, [&]() {
+		size_t good = 0;
+		JsonParseLines(json.data(), json.size(), threads, CountLine, &good);
+		gSink += good;
+	});
+	Report(name, json.size(), iterations, seconds);
+}
+
+static void BenchParseIndexed(const char* name, const string& json, size_t threads, size_t iterations) {
+	double seconds = MeasureSeconds(iterations, [&]() {
+		JsonValue value;
+		JsonParseIndexed(&value, json.data(), json.size(), threads);
+		gSink += GetType(&value) == JsonType::JSON_ARRAY ? GetArraySize(&value) : 0;
+		value.Free();
+	});
+	Report(name, json.size(), iterations, seconds);
+}
+
+/* reads four fields of every record, the access pattern lazy parsing is for */
+static void BenchParseLazy(const char* name, const string& json, size_t iterations) {
+	const char* fields[] = { "id", "f17", "f123", "f199" };
+	JsonLazyDocument doc;
+	doc.Init();
+	double seconds = MeasureSeconds(iterations, [&]() {
+		JsonParseLazy(&doc, json.data(), json.size());
+		const JsonLazyValue* root = GetLazyRoot(&doc);
+		for (size_t i = 0; i < GetLazyArraySize(&doc, root); ++i) {
+			const JsonLazyValue* record = GetLazyArrayElement(&doc, root, i);
+			for (size_t j = 0; j < 4; ++j)
+				gSink += GetType(GetLazyValue(&doc, FindLazyObjValue(&doc, record, fields[j], strlen(fields[j]))))
+					== JsonType::JSON_STRING;
+		}
+	});
+	Report(name, json.size(), iterations, seconds);
+	doc.Free();
+}
+
+/* builds only what the paths select; the rest of the input is walked over or skipped by brackets */
+static void BenchParseProjected(const char* name, const string& json, const char* const* paths, size_t count,
+                                size_t iterations) {
+	JsonPathSet set;
+	JsonProjection proj;
+	set.Init();
+	proj.Init();
+	JsonCompilePaths(&set, paths, count);
+	double seconds = MeasureSeconds(iterations, [&]() {
+		JsonParseProjected(&proj, &set, json.data(), json.size());
+		gSink += GetMatchCount(&proj);
+	});
+	Report(name, json.size(), iterations, seconds);
+	set.Free();
+	proj.Free();
+}
+
+/*
+ * Looks up every key of one object of the given width, first by comparing keys in order the way
+ * callers did before FindObjValue, then through it. Reports the cost of a single lookup.
+ */
+static void BenchFindObj(size_t width, size_t rounds) {
+	string json = "{";
+	for (size_t i = 0; i < width; ++i)
+		json += (i ? ",\"field_" : "\"field_") + to_string(i) + "\":" + to_string(i);
+	json += "}";
+	JsonValue v;
+	v.Init();
+	JsonParse(&v, json.c_str());
+	string keys[1024];
+	for (size_t i = 0; i < width; ++i)
+		keys[i] = "field_" + to_string(i * 7 % width);
+	double scan = MeasureSeconds(rounds, [&]() {
+		for (size_t i = 0; i < width; ++i) {
+			for (size_t j = 0; j < GetObjSize(&v); ++j) {
+				if (GetObjKeySize(&v, j) == keys[i].size() && memcmp(GetObjKey(&v, j), keys[i].data(), keys[i].size()) == 0) {
+					gSink += j;
+					break;
+				}
+			}
+		}
+	});
+	double find = MeasureSeconds(rounds, [&]() {
+		for (size_t i = 0; i < width; ++i)
+			gSink += FindObjIndex(&v, keys[i].data(), keys[i].size());
+	});
+	printf("find in %4zu members       %10.1f ns scan %8.1f ns find\n", width, scan * 1e9 / (rounds * width),
+	       find * 1e9 / (rounds * width));
+	v.Free();
+}
+
+/* consumes the events without building anything, the floor for any handler */
+struct CountingHandler {
+	size_t _count;
+
+	bool Null() { ++_count; return true; }
+	bool Bool(bool) { ++_count; return true; }
+	bool Number(double) { ++_count; return true; }
+	bool String(const char*, size_t size) { _count += size; return true; }
+	bool StartObject() { return true; }
+	bool Key(const char*, size_t size) { _count += size; return true; }
+	bool EndObject(size_t memberCount) { _count += memberCount; return true; }
+	bool StartArray() { return true; }
+	bool EndArray(size_t elementCount) { _count += elementCount; return true; }
+};
+
+static void BenchParseSax(const char* name, const string& json, size_t iterations) {
+	double seconds = MeasureSeconds(iterations, [&]() {
+		CountingHandler handler = { 0 };
+		JsonParseSax(&handler, json.c_str(), json.size());
+		gSink += handler._count;
+	});
+	Report(name, json.size(), iterations, seconds);
+}
+
+static void BenchStringify(const char* name, const string& json, size_t iterations) {
+	JsonValue v;
+	v.Init();
+	if (JsonParse(&v, json.c_str()) != RetType::PARSE_OK) {
+		printf("%-28s parse failed\n", name);
+		return;
+	}
+	size_t length = 0;
+	double allocs = CountAllocs([&]() {
+		free(JsonStringify(&v, &length));
+	});
+	double seconds = MeasureSeconds(iterations, [&]() {
+		char* out = JsonStringify(&v, &length);
+		gSink += out[0];
+		free(out);
+	});
+	Report(name, length, iterations, seconds, allocs);
+	v.Free();
+}
+
+static bool CountSink(const char*, size_t size, void* user) {
+	*static_cast<size_t*>(user) += size;
+	return true;
+}
+
+/* the same output as BenchStringify through a writer's fixed buffer, never holding all of it */
+static void BenchWriter(const char* name, const string& json, size_t iterations) {
+	JsonValue v;
+	v.Init();
+	if (JsonParse(&v, json.c_str()) != RetType::PARSE_OK) {
+		printf("%-28s parse failed\n", name);
+		return;
+	}
+	size_t length = 0;
+	double seconds = MeasureSeconds(iterations, [&]() {
+		JsonWriter writer;
+		length = 0;
+		writer.Init(CountSink, &length);
+		writer.Value(&v);
+		writer.Flush();
+		writer.Free();
+	});
+	gSink += length;
+	Report(name, length, iterations, seconds);
+	v.Free();
+}
+
+/*
+ * Encodes the parsed corpus to CBOR or MessagePack and decodes it back. The size is reported
+ * against the minified text, the rates per byte of that text so they line up with stringify and
+ * parse of the same corpus.
+ */
+static void BenchBinary(const char* format, const char* corpus, const string& json, size_t iterations) {
+	bool msgpack = strcmp(format, "msgpack") == 0;
+	JsonValue v;
+	v.Init();
+	if (JsonParse(&v, json.c_str()) != RetType::PARSE_OK) {
+		printf("%s %-20s parse failed\n", format, corpus);
+		return;
+	}
+	size_t textSize, size = 0;
+	free(JsonStringify(&v, &textSize));
+	char name[64];
+	char* data     = nullptr;
+	double seconds = MeasureSeconds(iterations, [&]() {
+		free(data);
+		data = msgpack
+			       ? JsonEncodeMsgPack(&v, &size)
+			       : JsonEncodeCbor(&v, &size);
+	});
+	snprintf(name, sizeof(name), "%s size %s", format, corpus);
+	printf("%-28s %9.1f%% of %zu text bytes\n", name, size * 100.0 / textSize, textSize);
+	snprintf(name, sizeof(name), "encode %s %s", format, corpus);
+	Report(name, textSize, iterations, seconds);
+	seconds = MeasureSeconds(iterations, [&]() {
+		JsonValue back;
+		msgpack
+			? JsonDecodeMsgPack(&back, data, size)
+			: JsonDecodeCbor(&back, data, size);
+		gSink += GetType(&back) == JsonType::JSON_ARRAY ? GetArraySize(&back) : 0;
+		back.Free();
+	});
+	snprintf(name, sizeof(name), "decode %s %s", format, corpus);
+	Report(name, textSize, iterations, seconds);
+	JsonDocument doc;
+	doc.Init();
+	seconds = MeasureSeconds(iterations, [&]() {
+		msgpack
+			? JsonDecodeMsgPack(&doc, data, size)
+			: JsonDecodeCbor(&doc, data, size);
+		gSink += GetType(&doc._root) == JsonType::JSON_ARRAY ? GetArraySize(&doc._root) : 0;
+	});
+	snprintf(name, sizeof(name), "decode doc %s %s", format, corpus);
+	Report(name, textSize, iterations, seconds);
+	doc.Free();
+	free(data);
+	v.Free();
+}
+
+/*
+ * What startup costs: parsing the file into a tree against mapping its frozen image, which only
+ * reads the header; then the same full walk over both.
+ */
+static void BenchFrozen(const char* name, const string& json, size_t iterations) {
+	const char* textPath   = "st_json_bench.json";
+	const char* frozenPath = "st_json_bench.frozen";
+	JsonValue v;
+	v.Init();
+	FILE* f = fopen(textPath, "wb");
+	if (!f || fwrite(json.data(), 1, json.size(), f) != json.size() || fclose(f) != 0 ||
+		JsonParse(&v, json.c_str()) != RetType::PARSE_OK || !JsonFreezeFile(&v, frozenPath)) {
+		printf("%-28s setup failed\n", name);
+		v.Free();
+		return;
+	}
+	char label[64];
+	double seconds = MeasureSeconds(iterations, [&]() {
+		JsonValue parsed;
+		JsonParseFile(&parsed, textPath);
+		gSink += GetArraySize(&parsed);
+		parsed.Free();
+	});
+	snprintf(label, sizeof(label), "load parsed %s", name);
+	Report(label, json.size(), iterations, seconds);
+	size_t frozenSize = 0;
+	seconds = MeasureSeconds(iterations * 100, [&]() {
+		JsonMappedFile file;
+		file.Open(frozenPath);
+		frozenSize = file._size;
+		gSink += GetArraySize(JsonFrozenRoot(file._data, file._size));
+		file.Close();
+	});
+	snprintf(label, sizeof(label), "load frozen %s", name);
+	Report(label, json.size(), iterations * 100, seconds);
+	printf("%-28s %10.1f MB image for %.1f MB of text\n", "  image", frozenSize / (1024.0 * 1024.0),
+	       json.size() / (1024.0 * 1024.0));
+
+	JsonMappedFile file;
+	file.Open(frozenPath);
+	const JsonFrozenValue* root = JsonFrozenRoot(file._data, file._size);
+	seconds = MeasureSeconds(iterations, [&]() {
+		gSink += static_cast<size_t>(SumTree(&v));
+	});
+	snprintf(label, sizeof(label), "traverse parsed %s", name);
+	Report(label, json.size(), iterations, seconds);
+	seconds = MeasureSeconds(iterations, [&]() {
+		gSink += static_cast<size_t>(SumTree(root));
+	});
+	snprintf(label, sizeof(label), "traverse frozen %s", name);
+	Report(label, json.size(), iterations, seconds);
+	file.Close();
+	v.Free();
+	remove(textPath);
+	remove(frozenPath);
+}
+
+/* log records produced call by call with no tree behind them */
+static void BenchBuilder(const char* name, size_t records, size_t iterations) {
+	size_t length = 0;
+	double seconds = MeasureSeconds(iterations, [&]() {
+		JsonWriter writer;
+		length = 0;
+		writer.Init(CountSink, &length);
+		for (size_t i = 0; i < records; ++i) {
+			writer.StartObject();
+			writer.Key("ts", 2);
+			writer.Number(static_cast<double>(1700000000000ULL + i * 37));
+			writer.Key("level", 5);
+			writer.String(i % 10 ? "info" : "warn", 4);
+			writer.Key("latency_ms", 10);
+			writer.Number((i * 7919) % 1000 / 10.0);
+			writer.Key("tags", 4);
+			writer.StartArray();
+			writer.String("a", 1);
+			writer.String("b", 1);
+			writer.EndArray();
+			writer.EndObject();
+		}
+		writer.Flush();
+		writer.Free();
+	});
+	gSink += length;
+	Report(name, length, iterations, seconds);
+}
+
+/*
+ * The records of BenchBuilder as a tree, built in place or the old way, by formatting text and
+ * parsing it back. Reports the bytes the tree stringifies to.
+ */
+static void BenchBuildTree(const char* name, size_t records, bool viaText, size_t iterations) {
+	JsonValue root;
+	root.Init();
+	double seconds = MeasureSeconds(iterations, [&]() {
+		root.Free();
+		if (viaText) {
+			string json = "[";
+			char buf[128];
+			for (size_t i = 0; i < records; ++i) {
+				snprintf(buf, sizeof(buf), "%s{\"ts\":%llu,\"level\":\"%s\",\"latency_ms\":%g,\"tags\":[\"a\",\"b\"]}",
+				         i ? "," : "", 1700000000000ULL + i * 37, i % 10 ? "info" : "warn", (i * 7919) % 1000 / 10.0);
+				json += buf;
+			}
+			json += "]";
+			JsonParse(&root, json.c_str(), json.size());
+		}
+		else {
+			SetArray(&root, records);
+			for (size_t i = 0; i < records; ++i) {
+				JsonValue* record = PushBackArrayElement(&root);
+				SetObject(record, 4);
+				SetNumber(SetObjectValue(record, "ts", 2), static_cast<double>(1700000000000ULL + i * 37));
+				SetString(SetObjectValue(record, "level", 5), i % 10 ? "info" : "warn", 4);
+				SetNumber(SetObjectValue(record, "latency_ms", 10), (i * 7919) % 1000 / 10.0);
+				JsonValue* tags = SetObjectValue(record, "tags", 4);
+				SetArray(tags, 2);
+				SetString(PushBackArrayElement(tags), "a", 1);
+				SetString(PushBackArrayElement(tags), "b", 1);
+			}
+		}
+		gSink += GetArraySize(&root);
+	});
+	size_t length;
+	free(JsonStringify(&root, &length));
+	root.Free();
+	Report(name, length, iterations, seconds);
+}
+
+struct LogRecord {
+	long long ts;
+	string level;
+	string service;
+	double latency_ms;
+	string msg;
+	vector<string> tags;
+};
+ST_JSON_BIND(LogRecord, ts, level, service, latency_ms, msg, tags)
+
+static void CopyString(const JsonValue* v, string* out) {
+	if (v && GetType(v) == JsonType::JSON_STRING)
+		out->assign(GetString(v), GetStringSize(v));
+}
+
+/* what binding saves: a document parse, then a lookup and a copy per member */
+static void CopyRecords(const JsonValue* root, vector<LogRecord>* records) {
+	records->clear();
+	for (size_t i = 0; i < GetArraySize(root); ++i) {
+		const JsonValue* obj = GetArrayElement(root, i);
+		const JsonValue* v;
+		records->push_back(LogRecord());
+		LogRecord& r = records->back();
+		if ((v = FindObjValue(obj, "ts", 2)) && GetType(v) == JsonType::JSON_NUMBER)
+			r.ts = static_cast<long long>(GetNumber(v));
+		CopyString(FindObjValue(obj, "level", 5), &r.level);
+		CopyString(FindObjValue(obj, "service", 7), &r.service);
+		if ((v = FindObjValue(obj, "latency_ms", 10)) && GetType(v) == JsonType::JSON_NUMBER)
+			r.latency_ms = GetNumber(v);
+		CopyString(FindObjValue(obj, "msg", 3), &r.msg);
+		if ((v = FindObjValue(obj, "tags", 4)) && GetType(v) == JsonType::JSON_ARRAY) {
+			r.tags.resize(GetArraySize(v));
+			for (size_t j = 0; j < GetArraySize(v); ++j)
+				CopyString(GetArrayElement(v, j), &r.tags[j]);
+		}
+	}
+}
+
+/* the records of MakeLines as an array, into structs by binding or through a document */
+static void BenchBind(const char* name, const string& json, bool viaDom, size_t iterations) {
+	vector<LogRecord> records;
+	JsonDocument doc;
+	doc.Init();
+	double seconds = MeasureSeconds(iterations, [&]() {
+		if (viaDom) {
+			JsonParse(&doc, json.c_str(), json.size());
+			CopyRecords(&doc._root, &records);
+		}
+		else
+			JsonParseBound(&records, json.c_str(), json.size());
+		gSink += records.size();
+	});
+	doc.Free();
+	Report(name, json.size(), iterations, seconds);
+}
+
+static void BenchWriteBound(const char* name, const string& json, size_t iterations) {
+	vector<LogRecord> records;
+	if (JsonParseBound(&records, json.c_str(), json.size()) != RetType::PARSE_OK) {
+		printf("%-28s parse failed\n", name);
+		return;
+	}
+	size_t length = 0;
+	double seconds = MeasureSeconds(iterations, [&]() {
+		JsonWriter writer;
+		length = 0;
+		writer.Init(CountSink, &length);
+		JsonWriteBound(&writer, records);
+		writer.Flush();
+		writer.Free();
+	});
+	gSink += length;
+	Report(name, length, iterations, seconds);
+}
+
+/* pretty-printed records dominated by long plain strings */
+static string MakeStringHeavy(size_t records) {
+	string json = "[\n";
+	for (size_t i = 0; i < records; ++i) {
+		json += i ? ",\n" : "";
+		json += "    {\n        \"id\": \"record-" + to_string(i) + "\",\n";
+		json += "        \"title\": \"";
+		for (size_t j = 0; j < 4; ++j)
+			json += "The quick brown fox jumps over the lazy dog, again and again. ";
+		json += "\",\n        \"body\": \"";
+		for (size_t j = 0; j < 16; ++j)
+			json += "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod. ";
+		json += "\",\n        \"escaped\": \"line\\none\\ttab \\\"quoted\\\" \\u00e9\"\n    }";
+	}
+	json += "\n]\n";
+	return json;
+}
+
+/* GeoJSON-like coordinate pairs and metric samples */
+static string MakeNumberHeavy(size_t points) {
+	string json = "[";
+	char buf[64];
+	unsigned seed = 12345;
+	for (size_t i = 0; i < points; ++i) {
+		seed = seed * 1103515245 + 12345;
+		double lon = (seed % 3600000) / 10000.0 - 180.0;
+		seed = seed * 1103515245 + 12345;
+		double lat = (seed % 1800000) / 10000.0 - 90.0;
+		snprintf(buf, sizeof(buf), "%s[%.6f,%.6f,%u,%.3e]", i ? "," : "", lon, lat, seed % 100000, lat * 1e-7);
+		json += buf;
+	}
+	json += "]";
+	return json;
+}
+
+/* records of 200 short fields, most of which a reader never looks at */
+static string MakeWideRecords(size_t records) {
+	string json = "[";
+	for (size_t i = 0; i < records; ++i) {
+		json += i ? ",{" : "{";
+		json += "\"id\":\"r" + to_string(i) + "\"";
+		for (size_t j = 1; j < 200; ++j)
+			json += ",\"f" + to_string(j) + "\":" + (j % 3 ? to_string(i * j % 100003) : "\"value " + to_string(j) + "\"");
+		json += "}";
+	}
+	json += "]";
+	return json;
+}
+
+/* objects nested depth deep, each level a few members beside the next, every fourth inside an array */
+static string MakeNested(size_t documents, size_t depth) {
+	string json = "[";
+	for (size_t i = 0; i < documents; ++i) {
+		json += i ? "," : "";
+		for (size_t d = 0; d < depth; ++d) {
+			json += "{\"depth\":" + to_string(d) + ",\"name\":\"node-" + to_string(i) + "-" + to_string(d);
+			json += d % 4 == 3 ? "\",\"enabled\":true,\"child\":[" : "\",\"enabled\":false,\"child\":";
+		}
+		json += "null";
+		for (size_t d = depth; d-- > 0;)
+			json += d % 4 == 3 ? "]}" : "}";
+	}
+	json += "]";
+	return json;
+}
+
+/* log-style records, one per line */
+static string MakeLines(size_t records) {
+	string json;
+	for (size_t i = 0; i < records; ++i) {
+		json += "{\"ts\":" + to_string(1700000000000ULL + i * 37) + ",\"level\":\"" + (i % 10 ? "info" : "warn");
+		json += "\",\"service\":\"api-" + to_string(i % 16) + "\",\"latency_ms\":" + to_string((i * 7919) % 1000 / 10.0);
+		json += ",\"msg\":\"request served for /v1/items/" + to_string(i) + "\",\"tags\":[\"a\",\"b\"]}\n";
+	}
+	return json;
+}
+
+/* with a path, the results are also written there as JSON */
+int main(int argc, char** argv) {
+	string strings = MakeStringHeavy(2000);
+	BenchParse("parse string-heavy", strings, 50);
+	BenchParseDocument("parse document string-heavy", strings, 50);
+	ReportKeys("keys string-heavy", strings);
+	BenchStringify("stringify string-heavy", strings, 50);
+	BenchWriter("writer string-heavy", strings, 50);
+	BenchTraverse("traverse string-heavy", strings, 50);
+	BenchParseInsitu("parse insitu string-heavy", strings, 50);
+	BenchParseSax("parse sax string-heavy", strings, 50);
+	BenchParsePush("parse push string-heavy", strings, 50);
+	BenchBinary("cbor", "string-heavy", strings, 50);
+	BenchBinary("msgpack", "string-heavy", strings, 50);
+	string numbers = MakeNumberHeavy(100000);
+	BenchParse("parse number-heavy", numbers, 20);
+	BenchParseDocument("parse document number-heavy", numbers, 20);
+	BenchParseSax("parse sax number-heavy", numbers, 20);
+	BenchParsePush("parse push number-heavy", numbers, 20);
+	BenchStringify("stringify number-heavy", numbers, 20);
+	BenchWriter("writer number-heavy", numbers, 20);
+	BenchTraverse("traverse number-heavy", numbers, 20);
+	BenchBinary("cbor", "number-heavy", numbers, 20);
+	BenchBinary("msgpack", "number-heavy", numbers, 20);
+	string nested = MakeNested(2000, 100);
+	BenchParse("parse nested", nested, 10);
+	BenchParseDocument("parse document nested", nested, 10);
+	BenchStringify("stringify nested", nested, 10);
+	BenchTraverse("traverse nested", nested, 10);
+	string lines = MakeLines(200000);
+	BenchParseLines("parse lines 1 thread", lines, 1, 10);
+	BenchParseLines("parse lines all threads", lines, 0, 10);
+	BenchBuilder("writer builder lines", 200000, 10);
+	BenchBuildTree("tree built in place", 200000, false, 10);
+	BenchBuildTree("tree built via text", 200000, true, 10);
+	string records = "[" + lines.substr(0, lines.size() - 1) + "]";
+	for (size_t i = records.find('\n'); i != string::npos; i = records.find('\n', i))
+		records[i] = ',';
+	BenchBind("bind records", records, false, 10);
+	BenchBind("dom then copy records", records, true, 10);
+	BenchWriteBound("writer bound records", records, 10);
+	BenchParse("parse records", records, 10);
+	BenchParseDocument("parse document records", records, 10);
+	BenchStringify("stringify records", records, 10);
+	BenchBinary("cbor", "records", records, 10);
+	BenchBinary("msgpack", "records", records, 10);
+	BenchFrozen("records", records, 5);
+	string wide = MakeWideRecords(2000);
+	BenchParseDocument("parse document wide", wide, 10);
+	ReportKeys("keys wide", wide);
+	BenchTraverse("traverse wide", wide, 10);
+	BenchParseSax("parse sax wide", wide, 10);
+	BenchParseLazy("parse lazy wide, 4 fields", wide, 10);
+	const char* fields[] = { "/*/id", "/*/f17", "/*/f123", "/*/f199" };
+	BenchParseProjected("projected wide, 4 fields", wide, fields, 4, 10);
+	const char* first[] = { "/0/id" };
+	BenchParseProjected("projected wide, first id", wide, first, 1, 10);
+	const char* ids[] = { "/*/id" };
+	BenchParseProjected("projected string-heavy, ids", strings, ids, 1, 50);
+	for (size_t width = 4; width <= 1024; width *= 4)
+		BenchFindObj(width, 200000 / width);
+	/* large documents, where the structural index pays off and can be built by several threads */
+	string bigStrings = MakeStringHeavy(20000);
+	BenchParse("parse big string-heavy", bigStrings, 5);
+	BenchParseIndexed("indexed big string-heavy 1t", bigStrings, 1, 5);
+	BenchParseIndexed("indexed big string-heavy", bigStrings, 0, 5);
+	string bigNumbers = MakeNumberHeavy(500000);
+	BenchParse("parse big number-heavy", bigNumbers, 5);
+	BenchParseIndexed("indexed big number-heavy 1t", bigNumbers, 1, 5);
+	BenchParseIndexed("indexed big number-heavy", bigNumbers, 0, 5);
+	if (argc > 1 && !WriteResults(argv[1])) {
+		printf("cannot write %s\n", argv[1]);
+		return 1;
+	}
+	return gSink == 0xFFFFFFFF;
+}
@@ -1,37 +1,209 @@
 #pragma once
 #include "st_json.h"
+#include "st_json_number.h"
+#include "st_json_internal.h"
+#include "st_json_reader.h"
 
 #include <cassert>
+#include <chrono>
 #include <cstdlib>
+#include <cstring>
 #include <stdio.h>
-#include <errno.h>   /* errno, ERANGE */
 #include <math.h>    /* HUGE_VAL */
+#include <stdint.h>  /* uintptr_t, uint64_t */
+
+/*
+ * The kernels read whole aligned blocks past end, the terminator or the end of length-delimited
+ * input, and branch on what they find there. Address and hardware-assisted address sanitizers
+ * report the read, MemorySanitizer the branch on bytes never written, so they get the exact loops.
+ */
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_HWADDRESS__)
+#define ST_JSON_NO_OVERREAD
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(hwaddress_sanitizer) || \
+    __has_feature(memory_sanitizer)
+#define ST_JSON_NO_OVERREAD
+#endif
+#endif
+
+/* define ST_JSON_NO_SIMD to force the portable scanning kernels */
+#if !defined(ST_JSON_NO_SIMD) && !defined(ST_JSON_NO_OVERREAD)
+#if defined(__AVX2__)
+#define ST_JSON_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ST_JSON_SSE2
+#include <emmintrin.h>
+#endif
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace ST_JSON;
+using namespace ST_JSON::INTERNAL;
 
-static void ParseWhitespace(JsonContext* context) {
-	const char* p = context->_json;
-	while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
-		++p;
-	context->_json = p;
+/* '"', '\\' and control characters (including the terminating '\0') end a plain string run */
+#define IS_STRING_SPECIAL(ch) ((ch) == '\"' || (ch) == '\\' || (unsigned char)(ch) < 0x20)
+
+static inline unsigned CountTrailingZeros(unsigned mask) {
+	assert(mask != 0);
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return index;
+#else
+	return __builtin_ctz(mask);
+#endif
 }
 
-#define EXPECT(context,ch) \
-	do{ \
-		assert(*(context->_json++)==ch); \
-	}while(0)
+/*
+ * The scanning kernels stop at end, which stands for the terminating '\0' of C strings.
+ * Once p is aligned they only issue aligned vector loads for blocks starting before end,
+ * so a load never crosses into a page that holds no input, even though it may read past end.
+ */
+const char* ST_JSON::INTERNAL::SkipWhitespace(const char* p, const char* end) {
+	if (p == end || !IsWhitespace(*p))
+		return p;
+#if defined(ST_JSON_AVX2)
+	for (; p != end && (reinterpret_cast<uintptr_t>(p) & 31); ++p)
+		if (!IsWhitespace(*p))
+			return p;
+	const __m256i sp = _mm256_set1_epi8(' ');
+	const __m256i tb = _mm256_set1_epi8('\t');
+	const __m256i nl = _mm256_set1_epi8('\n');
+	const __m256i cr = _mm256_set1_epi8('\r');
+	for (; p < end; p += 32) {
+		__m256i s = _mm256_load_si256(reinterpret_cast<const __m256i*>(p));
+		__m256i x = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(s, sp), _mm256_cmpeq_epi8(s, tb)),
+		                            _mm256_or_si256(_mm256_cmpeq_epi8(s, nl), _mm256_cmpeq_epi8(s, cr)));
+		unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(x));
+		if (mask != 0) {
+			p += CountTrailingZeros(mask);
+			return p < end
+				       ? p
+				       : end;
+		}
+	}
+	return end;
+#elif defined(ST_JSON_SSE2)
+	for (; p != end && (reinterpret_cast<uintptr_t>(p) & 15); ++p)
+		if (!IsWhitespace(*p))
+			return p;
+	const __m128i sp = _mm_set1_epi8(' ');
+	const __m128i tb = _mm_set1_epi8('\t');
+	const __m128i nl = _mm_set1_epi8('\n');
+	const __m128i cr = _mm_set1_epi8('\r');
+	for (; p < end; p += 16) {
+		__m128i s = _mm_load_si128(reinterpret_cast<const __m128i*>(p));
+		__m128i x = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(s, sp), _mm_cmpeq_epi8(s, tb)),
+		                         _mm_or_si128(_mm_cmpeq_epi8(s, nl), _mm_cmpeq_epi8(s, cr)));
+		unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(x)) & 0xFFFF;
+		if (mask != 0) {
+			p += CountTrailingZeros(mask);
+			return p < end
+				       ? p
+				       : end;
+		}
+	}
+	return end;
+#else
+	while (p != end && IsWhitespace(*p))
+		++p;
+	return p;
+#endif
+}
 
-static RetType ParseLiteral(JsonContext* context, JsonValue* val, JsonType type, const char* literal) {
-	EXPECT(context, literal[0]);
-	for (size_t i = 1; literal[i]; ++i) {
-		if (literal[i] != *context->_json++) {
-			return RetType::PARSE_INVALID_VALUE;
+/* returns the first '"', '\\' or control character at or after p, or end */
+const char* ST_JSON::INTERNAL::ScanStringRun(const char* p, const char* end) {
+#if defined(ST_JSON_AVX2)
+	for (; p != end && (reinterpret_cast<uintptr_t>(p) & 31); ++p)
+		if (IS_STRING_SPECIAL(*p))
+			return p;
+	const __m256i quote     = _mm256_set1_epi8('\"');
+	const __m256i backslash = _mm256_set1_epi8('\\');
+	const __m256i space     = _mm256_set1_epi8(0x1F);
+	for (; p < end; p += 32) {
+		__m256i s = _mm256_load_si256(reinterpret_cast<const __m256i*>(p));
+		__m256i x = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(s, quote), _mm256_cmpeq_epi8(s, backslash)),
+		                            _mm256_cmpeq_epi8(_mm256_max_epu8(s, space), space)); /* s <= 0x1F */
+		unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(x));
+		if (mask != 0) {
+			p += CountTrailingZeros(mask);
+			return p < end
+				       ? p
+				       : end;
 		}
 	}
-	val->_type = type;
-	return RetType::PARSE_OK;
+	return end;
+#elif defined(ST_JSON_SSE2)
+	for (; p != end && (reinterpret_cast<uintptr_t>(p) & 15); ++p)
+		if (IS_STRING_SPECIAL(*p))
+			return p;
+	const __m128i quote     = _mm_set1_epi8('\"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i space     = _mm_set1_epi8(0x1F);
+	for (; p < end; p += 16) {
+		__m128i s = _mm_load_si128(reinterpret_cast<const __m128i*>(p));
+		__m128i x = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(s, quote), _mm_cmpeq_epi8(s, backslash)),
+		                         _mm_cmpeq_epi8(_mm_max_epu8(s, space), space)); /* s <= 0x1F */
+		unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(x));
+		if (mask != 0) {
+			p += CountTrailingZeros(mask);
+			return p < end
+				       ? p
+				       : end;
+		}
+	}
+	return end;
+#elif defined(ST_JSON_NO_OVERREAD)
+	while (p != end && !IS_STRING_SPECIAL(*p))
+		++p;
+	return p;
+#else
+	/* SWAR: test 8 bytes per step, then locate the special byte inside the word */
+	for (; p != end && (reinterpret_cast<uintptr_t>(p) & 7); ++p)
+		if (IS_STRING_SPECIAL(*p))
+			return p;
+	const uint64_t ones  = 0x0101010101010101ull;
+	const uint64_t highs = 0x8080808080808080ull;
+	for (; p < end; p += 8) {
+		uint64_t w;
+		memcpy(&w, p, sizeof(w));
+		uint64_t q = w ^ (ones * '\"');
+		uint64_t b = w ^ (ones * '\\');
+		uint64_t special = ((q - ones) & ~q) | ((b - ones) & ~b) | ((w - ones * 0x20) & ~w);
+		if (special & highs)
+			break;
+	}
+	while (p < end && !IS_STRING_SPECIAL(*p))
+		++p;
+	return p < end
+		       ? p
+		       : end;
+#endif
 }
 
+#define PEEK(context) CharAt((context)->_json, (context)->_end)
+
+#define EXPECT(context,ch) \
+	do{ \
+		assert(PEEK(context)==ch); \
+		++context->_json; \
+	}while(0)
+
 #define IS_DIGIT_1TO9(ch) ((ch) >= '1' && (ch) <= '9')
 
 #define IS_DIGIT(ch) ((ch) >= '0' && (ch) <= '9')
@@ -47,47 +219,98 @@ static RetType ParseLiteral(JsonContext* context, JsonValue* val, JsonType type,
 	}while(0) \
 
 
-static RetType ParseNumber(JsonContext* context, JsonValue* val) {
-	const char* p = context->_json;
-	if (*p == '-')
+/* keeps up to 19 significant digits exact in the mantissa and counts the rest in the exponent */
+#define ACCUMULATE_DIGIT(num, digitCount, ch, isFraction) \
+	do { \
+		unsigned digit = (ch) - '0'; \
+		if ((num)._mantissa == 0 && digit == 0) { \
+			if (isFraction) \
+				--(num)._exp10; \
+		} \
+		else if ((digitCount) < 19) { \
+			(num)._mantissa = (num)._mantissa * 10 + digit; \
+			++(digitCount); \
+			if (isFraction) \
+				--(num)._exp10; \
+		} \
+		else { \
+			(num)._truncated |= digit != 0; \
+			if (!(isFraction)) \
+				++(num)._exp10; \
+		} \
+	}while(0)
+
+RetType ST_JSON::INTERNAL::ScanNumber(JsonContext* context, DecimalNumber* number) {
+	const char* p   = context->_json;
+	const char* end = context->_end;
+	int digitCount     = 0;
+	number->_mantissa  = 0;
+	number->_exp10     = 0;
+	number->_negative  = false;
+	number->_truncated = false;
+	number->_begin     = p;
+	if (CharAt(p, end) == '-') {
+		number->_negative = true;
 		++p;
-	if (*p == '0')
+	}
+	if (CharAt(p, end) == '0')
 		++p;
 	else {
-		if (!IS_DIGIT_1TO9(*p))
+		if (!IS_DIGIT_1TO9(CharAt(p, end)))
 			return RetType::PARSE_INVALID_VALUE;
 		else {
-			for (++p; IS_DIGIT(*p); ++p) {}
+			for (; IS_DIGIT(CharAt(p, end)); ++p)
+				ACCUMULATE_DIGIT(*number, digitCount, *p, false);
 		}
 	}
-	if (*p == '.') {
+	if (CharAt(p, end) == '.') {
 		++p;
-		if (!IS_DIGIT(*p))
+		if (!IS_DIGIT(CharAt(p, end)))
 			return RetType::PARSE_INVALID_VALUE;
 		else {
-			for (++p; IS_DIGIT(*p); ++p) {}
+			for (; IS_DIGIT(CharAt(p, end)); ++p)
+				ACCUMULATE_DIGIT(*number, digitCount, *p, true);
 		}
 	}
-	if (*p == 'e' || *p == 'E') {
+	if (CharAt(p, end) == 'e' || CharAt(p, end) == 'E') {
 		++p;
-		if (*p == '+' || *p == '-')
-			++p;
-		if (!IS_DIGIT(*p))
+		bool negativeExp = false;
+		if (CharAt(p, end) == '+' || CharAt(p, end) == '-')
+			negativeExp = *p++ == '-';
+		if (!IS_DIGIT(CharAt(p, end)))
 			return RetType::PARSE_INVALID_VALUE;
 		else {
-			for (++p; IS_DIGIT(*p); ++p) {}
+			int64_t exp = 0;
+			for (; IS_DIGIT(CharAt(p, end)); ++p) {
+				if (exp < DECIMAL_MAX_EXPONENT) /* far beyond any finite nonzero double */
+					exp = exp * 10 + (*p - '0');
+			}
+			number->_exp10 += negativeExp
+				                  ? -exp
+				                  : exp;
 		}
 	}
-	errno        = 0;
-	val->_number = strtod(context->_json, nullptr);
-	if (errno == ERANGE && (val->_number == HUGE_VAL || val->_number == -HUGE_VAL))
-		return RetType::PARSE_NUMBER_TOO_BIG;
+	number->_end   = p;
 	context->_json = p;
-	val->_type     = JsonType::JSON_NUMBER;
 	return RetType::PARSE_OK;
 }
 
-static const char* ParseHex4(const char* json, unsigned int* u) {
+RetType ST_JSON::INTERNAL::ParseNumberRaw(JsonContext* context, double* number) {
+	DecimalNumber num;
+	RetType ret;
+	if ((ret = ScanNumber(context, &num)) != RetType::PARSE_OK)
+		return ret;
+	*number = DecimalToDouble(&num);
+	if (*number == HUGE_VAL || *number == -HUGE_VAL) {
+		context->_json = num._begin;
+		return RetType::PARSE_NUMBER_TOO_BIG;
+	}
+	return RetType::PARSE_OK;
+}
+
+static const char* ParseHex4(const char* json, const char* end, unsigned int* u) {
+	if (end - json < 4)
+		return nullptr;
 	*u = 0;
 	for (size_t i = 0; i < 4; ++i) {
 		char ch = *json++;
@@ -104,265 +327,215 @@ static const char* ParseHex4(const char* json, unsigned int* u) {
 	return json;
 }
 
-static void EncodeUtf8(JsonContext* context, unsigned int u) {
+/* destinations for decoded string bytes: the context stack, or the input itself when parsing in situ */
+struct StackSink {
+	JsonContext* _context;
+
+	void Put(char ch) {
+		PUTC(_context, ch);
+	}
+
+	void Put(const char* str, size_t size) {
+		memcpy(_context->Push(size), str, size);
+	}
+};
+
+struct InsituSink {
+	char* _cur; /* never ahead of the read position: decoding only shrinks the text */
+
+	void Put(char ch) {
+		*_cur++ = ch;
+	}
+
+	void Put(const char* str, size_t size) {
+		if (_cur != str)
+			memmove(_cur, str, size);
+		_cur += size;
+	}
+};
+
+template <typename Sink>
+static void EncodeUtf8(Sink* sink, unsigned int u) {
 	if (u <= 0x007F) {
-		PUTC(context, u & 0x7F);
+		sink->Put(u & 0x7F);
 	}
 	else if (u <= 0x07FF) {
-		PUTC(context, ((u>>6) & 0x1F) |0xC0);
-		PUTC(context, (u & 0x3F) |0x80);
+		sink->Put(((u>>6) & 0x1F) |0xC0);
+		sink->Put((u & 0x3F) |0x80);
 	}
 	else if (u <= 0xFFFF) {
-		PUTC(context, ((u>>12) & 0x0F) |0xE0);
-		PUTC(context, ((u>>6) & 0x3F) |0x80);
-		PUTC(context, (u & 0x3F) |0x80);
+		sink->Put(((u>>12) & 0x0F) |0xE0);
+		sink->Put(((u>>6) & 0x3F) |0x80);
+		sink->Put((u & 0x3F) |0x80);
 	}
 	else {
 		assert(u<=0x10FFFF);
-		PUTC(context, ((u>>18) & 0x07) |0xF0);
-		PUTC(context, ((u>>12) & 0x3F) |0x80);
-		PUTC(context, ((u>>6) & 0x3F) |0x80);
-		PUTC(context, (u & 0x3F) |0x80);
+		sink->Put(((u>>18) & 0x07) |0xF0);
+		sink->Put(((u>>12) & 0x3F) |0x80);
+		sink->Put(((u>>6) & 0x3F) |0x80);
+		sink->Put((u & 0x3F) |0x80);
 	}
 }
 
-#define STRING_ERROR(ret) do { context->_top = cacheTop; return RetType::ret; } while(0)
-
-static RetType ParseStringRaw(JsonContext* context,char ** str,size_t* len) {
-	size_t cacheTop = context->_top;
-	EXPECT(context, '\"');
-	const char* p = context->_json;
+/* decodes the string body starting after the opening quote; *json ends up past the closing quote */
+template <typename Sink>
+static RetType ParseStringBody(const char** json, const char* end, Sink* sink) {
+	const char* p = *json;
 	unsigned int u, u2;
 	for (;;) {
+		const char* run = ScanStringRun(p, end);
+		if (run != p) {
+			sink->Put(p, run - p);
+			p = run;
+		}
+		if (p == end)
+			return RetType::PARSE_MISSING_QUOTATION_MARK;
 		char ch = *p++;
 		switch (ch) {
-			case '\"': {
-				size_t size = context->_top - cacheTop;
-				*str = static_cast<char*>(context->Pop(size));
-				*len = size; 
-				context->_json = p;
+			case '\"':
+				*json = p;
 				return RetType::PARSE_OK;
-			}
-			case '\0': context->_top = cacheTop;
-			return RetType::PARSE_MISSING_QUOTATION_MARK;
-			case '\\': switch (*p++) {
-				case '\\': PUTC(context, '\\');
+			case '\\':
+				ST_JSON_STAT(stats->_escapedBytes += 2);
+				switch (CharAt(p++, end)) {
+				case '\\': sink->Put('\\');
 				break;
-				case '\"': PUTC(context, '\"');
+				case '\"': sink->Put('\"');
 				break;
-				case '/': PUTC(context, '/');
+				case '/': sink->Put('/');
 				break;
-				case 'b': PUTC(context, '\b');
+				case 'b': sink->Put('\b');
 				break;
-				case 'f': PUTC(context, '\f');
+				case 'f': sink->Put('\f');
 				break;
-				case 'n': PUTC(context, '\n');
+				case 'n': sink->Put('\n');
 				break;
-				case 'r': PUTC(context, '\r');
+				case 'r': sink->Put('\r');
 				break;
-				case 't': PUTC(context, '\t');
+				case 't': sink->Put('\t');
 				break;
 				case 'u': {
-					if (!(p = ParseHex4(p, &u))) {
-						STRING_ERROR(PARSE_INVALID_UNICODE_HEX);
+					if (!(p = ParseHex4(p, end, &u))) {
+						return RetType::PARSE_INVALID_UNICODE_HEX;
 					}
+					ST_JSON_STAT(stats->_escapedBytes += 4);
 					if (u >= 0xD800 && u <= 0xDBFF) {
-						if (*p++ != '\\') {
-							STRING_ERROR(PARSE_INVALID_UNICODE_SURROGATE);
+						if (CharAt(p++, end) != '\\') {
+							return RetType::PARSE_INVALID_UNICODE_SURROGATE;
 						}
-						if (*p++ != 'u') {
-							STRING_ERROR(PARSE_INVALID_UNICODE_SURROGATE);
+						if (CharAt(p++, end) != 'u') {
+							return RetType::PARSE_INVALID_UNICODE_SURROGATE;
 						}
-						if (!(p = ParseHex4(p, &u2))) {
-							STRING_ERROR(PARSE_INVALID_UNICODE_HEX);
+						if (!(p = ParseHex4(p, end, &u2))) {
+							return RetType::PARSE_INVALID_UNICODE_HEX;
 						}
 						if (u2 < 0xDC00 || u2 > 0xDFFF) {
-							STRING_ERROR(PARSE_INVALID_UNICODE_SURROGATE);
+							return RetType::PARSE_INVALID_UNICODE_SURROGATE;
 						}
 						u = (((u - 0xD800) << 10) | (u2 - 0xDC00)) + 0x10000;
+						ST_JSON_STAT(stats->_escapedBytes += 6);
 					}
-					EncodeUtf8(context, u);
+					EncodeUtf8(sink, u);
 					break;
 				}
-				default: context->_top = cacheTop;
-				return RetType::PARSE_INVALID_STRING_ESCAPE;
+				default: return RetType::PARSE_INVALID_STRING_ESCAPE;
 			}
 			break;
 			default: if ((unsigned char)ch < 0x20) {
-				context->_top = cacheTop;
 				return RetType::PARSE_INVALID_STRING_CHAR;
 			}
-			PUTC(context, ch);
-		}
-	}
-}
-
-static RetType ParseString(JsonContext* context, JsonValue* val) {
-	char* str;
-	size_t strLen;
-	RetType ret = ParseStringRaw(context,&str,&strLen);
-	if(ret!=RetType::PARSE_OK)
-		return ret;
-	SetString(val,str,strLen);
-	return RetType::PARSE_OK;
-}
-
-static RetType ParseJsonValue(JsonContext* context, JsonValue* val);
-
-static RetType ParseArray(JsonContext* context, JsonValue* val) {
-	size_t size = 0;
-	RetType ret;
-	EXPECT(context, '[');
-	ParseWhitespace(context);
-	if (*context->_json == ']') {
-		++context->_json;
-		val->_type    = JsonType::JSON_ARRAY;
-		val->_arrData = nullptr;
-		val->_arrSize = 0;
-		return RetType::PARSE_OK;
-	}
-	for (;;) {
-		JsonValue v;
-		v.Init();
-		if ((ret = ParseJsonValue(context, &v)) != RetType::PARSE_OK) {
-			break;
-		}
-		memcpy(context->Push(sizeof(JsonValue)), &v, sizeof(JsonValue));
-		++size;
-		ParseWhitespace(context);
-		if (*context->_json == ',') {
-			++context->_json;
-			ParseWhitespace(context);
-		}
-		else if (*context->_json == ']') {
-			++context->_json;
-			val->_type    = JsonType::JSON_ARRAY;
-			val->_arrSize = size;
-			size *= sizeof(JsonValue);
-			val->_arrData = (JsonValue*)malloc(size);
-			memcpy(val->_arrData, context->Pop(size), size);
-			return RetType::PARSE_OK;
-		}
-		else {
-			ret= RetType::PARSE_MISSING_COMMA_OR_SQUARE_BRACKET;
-			break;
+			sink->Put(ch);
 		}
 	}
-	for (size_t i = 0; i < size; i++)
-		((JsonValue*)context->Pop( sizeof(JsonValue)))->Free();
-	return ret;
 }
 
-static RetType ParseObject(JsonContext* context,JsonValue* val) {
-	size_t size=0;
-	RetType ret;
-	JsonObjMember member;
-	EXPECT(context, '{');
-	ParseWhitespace(context);
-	if (*context->_json == '}') {
-		++context->_json;
-		val->_type    = JsonType::JSON_OBJECT;
-		val->_objData = nullptr;
-		val->_objSize = 0;
+RetType ST_JSON::INTERNAL::ParseStringRaw(JsonContext* context,const char ** str,size_t* len) {
+	size_t cacheTop = context->_top;
+	EXPECT(context, '\"');
+	const char* p = context->_json;
+	const char* run = ScanStringRun(p, context->_end);
+	if (run != context->_end && *run == '\"') {
+		/* nothing to unescape: hand out the input itself, the caller copies it */
+		*str = p;
+		*len = run - p;
+		context->_json = run + 1;
 		return RetType::PARSE_OK;
 	}
-	for (;;) {
-		char* key;
-		member._val.Init();
-		if (*context->_json != '"') {
-			ret = RetType::PARSE_MISSING_KEY;
-			break;
-		}
-		if((ret=ParseStringRaw(context,&key,&member._keySize))!=RetType::PARSE_OK) {
-			break;
-		}
-		member._key=(char*)malloc(sizeof(char)*(member._keySize+1));
-		memcpy(member._key,key,sizeof(char)*member._keySize);
-		member._key[member._keySize]='\0';
-		
-		ParseWhitespace(context);
-		if (*context->_json == ':') {
-			++context->_json;
-			ParseWhitespace(context);
-		}
-		else {
-			ret = RetType::PARSE_MISSING_COLON;
-			break;
-		}
-		if ((ret = ParseJsonValue(context, &member._val)) != RetType::PARSE_OK) {
-			break;
-		}
-		memcpy(context->Push(sizeof(JsonObjMember)), &member, sizeof(JsonObjMember));
-		++size;
-		member._key=nullptr;
-		ParseWhitespace(context);
-		if (*context->_json == ',') {
-			++context->_json;
-			ParseWhitespace(context);
-		}
-		else if (*context->_json == '}') {
-			++context->_json;
-			val->_type    = JsonType::JSON_OBJECT;
-			val->_objSize = size;
-			size *= sizeof(JsonObjMember);
-			val->_objData = (JsonObjMember*)malloc(size);
-			memcpy(val->_objData, context->Pop(size), size);
-			return RetType::PARSE_OK;
-		}
-		else {
-			ret = RetType::LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
-			break;
-		}
-	}
-	free(member._key);
-	for (size_t i = 0; i < size; i++) {
-		JsonObjMember* m = (JsonObjMember*) context->Pop(sizeof(JsonObjMember));
-		m->Free();
+	StackSink sink = { context };
+	RetType ret = ParseStringBody(&p, context->_end, &sink);
+	if (ret != RetType::PARSE_OK) {
+		context->_top = cacheTop;
+		return ret;
 	}
-	val->_type = JsonType::JSON_NULL;
-
-	return ret;
+	size_t size = context->_top - cacheTop;
+	*str = static_cast<char*>(context->Pop(size));
+	*len = size;
+	context->_json = p;
+	return RetType::PARSE_OK;
 }
 
-static RetType ParseJsonValue(JsonContext* context, JsonValue* val) {
-	switch (*context->_json) {
-		case 'n': return ParseLiteral(context, val, JsonType::JSON_NULL, "null");
-		case 'f': return ParseLiteral(context, val, JsonType::JSON_FALSE, "false");
-		case 't': return ParseLiteral(context, val, JsonType::JSON_TRUE, "true");
-		case '"': return ParseString(context, val);
-		case '[': return ParseArray(context, val);
-		case '{': return ParseObject(context,val);
-		default: return ParseNumber(context, val);
-		case '\0': return RetType::PARSE_EXPECT_VALUE;
-	}
+RetType ST_JSON::INTERNAL::ParseStringInsitu(JsonContext* context, char** str, size_t* len) {
+	EXPECT(context, '\"');
+	char* begin = const_cast<char*>(context->_json);
+	const char* p = begin;
+	InsituSink sink = { begin };
+	RetType ret = ParseStringBody(&p, context->_end, &sink);
+	if (ret != RetType::PARSE_OK)
+		return ret;
+	*sink._cur = '\0';
+	*str = begin;
+	*len = sink._cur - begin;
+	context->_json = p;
+	return RetType::PARSE_OK;
 }
 
 void JsonValue::Init() {
-	_type = JsonType::JSON_NULL;
+	_type  = JsonType::JSON_NULL;
+	_flags = 0;
 }
 
 void JsonValue::Free() {
+	if (_flags & (JSON_VALUE_BORROWED | JSON_VALUE_SHORT)) {
+		/* the memory, and the children in it, go away with their owner, short strings have none */
+		Init();
+		return;
+	}
+	const JsonAllocator* allocator = ValueAllocator(this);
 	switch (_type) {
 		case JsonType::JSON_STRING: {
-			free(_str);
+			FreeBlock(allocator, _str);
 			break;
 		}
 		case JsonType::JSON_ARRAY: {
-			for (size_t i = 0; i < _arrSize; ++i) {
+			for (size_t i = 0; i < Size(); ++i) {
 				_arrData[i].Free();
 			}
-			free(_arrData);
+			FreeBlock(allocator, ContainerBlock(this));
 			break;
 		}
 		case JsonType::JSON_OBJECT: {
-			for (size_t i = 0; i < _objSize; ++i) {
+			for (size_t i = 0; i < Size(); ++i) {
 				_objData[i].Free();
 			}
-			free(_objData);
+			FreeBlock(allocator, ContainerBlock(this));
 			break;
 		}
 	}
-	_type = JsonType::JSON_NULL;
+	_type  = JsonType::JSON_NULL;
+	_flags = 0;
+}
+
+static void FreeKey(JsonObjMember* m) {
+	FreeBlock(m->_keyAllocated
+		          ? BlockAllocator(m->_key)
+		          : nullptr,
+	          m->_key);
+}
+
+void JsonObjMember::Free() {
+	if (!_keyBorrowed)
+		FreeKey(this);
+	_val.Free();
 }
 
 void* JsonContext::Push(size_t size) {
@@ -373,10 +546,12 @@ void* JsonContext::Push(size_t size) {
 			_size = JSON_PARSE_STACK_INIT_SIZE;
 		while (_top + size >= _size)
 			_size += _size >> 1;
-		_stack = (char*)realloc(_stack, _size);
+		_stack = static_cast<char*>(ReallocMemory(_allocator, _stack, _size));
+		ST_JSON_STAT(++stats->_stackReallocs; CountAlloc(stats, _size));
 	}
 	ret = _stack + _top;
 	_top += size;
+	ST_JSON_STAT(if (_top > stats->_stackHighWater) stats->_stackHighWater = _top);
 	return ret;
 }
 
@@ -386,63 +561,1079 @@ void* JsonContext::Pop(size_t size) {
 	return _stack + _top;
 }
 
-void ST_JSON::JsonInit(JsonValue* val) {}
+void ST_JSON::JsonInit(JsonValue* val) {
+	assert(val!=nullptr);
+	val->Init();
+}
 
-void ST_JSON::JsonFree(JsonValue* val) {}
+void ST_JSON::JsonFree(JsonValue* val) {
+	assert(val!=nullptr);
+	val->Free();
+}
+
+void ST_JSON::INTERNAL::CopyTree(JsonValue* dst, const JsonValue* src, JsonArena* arena, JsonKeyTable* keys,
+                                 const JsonAllocator* allocator) {
+	unsigned char flags = TreeFlags(arena, allocator);
+	switch (src->_type) {
+		case JsonType::JSON_STRING: {
+			if (src->_flags & JSON_VALUE_SHORT) {
+				*dst = *src;
+				return;
+			}
+			dst->_str = CopyString(arena, src->_str, src->Size(), allocator);
+			break;
+		}
+		case JsonType::JSON_ARRAY: {
+			JsonValue* elements = nullptr;
+			if (src->Size() != 0) {
+				elements = static_cast<JsonValue*>(AllocTree(arena, src->Size() * sizeof(JsonValue), allocator));
+				for (size_t i = 0; i < src->Size(); ++i)
+					CopyTree(&elements[i], &src->_arrData[i], arena, keys, allocator);
+			}
+			dst->_arrData = elements;
+			break;
+		}
+		case JsonType::JSON_OBJECT: {
+			JsonObjMember* members = nullptr;
+			if (src->Size() != 0) {
+				members = static_cast<JsonObjMember*>(AllocTree(arena, src->Size() * sizeof(JsonObjMember) +
+				                                                ObjIndexBytes(src->Size()), allocator));
+				for (size_t i = 0; i < src->Size(); ++i) {
+					const JsonObjMember* m  = &src->_objData[i];
+					members[i]._key          = keys
+						                           ? const_cast<char*>(InternKey(keys, arena, m->_key, m->_keySize, false))
+						                           : CopyString(arena, m->_key, m->_keySize, allocator);
+					members[i]._keySize      = m->_keySize;
+					members[i]._keyBorrowed  = arena != nullptr;
+					members[i]._keyAllocated = !arena && allocator;
+					CopyTree(&members[i]._val, &m->_val, arena, keys, allocator);
+				}
+			}
+			dst->_objData = members;
+			break;
+		}
+		default: {
+			*dst = *src;
+			return;
+		}
+	}
+	dst->_type  = src->_type;
+	dst->_flags = flags;
+	dst->SetSize(src->Size());
+	if (src->_type == JsonType::JSON_OBJECT && ObjIndexBytes(src->Size()) != 0) {
+		*ObjIndexOf(dst) = 0;
+		if (src->Size() >= JSON_OBJ_INDEX_EAGER_SIZE)
+			BuildObjIndex(dst);
+	}
+}
+
+void ST_JSON::JsonCopy(JsonValue* dst, const JsonValue* src) {
+	assert(dst&&src);
+	JsonCopy(dst, src, ValueAllocator(dst));
+}
+
+void ST_JSON::JsonCopy(JsonValue* dst, const JsonValue* src, const JsonAllocator* allocator) {
+	assert(dst&&src);
+	JsonValue copy;
+	CopyTree(&copy, src, nullptr, nullptr, allocator);
+	dst->Free();
+	*dst = copy;
+}
+
+void ST_JSON::JsonCopy(JsonDocument* doc, const JsonValue* src) {
+	assert(doc&&src);
+	JsonValue copy;
+	CopyTree(&copy, src, &doc->_arena, &doc->_keys);
+	doc->_root.Free();
+	doc->_root = copy;
+}
+
+/* below a borrowed container only what was set or grown after parsing is on the heap */
+static void FreeEdits(JsonValue* val) {
+	if (val->_type != JsonType::JSON_ARRAY && val->_type != JsonType::JSON_OBJECT) {
+		if (val->_type == JsonType::JSON_STRING && !(val->_flags & (JSON_VALUE_BORROWED | JSON_VALUE_SHORT)))
+			val->Free();
+		return;
+	}
+	if (!(val->_flags & JSON_VALUE_BORROWED)) {
+		val->Free();
+		return;
+	}
+	for (size_t i = 0; i < val->Size(); ++i) {
+		if (val->_type == JsonType::JSON_ARRAY)
+			FreeEdits(&val->_arrData[i]);
+		else {
+			JsonObjMember* m = &val->_objData[i];
+			if (!m->_keyBorrowed) {
+				FreeKey(m);
+				m->_keyBorrowed = true;
+			}
+			FreeEdits(&m->_val);
+		}
+	}
+}
+
+void ST_JSON::JsonFreeEdits(JsonDocument* doc) {
+	assert(doc!=nullptr);
+	FreeEdits(&doc->_root);
+	doc->_root.Init();
+}
+
+void ST_JSON::JsonSwap(JsonValue* lhs, JsonValue* rhs) {
+	assert(lhs&&rhs);
+	JsonValue temp = *lhs;
+	*lhs           = *rhs;
+	*rhs           = temp;
+}
+
+RetType ST_JSON::INTERNAL::ParseWithStacks(JsonValue* val, const char* json, size_t length, JsonArena* arena,
+                                           JsonKeyTable* keys, JsonContext* context, JsonContext* values) {
+	context->_json   = json;
+	context->_end    = json + length;
+	context->_arena  = nullptr;
+	context->_insitu = false;
+	DomHandler handler = { values, arena, keys, false, values->_allocator };
+
+	val->Init();
+	RetType ret = SaxParseRoot(context, &handler);
+	if (ret == RetType::PARSE_OK) {
+		assert(values->_top==sizeof(JsonValue));
+		*val = *static_cast<JsonValue*>(values->Pop(sizeof(JsonValue)));
+	}
+	DropValues(values);
+	return ret;
+}
+
+/* a document's stacks come from its allocator */
+static RetType ParseRoot(JsonValue* val, const char* json, size_t length, JsonArena* arena, JsonKeyTable* keys,
+                         bool insitu, const JsonAllocator* allocator = nullptr) {
+	if (arena)
+		allocator = arena->_allocator;
+	JsonContext context, values;
+	InitStack(&context, allocator);
+	InitStack(&values, allocator);
+	context._json   = json;
+	context._end    = json + length;
+	context._arena  = nullptr;
+	context._insitu = insitu;
+	DomHandler handler = { &values, arena, keys, insitu, allocator };
+
+	val->Init();
+	RetType ret = SaxParseRoot(&context, &handler);
+	if (ret == RetType::PARSE_OK) {
+		assert(values._top==sizeof(JsonValue));
+		*val = *static_cast<JsonValue*>(values.Pop(sizeof(JsonValue)));
+	}
+	FreeMemory(allocator, context._stack);
+	FreeValueStack(&values);
+	return ret;
+}
 
 RetType ST_JSON::JsonParse(JsonValue* val, const char* json) {
-	assert(val!=nullptr);
-	JsonContext c;
-	c._json  = json;
-	c._stack = nullptr;
-	c._size  = 0;
-	c._top   = 0;
+	assert(val!=nullptr&&json!=nullptr);
+	return ParseRoot(val, json, strlen(json), nullptr, nullptr, false);
+}
+
+RetType ST_JSON::JsonParse(JsonValue* val, const char* json, size_t length) {
+	assert(val!=nullptr&&(json!=nullptr||length==0));
+	return ParseRoot(val, json, length, nullptr, nullptr, false);
+}
+
+RetType ST_JSON::JsonParse(JsonValue* val, const char* json, size_t length, const JsonAllocator* allocator) {
+	assert(val!=nullptr&&(json!=nullptr||length==0));
+	return ParseRoot(val, json, length, nullptr, nullptr, false, allocator);
+}
+
+RetType ST_JSON::JsonParse(JsonDocument* doc, const char* json) {
+	assert(doc!=nullptr&&json!=nullptr);
+	doc->_arena.Clear();
+	doc->_keys.Clear();
+	return ParseRoot(&doc->_root, json, strlen(json), &doc->_arena, &doc->_keys, false);
+}
+
+RetType ST_JSON::JsonParse(JsonDocument* doc, const char* json, size_t length) {
+	assert(doc!=nullptr&&(json!=nullptr||length==0));
+	doc->_arena.Clear();
+	doc->_keys.Clear();
+	return ParseRoot(&doc->_root, json, length, &doc->_arena, &doc->_keys, false);
+}
+
+void JsonStats::Init() {
+	memset(this, 0, sizeof(*this));
+}
+
+#ifdef ST_JSON_STATS
+thread_local JsonStats* ST_JSON::INTERNAL::gStats = nullptr;
+
+static double SecondsSince(std::chrono::steady_clock::time_point begin) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+/* nodes, string bytes and depth come from a walk of the tree once the timed work is done */
+static void CountTreeStats(const JsonValue* val, JsonStats* stats, size_t depth) {
+	++stats->_nodes[static_cast<size_t>(val->_type)];
+	switch (val->_type) {
+		case JsonType::JSON_STRING:
+			stats->_stringBytes += GetStringSize(val);
+			break;
+		case JsonType::JSON_ARRAY:
+			if (depth + 1 > stats->_maxDepth)
+				stats->_maxDepth = depth + 1;
+			for (size_t i = 0; i < val->Size(); ++i)
+				CountTreeStats(&val->_arrData[i], stats, depth + 1);
+			break;
+		case JsonType::JSON_OBJECT:
+			if (depth + 1 > stats->_maxDepth)
+				stats->_maxDepth = depth + 1;
+			for (size_t i = 0; i < val->Size(); ++i) {
+				stats->_stringBytes += val->_objData[i]._keySize;
+				CountTreeStats(&val->_objData[i]._val, stats, depth + 1);
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+static RetType ParseCounted(JsonValue* val, const char* json, size_t length, JsonArena* arena, JsonKeyTable* keys,
+                            JsonStats* stats) {
+	JsonContext context, values;
+	InitStack(&context, arena ? arena->_allocator : nullptr);
+	InitStack(&values, context._allocator);
+	gStats = stats;
+	auto begin  = std::chrono::steady_clock::now();
+	RetType ret = ParseWithStacks(val, json, length, arena, keys, &context, &values);
+	stats->_parseSeconds += SecondsSince(begin);
+	gStats = nullptr;
+	stats->_bytes += context._json - json;
+	FreeMemory(context._allocator, context._stack);
+	FreeMemory(values._allocator, values._stack);
+	if (ret == RetType::PARSE_OK)
+		CountTreeStats(val, stats, 0);
+	return ret;
+}
+#endif
+
+RetType ST_JSON::JsonParse(JsonValue* val, const char* json, size_t length, JsonStats* stats) {
+	assert(val!=nullptr&&(json!=nullptr||length==0)&&stats!=nullptr);
+#ifdef ST_JSON_STATS
+	return ParseCounted(val, json, length, nullptr, nullptr, stats);
+#else
+	(void)stats;
+	return ParseRoot(val, json, length, nullptr, nullptr, false);
+#endif
+}
+
+RetType ST_JSON::JsonParse(JsonDocument* doc, const char* json, size_t length, JsonStats* stats) {
+	assert(doc!=nullptr&&(json!=nullptr||length==0)&&stats!=nullptr);
+#ifdef ST_JSON_STATS
+	gStats     = stats;
+	auto begin = std::chrono::steady_clock::now();
+	doc->_arena.Clear();
+	doc->_keys.Clear();
+	stats->_clearSeconds += SecondsSince(begin);
+	gStats = nullptr;
+	return ParseCounted(&doc->_root, json, length, &doc->_arena, &doc->_keys, stats);
+#else
+	(void)stats;
+	return JsonParse(doc, json, length);
+#endif
+}
+
+RetType ST_JSON::JsonParseInsitu(JsonValue* val, char* json) {
+	assert(val!=nullptr&&json!=nullptr);
+	return ParseRoot(val, json, strlen(json), nullptr, nullptr, true);
+}
+
+RetType ST_JSON::JsonParseInsitu(JsonValue* val, char* json, size_t length, const JsonAllocator* allocator) {
+	assert(val!=nullptr&&(json!=nullptr||length==0));
+	return ParseRoot(val, json, length, nullptr, nullptr, true, allocator);
+}
+
+RetType ST_JSON::JsonParseInsitu(JsonDocument* doc, char* json) {
+	assert(doc!=nullptr&&json!=nullptr);
+	doc->_arena.Clear();
+	doc->_keys.Clear();
+	return ParseRoot(&doc->_root, json, strlen(json), &doc->_arena, &doc->_keys, true);
+}
+
+RetType ST_JSON::JsonParseInsitu(JsonDocument* doc, char* json, size_t length) {
+	assert(doc!=nullptr&&(json!=nullptr||length==0));
+	doc->_arena.Clear();
+	doc->_keys.Clear();
+	return ParseRoot(&doc->_root, json, length, &doc->_arena, &doc->_keys, true);
+}
+
+RetType ST_JSON::JsonParseFile(JsonValue* val, const char* path, const JsonAllocator* allocator) {
+	assert(val!=nullptr&&path!=nullptr);
+	JsonMappedFile file;
+	if (!file.Open(path)) {
+		val->Init();
+		return RetType::PARSE_FILE_ERROR;
+	}
+	RetType ret = ParseRoot(val, file._data, file._size, nullptr, nullptr, false, allocator);
+	file.Close();
+	return ret;
+}
+
+RetType ST_JSON::JsonParseFile(JsonDocument* doc, const char* path) {
+	assert(doc!=nullptr&&path!=nullptr);
+	doc->_arena.Clear();
+	doc->_keys.Clear();
+	JsonMappedFile file;
+	if (!file.Open(path)) {
+		doc->_root.Init();
+		return RetType::PARSE_FILE_ERROR;
+	}
+	RetType ret = ParseRoot(&doc->_root, file._data, file._size, &doc->_arena, &doc->_keys, false);
+	file.Close();
+	return ret;
+}
+
+/* where the push parser is: between tokens (skipping whitespace) or inside one */
+enum PushState {
+	PUSH_STATE_VALUE,
+	PUSH_STATE_ARRAY_FIRST,  /* after '[' */
+	PUSH_STATE_OBJECT_FIRST, /* after '{' */
+	PUSH_STATE_KEY,          /* after ',' in an object */
+	PUSH_STATE_COLON,
+	PUSH_STATE_AFTER_VALUE,
+	PUSH_STATE_ROOT_DONE,
+	PUSH_STATE_STRING,
+	PUSH_STATE_NUMBER,
+	PUSH_STATE_LITERAL,
+	PUSH_STATE_FAILED
+};
+
+/* the number grammar one byte at a time; ZERO, INT, FRAC and EXP may end the number */
+enum NumberState {
+	NUMBER_SIGN,
+	NUMBER_ZERO,
+	NUMBER_INT,
+	NUMBER_DOT,
+	NUMBER_FRAC,
+	NUMBER_E,
+	NUMBER_EXP_SIGN,
+	NUMBER_EXP,
+	NUMBER_END,    /* ch is not part of the number */
+	NUMBER_INVALID /* the number cannot be completed */
+};
+
+static int NextNumberState(int state, char ch) {
+	switch (state) {
+		case NUMBER_SIGN: return ch == '0'
+			                         ? NUMBER_ZERO
+			                         : IS_DIGIT_1TO9(ch)
+			                         ? NUMBER_INT
+			                         : NUMBER_INVALID;
+		case NUMBER_ZERO: return ch == '.'
+			                         ? NUMBER_DOT
+			                         : ch == 'e' || ch == 'E'
+			                         ? NUMBER_E
+			                         : NUMBER_END;
+		case NUMBER_INT: return IS_DIGIT(ch)
+			                        ? NUMBER_INT
+			                        : ch == '.'
+			                        ? NUMBER_DOT
+			                        : ch == 'e' || ch == 'E'
+			                        ? NUMBER_E
+			                        : NUMBER_END;
+		case NUMBER_DOT: return IS_DIGIT(ch)
+			                        ? NUMBER_FRAC
+			                        : NUMBER_INVALID;
+		case NUMBER_FRAC: return IS_DIGIT(ch)
+			                         ? NUMBER_FRAC
+			                         : ch == 'e' || ch == 'E'
+			                         ? NUMBER_E
+			                         : NUMBER_END;
+		case NUMBER_E: return ch == '+' || ch == '-'
+			                      ? NUMBER_EXP_SIGN
+			                      : IS_DIGIT(ch)
+			                      ? NUMBER_EXP
+			                      : NUMBER_INVALID;
+		case NUMBER_EXP_SIGN: return IS_DIGIT(ch)
+			                             ? NUMBER_EXP
+			                             : NUMBER_INVALID;
+		default: return IS_DIGIT(ch)
+			                ? NUMBER_EXP
+			                : NUMBER_END;
+	}
+}
+
+struct PushFrame {
+	size_t _count;
+
+	bool _object;
+};
+
+static PushFrame* TopFrame(JsonPushParser* parser) {
+	return parser->_frames._top != 0
+		       ? reinterpret_cast<PushFrame*>(parser->_frames._stack + parser->_frames._top - sizeof(PushFrame))
+		       : nullptr;
+}
+
+static JsonPushStatus PushFail(JsonPushParser* parser, RetType ret) {
+	assert(ret!=RetType::PARSE_OK);
+	parser->_ret   = ret;
+	parser->_state = PUSH_STATE_FAILED;
+	FreeValueStack(&parser->_values);
+	parser->_val->Free();
+	parser->_val->Init();
+	return JsonPushStatus::PUSH_ERROR;
+}
 
+/* a value just landed on the value stack: it is the root, or one more element of the open container */
+static void PushEndValue(JsonPushParser* parser) {
+	PushFrame* frame = TopFrame(parser);
+	if (frame) {
+		++frame->_count;
+		parser->_state = PUSH_STATE_AFTER_VALUE;
+	}
+	else {
+		assert(parser->_values._top==sizeof(JsonValue));
+		*parser->_val  = *static_cast<JsonValue*>(parser->_values.Pop(sizeof(JsonValue)));
+		parser->_state = PUSH_STATE_ROOT_DONE;
+	}
+}
+
+static void PushOpen(JsonPushParser* parser, bool object) {
+	PushFrame* frame = static_cast<PushFrame*>(parser->_frames.Push(sizeof(PushFrame)));
+	frame->_count    = 0;
+	frame->_object   = object;
+	parser->_state   = object
+		                   ? PUSH_STATE_OBJECT_FIRST
+		                   : PUSH_STATE_ARRAY_FIRST;
+}
+
+static void PushClose(JsonPushParser* parser, DomHandler* handler) {
+	PushFrame* frame = static_cast<PushFrame*>(parser->_frames.Pop(sizeof(PushFrame)));
+	if (frame->_object)
+		handler->EndObject(frame->_count);
+	else
+		handler->EndArray(frame->_count);
+	PushEndValue(parser);
+}
+
+/* dispatches on the first byte of a value the way SaxParseValue does */
+static RetType PushStartValue(JsonPushParser* parser, DomHandler* handler, char ch) {
+	switch (ch) {
+		case 'n': parser->_literal = "null";
+			break;
+		case 'f': parser->_literal = "false";
+			break;
+		case 't': parser->_literal = "true";
+			break;
+		case '"': {
+			parser->_state  = PUSH_STATE_STRING;
+			parser->_isKey  = false;
+			parser->_escape = false;
+			return RetType::PARSE_OK;
+		}
+		case '[': {
+			handler->StartArray();
+			PushOpen(parser, false);
+			return RetType::PARSE_OK;
+		}
+		case '{': {
+			handler->StartObject();
+			PushOpen(parser, true);
+			return RetType::PARSE_OK;
+		}
+		default: {
+			if (ch == '-')
+				parser->_numberState = NUMBER_SIGN;
+			else if (ch == '0')
+				parser->_numberState = NUMBER_ZERO;
+			else if (IS_DIGIT_1TO9(ch))
+				parser->_numberState = NUMBER_INT;
+			else
+				return RetType::PARSE_INVALID_VALUE;
+			parser->_state = PUSH_STATE_NUMBER;
+			return RetType::PARSE_OK;
+		}
+	}
+	parser->_literalPos = 1;
+	parser->_state      = PUSH_STATE_LITERAL;
+	return RetType::PARSE_OK;
+}
+
+/*
+ * Finds the byte that ends a string token: the closing quote, or a control character the
+ * decoder is going to reject. Escapes are skipped in pairs, which is all it takes to tell an
+ * escaped quote from the closing one. Returns one past that byte, or nullptr at end.
+ */
+static const char* PushScanString(JsonPushParser* parser, const char* p, const char* end) {
+	if (parser->_escape) {
+		parser->_escape = false;
+		++p;
+	}
+	while (p != end) {
+		p = ScanStringRun(p, end);
+		if (p == end)
+			break;
+		char ch = *p++;
+		if (ch == '\\') {
+			if (p == end) {
+				parser->_escape = true;
+				break;
+			}
+			++p;
+		}
+		else
+			return p;
+	}
+	return nullptr;
+}
+
+/* decodes a complete token, or at the end of the input an incomplete one, which then fails as JsonParse would */
+static RetType PushEndToken(JsonPushParser* parser, DomHandler* handler, const char* token, const char* end) {
+	RetType ret;
+	parser->_context._json = token;
+	parser->_context._end  = end;
+	if (parser->_state == PUSH_STATE_STRING) {
+		const char* str;
+		size_t len;
+		if ((ret = ParseStringRaw(&parser->_context, &str, &len)) != RetType::PARSE_OK)
+			return ret;
+		if (parser->_isKey) {
+			handler->Key(str, len);
+			parser->_state = PUSH_STATE_COLON;
+			return RetType::PARSE_OK;
+		}
+		handler->String(str, len);
+	}
+	else {
+		double d;
+		if ((ret = ParseNumberRaw(&parser->_context, &d)) != RetType::PARSE_OK)
+			return ret;
+		handler->Number(d);
+	}
+	assert(parser->_context._json==end);
+	PushEndValue(parser);
+	return RetType::PARSE_OK;
+}
+
+static JsonPushStatus PushStatus(const JsonPushParser* parser) {
+	return parser->_state == PUSH_STATE_FAILED
+		       ? JsonPushStatus::PUSH_ERROR
+		       : parser->_state == PUSH_STATE_ROOT_DONE
+		       ? JsonPushStatus::PUSH_DONE
+		       : JsonPushStatus::PUSH_NEED_MORE;
+}
+
+/* the stacks, and the tree when there is no document, come from allocator */
+void JsonPushParser::Init(JsonValue* val, const JsonAllocator* allocator) {
+	assert(val!=nullptr);
 	val->Init();
-	ParseWhitespace(&c);
+	_val   = val;
+	_arena = nullptr;
+	_keys  = nullptr;
+	InitStack(&_context, allocator);
+	InitStack(&_values, allocator);
+	InitStack(&_frames, allocator);
+	InitStack(&_token, allocator);
+	_literal     = nullptr;
+	_literalPos  = 0;
+	_state       = PUSH_STATE_VALUE;
+	_numberState = NUMBER_SIGN;
+	_isKey       = false;
+	_escape      = false;
+	_ret         = RetType::PARSE_OK;
+}
+
+void JsonPushParser::Init(JsonDocument* doc) {
+	assert(doc!=nullptr);
+	doc->_arena.Clear();
+	doc->_keys.Clear();
+	Init(&doc->_root, doc->_arena._allocator);
+	_arena = &doc->_arena;
+	_keys  = &doc->_keys;
+}
+
+void JsonPushParser::Free() {
+	const JsonAllocator* allocator = _context._allocator;
+	FreeValueStack(&_values);
+	FreeMemory(allocator, _context._stack);
+	FreeMemory(allocator, _frames._stack);
+	FreeMemory(allocator, _token._stack);
+	InitStack(&_context, allocator);
+	InitStack(&_frames, allocator);
+	InitStack(&_token, allocator);
+}
+
+JsonPushStatus JsonPushParser::Feed(const char* json, size_t length) {
+	assert(json!=nullptr||length==0);
+	DomHandler handler = { &_values, _arena, _keys, false, _values._allocator };
+	const char* p     = json;
+	const char* end   = json + length;
+	const char* token = json; /* where the current token starts in this chunk */
+	RetType ret;
+	while (p != end) {
+		switch (_state) {
+			case PUSH_STATE_FAILED: return JsonPushStatus::PUSH_ERROR;
+			case PUSH_STATE_STRING:
+			case PUSH_STATE_NUMBER: {
+				const char* stop;
+				if (_state == PUSH_STATE_STRING) {
+					if (!(stop = PushScanString(this, p, end))) {
+						p = end;
+						break;
+					}
+				}
+				else {
+					for (stop = p; stop != end; ++stop) {
+						int next = NextNumberState(_numberState, *stop);
+						if (next == NUMBER_INVALID)
+							return PushFail(this, RetType::PARSE_INVALID_VALUE);
+						if (next == NUMBER_END)
+							break;
+						_numberState = next;
+					}
+					if (stop == end) {
+						p = end;
+						break;
+					}
+				}
+				if (_token._top == 0)
+					ret = PushEndToken(this, &handler, token, stop);
+				else {
+					if (stop != token)
+						memcpy(_token.Push(stop - token), token, stop - token);
+					ret         = PushEndToken(this, &handler, _token._stack, _token._stack + _token._top);
+					_token._top = 0;
+				}
+				if (ret != RetType::PARSE_OK)
+					return PushFail(this, ret);
+				p = stop;
+				break;
+			}
+			case PUSH_STATE_LITERAL: {
+				for (; p != end && _literal[_literalPos] != '\0'; ++p, ++_literalPos)
+					if (*p != _literal[_literalPos])
+						return PushFail(this, RetType::PARSE_INVALID_VALUE);
+				if (_literal[_literalPos] == '\0') {
+					if (_literal[0] == 'n')
+						handler.Null();
+					else
+						handler.Bool(_literal[0] == 't');
+					PushEndValue(this);
+				}
+				break;
+			}
+			default: {
+				if ((p = SkipWhitespace(p, end)) == end)
+					break;
+				char ch = *p;
+				token   = p++;
+				switch (_state) {
+					case PUSH_STATE_ARRAY_FIRST: {
+						if (ch == ']') {
+							PushClose(this, &handler);
+							break;
+						}
+					}
+					/* fall through */
+					case PUSH_STATE_VALUE: {
+						if ((ret = PushStartValue(this, &handler, ch)) != RetType::PARSE_OK)
+							return PushFail(this, ret);
+						break;
+					}
+					case PUSH_STATE_OBJECT_FIRST: {
+						if (ch == '}') {
+							PushClose(this, &handler);
+							break;
+						}
+					}
+					/* fall through */
+					case PUSH_STATE_KEY: {
+						if (ch != '"')
+							return PushFail(this, RetType::PARSE_MISSING_KEY);
+						_state  = PUSH_STATE_STRING;
+						_isKey  = true;
+						_escape = false;
+						break;
+					}
+					case PUSH_STATE_COLON: {
+						if (ch != ':')
+							return PushFail(this, RetType::PARSE_MISSING_COLON);
+						_state = PUSH_STATE_VALUE;
+						break;
+					}
+					case PUSH_STATE_AFTER_VALUE: {
+						bool object = TopFrame(this)->_object;
+						if (ch == ',')
+							_state = object
+								         ? PUSH_STATE_KEY
+								         : PUSH_STATE_VALUE;
+						else if (ch == (object ? '}' : ']'))
+							PushClose(this, &handler);
+						else
+							return PushFail(this, object
+								                      ? RetType::LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET
+								                      : RetType::PARSE_MISSING_COMMA_OR_SQUARE_BRACKET);
+						break;
+					}
+					default: {
+						assert(_state==PUSH_STATE_ROOT_DONE);
+						return PushFail(this, RetType::PARSE_ROOT_NOT_SINGULAR);
+					}
+				}
+			}
+		}
+	}
+	if ((_state == PUSH_STATE_STRING || _state == PUSH_STATE_NUMBER) && end != token)
+		memcpy(_token.Push(end - token), token, end - token);
+	return PushStatus(this);
+}
+
+JsonPushStatus JsonPushParser::Finish() {
+	DomHandler handler = { &_values, _arena, _keys, false, _values._allocator };
 	RetType ret;
-	if ((ret = ParseJsonValue(&c, val)) == RetType::PARSE_OK) {
-		ParseWhitespace(&c);
-		if (*c._json != '\0') {
-			val->_type = JsonType::JSON_NULL;
-			return RetType::PARSE_ROOT_NOT_SINGULAR;
+	switch (_state) {
+		case PUSH_STATE_VALUE:
+		case PUSH_STATE_ARRAY_FIRST: return PushFail(this, RetType::PARSE_EXPECT_VALUE);
+		case PUSH_STATE_OBJECT_FIRST:
+		case PUSH_STATE_KEY: return PushFail(this, RetType::PARSE_MISSING_KEY);
+		case PUSH_STATE_COLON: return PushFail(this, RetType::PARSE_MISSING_COLON);
+		case PUSH_STATE_AFTER_VALUE: return PushFail(this, TopFrame(this)->_object
+			                                                   ? RetType::LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET
+			                                                   : RetType::PARSE_MISSING_COMMA_OR_SQUARE_BRACKET);
+		case PUSH_STATE_LITERAL: return PushFail(this, RetType::PARSE_INVALID_VALUE);
+		case PUSH_STATE_NUMBER: {
+			if (_numberState != NUMBER_ZERO && _numberState != NUMBER_INT && _numberState != NUMBER_FRAC &&
+			    _numberState != NUMBER_EXP)
+				return PushFail(this, RetType::PARSE_INVALID_VALUE);
+		}
+		/* fall through */
+		case PUSH_STATE_STRING: {
+			ret         = PushEndToken(this, &handler, _token._stack, _token._stack + _token._top);
+			_token._top = 0;
+			if (ret != RetType::PARSE_OK)
+				return PushFail(this, ret);
+			/* a number completed by the end of the input may still leave containers open */
+			return Finish();
 		}
+		default: return PushStatus(this);
 	}
-	assert(c._top==0);
-	free(c._stack);
-	return ret;
 }
 
-static void JsonStringifyString(JsonContext* context,const char* str,size_t len) {
+bool JsonMappedFile::Open(const char* path) {
+	assert(path!=nullptr);
+	_data    = "";
+	_size    = 0;
+	_mapping = nullptr;
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                          FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || static_cast<unsigned long long>(size.QuadPart) > SIZE_MAX) {
+		CloseHandle(file);
+		return false;
+	}
+	if (size.QuadPart > 0) {
+		/* the mapping keeps the file open by itself */
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		CloseHandle(file);
+		if (mapping == NULL)
+			return false;
+		void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (data == NULL) {
+			CloseHandle(mapping);
+			return false;
+		}
+		_data    = static_cast<const char*>(data);
+		_size    = static_cast<size_t>(size.QuadPart);
+		_mapping = mapping;
+	}
+	else {
+		CloseHandle(file);
+	}
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || static_cast<unsigned long long>(st.st_size) > SIZE_MAX) {
+		close(fd);
+		return false;
+	}
+	if (st.st_size > 0) {
+		void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			close(fd);
+			return false;
+		}
+#ifdef MADV_SEQUENTIAL
+		madvise(data, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+#endif
+		_data = static_cast<const char*>(data);
+		_size = static_cast<size_t>(st.st_size);
+	}
+	/* the mapping stays valid after the descriptor is closed */
+	close(fd);
+#endif
+	return true;
+}
+
+void JsonMappedFile::Close() {
+	if (_size > 0) {
+#ifdef _WIN32
+		UnmapViewOfFile(_data);
+		CloseHandle(static_cast<HANDLE>(_mapping));
+#else
+		munmap(const_cast<char*>(_data), _size);
+#endif
+	}
+	_data    = "";
+	_size    = 0;
+	_mapping = nullptr;
+}
+
+struct ST_JSON::JsonArenaChunk {
+	JsonArenaChunk* _next;
+
+	size_t _size; /* usable bytes following the header */
+
+	char* Data() {
+		return reinterpret_cast<char*>(this + 1);
+	}
+};
+
+#define ARENA_ALIGN(size) (((size) + 7) & ~static_cast<size_t>(7))
+
+void JsonArena::Init(const JsonAllocator* allocator) {
+	_head          = nullptr;
+	_cur           = nullptr;
+	_end           = nullptr;
+	_nextChunkSize = JSON_ARENA_CHUNK_INIT_SIZE;
+	_allocator     = allocator;
+}
+
+void JsonArena::Free() {
+	while (_head) {
+		JsonArenaChunk* next = _head->_next;
+		FreeMemory(_allocator, _head);
+		_head = next;
+	}
+	Init(_allocator);
+}
+
+void JsonArena::Clear() {
+	if (!_head)
+		return;
+	JsonArenaChunk* chunk = _head->_next;
+	while (chunk) {
+		JsonArenaChunk* next = chunk->_next;
+		FreeMemory(_allocator, chunk);
+		chunk = next;
+	}
+	_head->_next = nullptr;
+	_cur         = _head->Data();
+	_end         = _cur + _head->_size;
+}
+
+void* JsonArena::Alloc(size_t size) {
+	size = ARENA_ALIGN(size);
+	if (size <= static_cast<size_t>(_end - _cur)) {
+		void* ret = _cur;
+		_cur += size;
+		return ret;
+	}
+	if (_head && size > _nextChunkSize / 4) {
+		/* big block: give it a chunk of its own behind the current one, which stays in use */
+		JsonArenaChunk* chunk = static_cast<JsonArenaChunk*>(AllocMemory(_allocator, sizeof(JsonArenaChunk) + size));
+		ST_JSON_STAT(CountAlloc(stats, sizeof(JsonArenaChunk) + size));
+		chunk->_size = size;
+		chunk->_next = _head->_next;
+		_head->_next = chunk;
+		return chunk->Data();
+	}
+	size_t chunkSize = _nextChunkSize > size
+		                   ? _nextChunkSize
+		                   : size;
+	JsonArenaChunk* chunk = static_cast<JsonArenaChunk*>(AllocMemory(_allocator, sizeof(JsonArenaChunk) + chunkSize));
+	ST_JSON_STAT(CountAlloc(stats, sizeof(JsonArenaChunk) + chunkSize));
+	chunk->_size = chunkSize;
+	chunk->_next = _head;
+	_head        = chunk;
+	_cur         = chunk->Data() + size;
+	_end         = chunk->Data() + chunkSize;
+	if (_nextChunkSize < JSON_ARENA_CHUNK_MAX_SIZE)
+		_nextChunkSize *= 2;
+	return chunk->Data();
+}
+
+void JsonDocument::Init(const JsonAllocator* allocator) {
+	_root.Init();
+	_arena.Init(allocator);
+	_keys.Init(allocator);
+}
+
+void JsonDocument::Free() {
+	_arena.Free();
+	_keys.Free();
+	_root.Init();
+}
+
+void JsonKeyTable::Init(const JsonAllocator* allocator) {
+	_slots     = nullptr;
+	_capacity  = _count = 0;
+	_last      = 0;
+	_lookups   = _hits  = 0;
+	_allocator = allocator;
+}
+
+void JsonKeyTable::Free() {
+	FreeMemory(_allocator, _slots);
+	Init(_allocator);
+}
+
+void JsonKeyTable::Clear() {
+	if (_count != 0)
+		memset(_slots, 0, _capacity * sizeof(JsonKeySlot));
+	_count   = 0;
+	_last    = 0;
+	_lookups = _hits = 0;
+}
+
+static JsonKeySlot* FindKeySlot(const JsonKeyTable* keys, const char* key, size_t size, size_t hash) {
+	JsonKeySlot* slot = nullptr;
+	for (size_t s = hash & (keys->_capacity - 1);; s = (s + 1) & (keys->_capacity - 1)) {
+		slot = &keys->_slots[s];
+		if (!slot->_key || (slot->_hash == hash && slot->_size == size && memcmp(slot->_key, key, size) == 0))
+			return slot;
+	}
+}
+
+static void GrowKeyTable(JsonKeyTable* keys) {
+	JsonKeySlot* old = keys->_slots;
+	size_t capacity  = keys->_capacity;
+	keys->_capacity  = capacity
+		                  ? capacity * 2
+		                  : JSON_KEY_TABLE_INIT_SIZE;
+	keys->_slots = static_cast<JsonKeySlot*>(AllocMemory(keys->_allocator, keys->_capacity * sizeof(JsonKeySlot)));
+	memset(keys->_slots, 0, keys->_capacity * sizeof(JsonKeySlot));
+	ST_JSON_STAT(CountAlloc(stats, keys->_capacity * sizeof(JsonKeySlot)));
+	/* slots move, so the remembered successors are dropped */
+	for (size_t i = 0; i < capacity; ++i) {
+		if (old[i]._key) {
+			JsonKeySlot* slot = FindKeySlot(keys, old[i]._key, old[i]._size, old[i]._hash);
+			*slot             = old[i];
+			slot->_next       = 0;
+		}
+	}
+	keys->_last = 0;
+	FreeMemory(keys->_allocator, old);
+}
+
+const char* ST_JSON::INTERNAL::InternKey(JsonKeyTable* keys, JsonArena* arena, const char* key, size_t size,
+                                         bool insitu) {
+	assert(keys&&arena);
+	++keys->_lookups;
+	if (keys->_last != 0) {
+		size_t next = keys->_slots[keys->_last - 1]._next;
+		if (next != 0) {
+			const JsonKeySlot* slot = &keys->_slots[next - 1];
+			if (slot->_size == size && memcmp(slot->_key, key, size) == 0) {
+				++keys->_hits;
+				keys->_last = next;
+				return slot->_key;
+			}
+		}
+	}
+	size_t hash       = static_cast<size_t>(HashKey(key, size));
+	JsonKeySlot* slot = keys->_capacity != 0
+		                    ? FindKeySlot(keys, key, size, hash)
+		                    : nullptr;
+	const char* stored;
+	if (slot && slot->_key) {
+		++keys->_hits;
+		stored = slot->_key;
+	}
+	else {
+		stored = insitu
+			         ? key
+			         : CopyString(arena, key, size);
+		if (keys->_count == JSON_KEY_TABLE_MAX_SIZE) {
+			keys->_last = 0;
+			return stored;
+		}
+		/* keep the table at most half full */
+		if (2 * (keys->_count + 1) > keys->_capacity) {
+			GrowKeyTable(keys);
+			slot = FindKeySlot(keys, key, size, hash);
+		}
+		slot->_key  = stored;
+		slot->_size = size;
+		slot->_hash = hash;
+		++keys->_count;
+	}
+	size_t current = slot - keys->_slots + 1;
+	if (keys->_last != 0)
+		keys->_slots[keys->_last - 1]._next = current;
+	keys->_last = current;
+	return stored;
+}
+
+void ST_JSON::GetKeyStats(const JsonDocument* doc, JsonKeyStats* stats) {
+	assert(doc&&stats);
+	stats->_lookups  = doc->_keys._lookups;
+	stats->_hits     = doc->_keys._hits;
+	stats->_distinct = doc->_keys._count;
+	stats->_hitRate  = doc->_keys._lookups
+		                   ? static_cast<double>(doc->_keys._hits) / doc->_keys._lookups
+		                   : 0.0;
+}
+
+const char* ST_JSON::FindDocumentKey(const JsonDocument* doc, const char* key, size_t size) {
+	assert(doc&&(key||size==0));
+	if (doc->_keys._count == 0)
+		return nullptr;
+	return FindKeySlot(&doc->_keys, key, size, static_cast<size_t>(HashKey(key, size)))->_key;
+}
+
+char* ST_JSON::INTERNAL::EscapeChar(char* p, unsigned char ch) {
 	static const char hexDigits[] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
-	size_t i, size;
-	char* head, *p;
+	*p++ = '\\';
+	switch (ch) {
+		case '\"': *p++ = '\"'; break;
+		case '\\': *p++ = '\\'; break;
+		case '\b': *p++ = 'b';  break;
+		case '\f': *p++ = 'f';  break;
+		case '\n': *p++ = 'n';  break;
+		case '\r': *p++ = 'r';  break;
+		case '\t': *p++ = 't';  break;
+		default:
+			assert(ch < 0x20);
+			*p++ = 'u'; *p++ = '0'; *p++ = '0';
+			*p++ = hexDigits[ch >> 4];
+			*p++ = hexDigits[ch & 15];
+	}
+	return p;
+}
+
+/* clean runs are found a block at a time and copied whole, so space grows with the output rather than 6x the input */
+static void JsonStringifyString(JsonContext* context,const char* str,size_t len) {
+	const char* end = str + len;
 	assert(str != NULL);
-	p = head =(char*) context->Push(size = len * 6 + 2); /* "\u00xx..." */
-	*p++ = '"';
-	for (i = 0; i < len; i++) {
-		unsigned char ch = (unsigned char)str[i];
-		switch (ch) {
-			case '\"': *p++ = '\\'; *p++ = '\"'; break;
-			case '\\': *p++ = '\\'; *p++ = '\\'; break;
-			case '\b': *p++ = '\\'; *p++ = 'b';  break;
-			case '\f': *p++ = '\\'; *p++ = 'f';  break;
-			case '\n': *p++ = '\\'; *p++ = 'n';  break;
-			case '\r': *p++ = '\\'; *p++ = 'r';  break;
-			case '\t': *p++ = '\\'; *p++ = 't';  break;
-			default:
-				if (ch < 0x20) {
-					*p++ = '\\'; *p++ = 'u'; *p++ = '0'; *p++ = '0';
-					*p++ = hexDigits[ch >> 4];
-					*p++ = hexDigits[ch & 15];
-				}
-				else
-					*p++ = str[i];
+	PUTC(context, '"');
+	while (str != end) {
+		const char* run = ScanStringRun(str, end);
+		if (run != str) {
+			memcpy(context->Push(run - str), str, run - str);
+			str = run;
+			if (str == end)
+				break;
 		}
+		char* head = (char*)context->Push(6); /* "\u00xx" */
+		char* tail = EscapeChar(head, (unsigned char)*str++);
+		context->_top -= 6 - (tail - head);
+		ST_JSON_STAT(stats->_escapedBytes += tail - head);
 	}
-	*p++ = '"';
-	context->_top -= size - (p - head);
-} 
+	PUTC(context, '"');
+}
 
 static void JsonStringifyValue(JsonContext* context,const JsonValue* val) {
 	switch (val->_type) {
@@ -456,14 +1647,14 @@ static void JsonStringifyValue(JsonContext* context,const JsonValue* val) {
 			PUTS(context,"false",5);
 			break;
 		case JsonType::JSON_NUMBER:
-			context->_top-=32-sprintf((char*)context->Push(32),"%.17g",val->_number);
+			context->_top-=JSON_NUMBER_MAX_CHARS-FormatDouble(val->_number,(char*)context->Push(JSON_NUMBER_MAX_CHARS));
 			break;
 		case JsonType::JSON_STRING:
-			JsonStringifyString(context,val->_str,val->_strSize);
+			JsonStringifyString(context,GetString(val),GetStringSize(val));
 			break;
 		case JsonType::JSON_ARRAY:
 			PUTC(context,'[');
-			for(size_t i=0;i<val->_arrSize;++i) {
+			for(size_t i=0;i<val->Size();++i) {
 				if (i > 0)
 					PUTC(context, ',');
 				JsonStringifyValue(context,&val->_arrData[i]);
@@ -472,7 +1663,7 @@ static void JsonStringifyValue(JsonContext* context,const JsonValue* val) {
 			break;
 		case JsonType::JSON_OBJECT:
 			PUTC(context,'{');
-			for(size_t i=0;i<val->_objSize;++i) {
+			for(size_t i=0;i<val->Size();++i) {
 				if (i > 0)
 					PUTC(context, ',');
 				JsonStringifyString(context,val->_objData[i]._key,val->_objData[i]._keySize);
@@ -480,17 +1671,27 @@ static void JsonStringifyValue(JsonContext* context,const JsonValue* val) {
 				JsonStringifyValue(context,&val->_objData[i]._val);
 			}
 			PUTC(context,'}');
+			break;
 		default:assert(0&&"invalid type");
 	}
 	
 	
 }
 char* ST_JSON::JsonStringify(const JsonValue* val, size_t* size) {
+	return JsonStringify(val, size, static_cast<const JsonAllocator*>(nullptr));
+}
+
+char* ST_JSON::JsonStringify(const JsonValue* val, size_t* size, const JsonAllocator* allocator) {
 	JsonContext context;
 	assert(val!=nullptr);
 	context._size=JSON_STRINGIFY_STACK_INIT_SIZE;
-	context._stack=(char*)malloc(JSON_STRINGIFY_STACK_INIT_SIZE);
+	context._stack=(char*)AllocMemory(allocator, JSON_STRINGIFY_STACK_INIT_SIZE);
+	ST_JSON_STAT(CountAlloc(stats, JSON_STRINGIFY_STACK_INIT_SIZE));
 	context._top=0;
+	context._end=nullptr;
+	context._arena=nullptr;
+	context._insitu=false;
+	context._allocator=allocator;
 	JsonStringifyValue(&context,val);
 	if(size) {
 		*size=context._top;
@@ -499,6 +1700,26 @@ char* ST_JSON::JsonStringify(const JsonValue* val, size_t* size) {
 	return context._stack;
 }
 
+char* ST_JSON::JsonStringify(const JsonValue* val, size_t* size, JsonStats* stats) {
+	assert(val!=nullptr&&stats!=nullptr);
+#ifdef ST_JSON_STATS
+	size_t length;
+	gStats      = stats;
+	auto begin  = std::chrono::steady_clock::now();
+	char* json  = JsonStringify(val, &length);
+	stats->_stringifySeconds += SecondsSince(begin);
+	gStats = nullptr;
+	stats->_bytes += length;
+	CountTreeStats(val, stats, 0);
+	if (size)
+		*size = length;
+	return json;
+#else
+	(void)stats;
+	return JsonStringify(val, size);
+#endif
+}
+
 JsonType ST_JSON::GetType(const JsonValue* val) {
 	assert(val!=nullptr);
 	return val->_type;
@@ -518,44 +1739,95 @@ bool ST_JSON::GetBoolean(const JsonValue* val) {
 
 const char* ST_JSON::GetString(const JsonValue* val) {
 	assert(val&&val->_type==JsonType::JSON_STRING);
-	return val->_str;
+	return val->_flags & JSON_VALUE_SHORT
+		       ? val->_short
+		       : val->_str;
 }
 
 size_t ST_JSON::GetStringSize(const JsonValue* val) {
 	assert(val&&val->_type==JsonType::JSON_STRING);
-	return val->_strSize;
+	return val->_flags & JSON_VALUE_SHORT
+		       ? static_cast<size_t>(val->_flags >> 4)
+		       : val->Size();
 }
 
 size_t ST_JSON::GetArraySize(const JsonValue* val) {
 	assert(val&&val->_type==JsonType::JSON_ARRAY);
-	return val->_arrSize;
+	return val->Size();
 }
 
 JsonValue* ST_JSON::GetArrayElement(const JsonValue* val, size_t index) {
-	assert(val&&val->_type==JsonType::JSON_ARRAY&&index<val->_arrSize);
+	assert(val&&val->_type==JsonType::JSON_ARRAY&&index<val->Size());
 	return &val->_arrData[index];
 }
 
 size_t ST_JSON::GetObjSize(const JsonValue* val) {
 	assert(val&&val->_type==JsonType::JSON_OBJECT);
-	return val->_objSize;
+	return val->Size();
 }
 
 char const* ST_JSON::GetObjKey(const JsonValue* val, size_t index) {
-	assert(val&&val->_type==JsonType::JSON_OBJECT&&index<val->_objSize);
+	assert(val&&val->_type==JsonType::JSON_OBJECT&&index<val->Size());
 	return val->_objData[index]._key;
 }
 
 size_t ST_JSON::GetObjKeySize(const JsonValue* val, size_t index) {
-	assert(val&&val->_type==JsonType::JSON_OBJECT&&index<val->_objSize);
+	assert(val&&val->_type==JsonType::JSON_OBJECT&&index<val->Size());
 	return val->_objData[index]._keySize;
 }
 
 JsonValue* ST_JSON::GetObjValue(const JsonValue* val, size_t index) {
-	assert(val&&val->_type==JsonType::JSON_OBJECT&&index<val->_objSize);
+	assert(val&&val->_type==JsonType::JSON_OBJECT&&index<val->Size());
 	return &val->_objData[index]._val;
 }
 
+void ST_JSON::INTERNAL::BuildObjIndex(const JsonValue* val) {
+	uint32_t* index  = ObjIndexOf(val);
+	uint32_t* slots  = index + 1;
+	size_t capacity  = ObjIndexCapacity(val->Size());
+	memset(slots, 0, capacity * sizeof(uint32_t));
+	/* inserting from the back and overwriting leaves the first of duplicate keys */
+	for (size_t i = val->Size(); i-- > 0;) {
+		const JsonObjMember* m = &val->_objData[i];
+		size_t s               = HashKey(m->_key, m->_keySize) & (capacity - 1);
+		for (; slots[s] != 0; s = (s + 1) & (capacity - 1)) {
+			const JsonObjMember* other = &val->_objData[slots[s] - 1];
+			if (other->_keySize == m->_keySize && memcmp(other->_key, m->_key, m->_keySize) == 0)
+				break;
+		}
+		slots[s] = static_cast<uint32_t>(i + 1);
+	}
+	index[0] = static_cast<uint32_t>(capacity);
+}
+
+size_t ST_JSON::FindObjIndex(const JsonValue* val, const char* key, size_t size) {
+	assert(val&&val->_type==JsonType::JSON_OBJECT&&(key||size==0));
+	size_t capacity = ObjIndexCapacity(val->Size());
+	if (capacity == 0) {
+		for (size_t i = 0; i < val->Size(); ++i)
+			if (val->_objData[i]._keySize == size && memcmp(val->_objData[i]._key, key, size) == 0)
+				return i;
+		return JSON_KEY_NOT_EXIST;
+	}
+	uint32_t* index = ObjIndexOf(val);
+	if (index[0] == 0)
+		BuildObjIndex(val);
+	const uint32_t* slots = index + 1;
+	for (size_t s = HashKey(key, size) & (capacity - 1); slots[s] != 0; s = (s + 1) & (capacity - 1)) {
+		const JsonObjMember* m = &val->_objData[slots[s] - 1];
+		if (m->_keySize == size && memcmp(m->_key, key, size) == 0)
+			return slots[s] - 1;
+	}
+	return JSON_KEY_NOT_EXIST;
+}
+
+JsonValue* ST_JSON::FindObjValue(const JsonValue* val, const char* key, size_t size) {
+	size_t index = FindObjIndex(val, key, size);
+	return index != JSON_KEY_NOT_EXIST
+		       ? &val->_objData[index]._val
+		       : nullptr;
+}
+
 void ST_JSON::SetBoolean(JsonValue* val, bool b) {
 	assert(val);
 	val->Free();
@@ -573,10 +1845,250 @@ void ST_JSON::SetNumber(JsonValue* val, double n) {
 
 void ST_JSON::SetString(JsonValue* val, const char* str, size_t size) {
 	assert(val&&(str||size==0));
+	SetString(val, str, size, ValueAllocator(val));
+}
+
+void ST_JSON::SetString(JsonValue* val, const char* str, size_t size, const JsonAllocator* allocator) {
+	assert(val&&(str||size==0));
+	val->Free();
+	if (size <= JSON_SHORT_STRING_MAX_SIZE) {
+		SetShortString(val, str, size);
+		return;
+	}
+	val->_str = CopyString(nullptr, str, size, allocator);
+	val->SetSize(size);
+	val->_type  = JsonType::JSON_STRING;
+	val->_flags = TreeFlags(nullptr, allocator);
+}
+
+const JsonAllocator* ST_JSON::GetAllocator(const JsonValue* val) {
+	assert(val);
+	return ValueAllocator(val);
+}
+
+void ST_JSON::JsonMove(JsonValue* dst, JsonValue* src) {
+	assert(dst&&src&&dst!=src);
+	dst->Free();
+	*dst = *src;
+	src->Init();
+}
+
+/* moves the elements or members into a block from allocator with room for capacity of them, capacity >= size */
+static void ResizeContainer(JsonValue* val, size_t capacity, const JsonAllocator* allocator) {
+	bool object  = val->_type == JsonType::JSON_OBJECT;
+	size_t item  = object
+		               ? sizeof(JsonObjMember)
+		               : sizeof(JsonValue);
+	size_t bytes = capacity * item + (object
+		                                  ? ObjIndexBytes(capacity)
+		                                  : 0);
+	assert(capacity>=val->Size());
+	void* data = nullptr;
+	if (capacity != 0 && (val->_flags & JSON_VALUE_RESERVED)) {
+		size_t* block = static_cast<size_t*>(ReallocBlock(allocator, ContainerBlock(val), sizeof(size_t) + bytes));
+		block[0]      = capacity;
+		data          = block + 1;
+	}
+	else {
+		if (capacity != 0) {
+			size_t* block = static_cast<size_t*>(AllocBlock(allocator, sizeof(size_t) + bytes));
+			block[0]      = capacity;
+			data          = block + 1;
+			if (val->Size() != 0)
+				memcpy(data, val->_arrData, val->Size() * item);
+		}
+		if (!(val->_flags & JSON_VALUE_BORROWED) && ContainerBlock(val))
+			FreeBlock(allocator, ContainerBlock(val));
+	}
+	val->_arrData = static_cast<JsonValue*>(data);
+	val->_flags   = capacity != 0
+		                ? JSON_VALUE_RESERVED | TreeFlags(nullptr, allocator)
+		                : 0;
+	if (object && ObjIndexCapacity(val->Size()) != 0)
+		*ObjIndexOf(val) = 0;
+}
+
+/* a block from an allocator stays with it as it is resized */
+static void ResizeContainer(JsonValue* val, size_t capacity) {
+	ResizeContainer(val, capacity, ValueAllocator(val));
+}
+
+/* room for one more, growing by half like the parse stacks */
+static void GrowContainer(JsonValue* val) {
+	size_t capacity = ContainerCapacity(val);
+	if (val->Size() < capacity)
+		return;
+	capacity += capacity >> 1;
+	ResizeContainer(val, capacity > val->Size()
+		                     ? capacity
+		                     : val->Size() + 4);
+}
+
+void ST_JSON::SetArray(JsonValue* val, size_t capacity) {
+	assert(val);
+	SetArray(val, capacity, ValueAllocator(val));
+}
+
+void ST_JSON::SetArray(JsonValue* val, size_t capacity, const JsonAllocator* allocator) {
+	assert(val);
+	val->Free();
+	val->_type    = JsonType::JSON_ARRAY;
+	val->_arrData = nullptr;
+	val->SetSize(0);
+	if (capacity != 0)
+		ResizeContainer(val, capacity, allocator);
+}
+
+size_t ST_JSON::GetArrayCapacity(const JsonValue* val) {
+	assert(val&&val->_type==JsonType::JSON_ARRAY);
+	return ContainerCapacity(val);
+}
+
+void ST_JSON::ReserveArray(JsonValue* val, size_t capacity) {
+	assert(val&&val->_type==JsonType::JSON_ARRAY);
+	if (capacity > ContainerCapacity(val))
+		ResizeContainer(val, capacity);
+}
+
+void ST_JSON::ShrinkArray(JsonValue* val) {
+	assert(val&&val->_type==JsonType::JSON_ARRAY);
+	if (val->Size() < ContainerCapacity(val))
+		ResizeContainer(val, val->Size());
+}
+
+void ST_JSON::ClearArray(JsonValue* val) {
+	assert(val&&val->_type==JsonType::JSON_ARRAY);
+	for (size_t i = 0; i < val->Size(); ++i)
+		val->_arrData[i].Free();
+	val->SetSize(0);
+}
+
+JsonValue* ST_JSON::PushBackArrayElement(JsonValue* val) {
+	assert(val&&val->_type==JsonType::JSON_ARRAY);
+	GrowContainer(val);
+	JsonValue* e = &val->_arrData[val->Size()];
+	e->Init();
+	val->SetSize(val->Size() + 1);
+	return e;
+}
+
+void ST_JSON::PopBackArrayElement(JsonValue* val) {
+	assert(val&&val->_type==JsonType::JSON_ARRAY&&val->Size()>0);
+	val->SetSize(val->Size() - 1);
+	val->_arrData[val->Size()].Free();
+}
+
+JsonValue* ST_JSON::InsertArrayElement(JsonValue* val, size_t index) {
+	assert(val&&val->_type==JsonType::JSON_ARRAY&&index<=val->Size());
+	GrowContainer(val);
+	JsonValue* e = &val->_arrData[index];
+	memmove(e + 1, e, (val->Size() - index) * sizeof(JsonValue));
+	e->Init();
+	val->SetSize(val->Size() + 1);
+	return e;
+}
+
+void ST_JSON::EraseArrayElement(JsonValue* val, size_t index, size_t count) {
+	assert(val&&val->_type==JsonType::JSON_ARRAY&&index<=val->Size()&&count<=val->Size()-index);
+	if (count == 0)
+		return;
+	JsonValue* e = &val->_arrData[index];
+	for (size_t i = 0; i < count; ++i)
+		e[i].Free();
+	memmove(e, e + count, (val->Size() - index - count) * sizeof(JsonValue));
+	val->SetSize(val->Size() - count);
+}
+
+void ST_JSON::SetObject(JsonValue* val, size_t capacity) {
+	assert(val);
+	SetObject(val, capacity, ValueAllocator(val));
+}
+
+void ST_JSON::SetObject(JsonValue* val, size_t capacity, const JsonAllocator* allocator) {
+	assert(val);
 	val->Free();
-	val->_str = (char*)malloc(size + 1);
-	memcpy(val->_str, str, size);
-	val->_str[size] = '\0';
-	val->_strSize   = size;
-	val->_type      = JsonType::JSON_STRING;
+	val->_type    = JsonType::JSON_OBJECT;
+	val->_objData = nullptr;
+	val->SetSize(0);
+	if (capacity != 0)
+		ResizeContainer(val, capacity, allocator);
+}
+
+size_t ST_JSON::GetObjCapacity(const JsonValue* val) {
+	assert(val&&val->_type==JsonType::JSON_OBJECT);
+	return ContainerCapacity(val);
+}
+
+void ST_JSON::ReserveObj(JsonValue* val, size_t capacity) {
+	assert(val&&val->_type==JsonType::JSON_OBJECT);
+	if (capacity > ContainerCapacity(val))
+		ResizeContainer(val, capacity);
+}
+
+void ST_JSON::ShrinkObj(JsonValue* val) {
+	assert(val&&val->_type==JsonType::JSON_OBJECT);
+	if (val->Size() < ContainerCapacity(val))
+		ResizeContainer(val, val->Size());
+}
+
+/* the members moved: an index has to be built again on the next lookup */
+static void ResetObjIndex(JsonValue* val) {
+	if (ObjIndexCapacity(val->Size()) != 0)
+		*ObjIndexOf(val) = 0;
+}
+
+void ST_JSON::ClearObj(JsonValue* val) {
+	assert(val&&val->_type==JsonType::JSON_OBJECT);
+	for (size_t i = 0; i < val->Size(); ++i)
+		val->_objData[i].Free();
+	val->SetSize(0);
+}
+
+/* a member was added at the end; a built index of the same capacity takes it in, unless it is a duplicate */
+static void AppendObjIndex(JsonValue* val) {
+	size_t size     = val->Size();
+	size_t capacity = ObjIndexCapacity(size);
+	if (capacity == 0)
+		return;
+	uint32_t* index = ObjIndexOf(val);
+	if (ObjIndexCapacity(size - 1) != capacity || index[0] != capacity) {
+		index[0] = 0;
+		return;
+	}
+	uint32_t* slots        = index + 1;
+	const JsonObjMember* m = &val->_objData[size - 1];
+	size_t s               = HashKey(m->_key, m->_keySize) & (capacity - 1);
+	for (; slots[s] != 0; s = (s + 1) & (capacity - 1)) {
+		const JsonObjMember* other = &val->_objData[slots[s] - 1];
+		if (other->_keySize == m->_keySize && memcmp(other->_key, m->_key, m->_keySize) == 0)
+			return;
+	}
+	slots[s] = static_cast<uint32_t>(size);
+}
+
+JsonValue* ST_JSON::SetObjectValue(JsonValue* val, const char* key, size_t size) {
+	assert(val&&val->_type==JsonType::JSON_OBJECT&&(key||size==0));
+	size_t index = FindObjIndex(val, key, size);
+	if (index != JSON_KEY_NOT_EXIST)
+		return &val->_objData[index]._val;
+	GrowContainer(val);
+	const JsonAllocator* allocator = ValueAllocator(val);
+	JsonObjMember* m               = &val->_objData[val->Size()];
+	m->_key                        = CopyString(nullptr, key, size, allocator);
+	m->_keySize                    = size;
+	m->_keyBorrowed                = false;
+	m->_keyAllocated               = allocator != nullptr;
+	m->_val.Init();
+	val->SetSize(val->Size() + 1);
+	AppendObjIndex(val);
+	return &m->_val;
+}
+
+void ST_JSON::RemoveObjectValue(JsonValue* val, size_t index) {
+	assert(val&&val->_type==JsonType::JSON_OBJECT&&index<val->Size());
+	JsonObjMember* m = &val->_objData[index];
+	m->Free();
+	memmove(m, m + 1, (val->Size() - index - 1) * sizeof(JsonObjMember));
+	val->SetSize(val->Size() - 1);
+	ResetObjIndex(val);
 }
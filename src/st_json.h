@@ -1,14 +1,30 @@
 #pragma once
 #include <string>
+#include <stdint.h>  /* uint16_t, uint32_t, int64_t */
+#include <stdio.h>   /* FILE */
 using std::string;
 
 #define JSON_PARSE_STACK_INIT_SIZE 256
 #define JSON_STRINGIFY_STACK_INIT_SIZE 256
+#define JSON_WRITER_BUFFER_SIZE (64 * 1024)
+#define JSON_ARENA_CHUNK_INIT_SIZE (64 * 1024)
+#define JSON_ARENA_CHUNK_MAX_SIZE (16 * 1024 * 1024)
+#define JSON_LINES_BLOCK_SIZE (1024 * 1024)
+#define JSON_LAZY_CURSOR_COUNT 4
+/* objects with at least this many members carry a hash index for FindObjIndex, smaller ones are scanned */
+#define JSON_OBJ_INDEX_MIN_SIZE 16
+/* from this many members the index is built while parsing rather than on the first lookup */
+#define JSON_OBJ_INDEX_EAGER_SIZE 128
+/* strings this long or shorter are stored in the value itself, with their NUL */
+#define JSON_SHORT_STRING_MAX_SIZE 13
+#define JSON_KEY_TABLE_INIT_SIZE 64
+/* distinct keys a document remembers; keys first seen after that are copied like any string */
+#define JSON_KEY_TABLE_MAX_SIZE (64 * 1024)
 
 namespace ST_JSON {
 
 
-enum class JsonType {
+enum class JsonType : unsigned char {
 	JSON_NULL=0,
 	JSON_TRUE,
 	JSON_FALSE,
@@ -32,39 +48,86 @@ enum class RetType {
 	PARSE_MISSING_COMMA_OR_SQUARE_BRACKET,
 	PARSE_MISSING_COLON,
 	LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET,
-	PARSE_MISSING_KEY
+	PARSE_MISSING_KEY,
+	PARSE_FILE_ERROR,
+	PARSE_TERMINATED,
+	PARSE_TYPE_MISMATCH,
+	PARSE_MISSING_FIELD,
+	PARSE_INVALID_BINARY
 };
 
+/*
+ * Where the library gets memory from, for callers with pools or arenas of their own, nullptr
+ * everywhere meaning malloc, realloc and free. Parses into a JsonValue take one for their stacks
+ * and the tree, as do the decoders and JsonPushParser::Init; JsonDocument, JsonLazyDocument,
+ * JsonPathSet, JsonProjection and JsonWriter take one at Init for all they hold; JsonStringify,
+ * the encoders and JsonFreeze build their output with one; the SAX reader and JsonParseBound use
+ * one for their stack. A tree remembers it, so Set* and Free go back to it (see SetString).
+ * Only the JsonStats overloads, and the std::vector and std::thread bookkeeping of JsonParseLines
+ * and JsonParseIndexed, still use the heap. _user comes back in every call; realloc and free are
+ * never given nullptr, and blocks must be aligned for a double. JsonParseLines calls it from its
+ * workers, so it must be safe to call from several threads there. The allocator has to outlive
+ * everything allocated through it.
+ */
+struct JsonAllocator {
+	void* (*_malloc)(void* user, size_t size);
+
+	void* (*_realloc)(void* user, void* ptr, size_t size);
+
+	void (*_free)(void* user, void* ptr);
+
+	void* _user;
+};
 
 struct JsonObjMember;
+
+/* bits of JsonValue::_flags */
+#define JSON_VALUE_BORROWED 0x01 /* the string or element buffer belongs to someone else (a JsonDocument arena or an in-situ input buffer), Free leaves it alone */
+#define JSON_VALUE_SHORT 0x02    /* the string is in _short, its size in the upper four bits */
+#define JSON_VALUE_RESERVED 0x04 /* the array or object block is on the heap, after a word holding its capacity */
+#define JSON_VALUE_ALLOCATED 0x08 /* the string or element block came from a JsonAllocator, which the word before it points to */
+
+/*
+ * 16 bytes: the payload, a 48-bit element, member or byte count, then the flags and the type.
+ * A short string takes the place of the payload and the count.
+ */
 struct JsonValue {
 	void Init();
 
 	void Free();
 
 	union {
-		double _number;
-
 		struct {
-			JsonValue* _arrData;
+			union {
+				double _number;
 
-			size_t _arrSize;
-		};
+				JsonValue* _arrData;
 
-		struct {
-			char* _str;
+				char* _str;
 
-			size_t _strSize;
-		};
+				JsonObjMember* _objData;
+			};
 
-		struct {
-			JsonObjMember* _objData;
+			uint32_t _sizeLow;
+
+			uint16_t _sizeHigh;
 
-			size_t _objSize;
+			unsigned char _flags;
+
+			JsonType _type;
 		};
+
+		char _short[JSON_SHORT_STRING_MAX_SIZE + 1];
 	};
 
-	JsonType _type;
+	size_t Size() const {
+		return static_cast<size_t>(static_cast<uint64_t>(_sizeHigh) << 32 | _sizeLow);
+	}
+
+	void SetSize(size_t size) {
+		_sizeLow  = static_cast<uint32_t>(size);
+		_sizeHigh = static_cast<uint16_t>(static_cast<uint64_t>(size) >> 32);
+	}
 };
 
 struct JsonObjMember {
@@ -74,33 +137,654 @@ struct JsonObjMember {
 
 	JsonValue _val;
 
-	void Free() {
-		free(_key);
-		_val.Free();
-	}
+	bool _keyBorrowed;
+
+	bool _keyAllocated; /* the key came from a JsonAllocator, like a value's JSON_VALUE_ALLOCATED block */
+
+	void Free();
+};
+
+struct JsonArenaChunk;
+
+/*
+ * Bump allocator handing out memory from a list of chunks that grow geometrically.
+ * Single allocations are never freed, only the whole arena at once.
+ */
+struct JsonArena {
+	JsonArenaChunk* _head;
+
+	char* _cur;
+
+	char* _end;
+
+	size_t _nextChunkSize;
+
+	const JsonAllocator* _allocator; /* where the chunks come from */
+
+	void Init(const JsonAllocator* allocator = nullptr);
+
+	/* releases every chunk */
+	void Free();
+
+	/* forgets every allocation but keeps the newest chunk for reuse */
+	void Clear();
+
+	void* Alloc(size_t size);
+};
+
+struct JsonKeySlot {
+	const char* _key; /* nullptr for a free slot */
+
+	size_t _size;
+
+	size_t _hash;
+
+	size_t _next; /* 1 + the slot of the key that came after this one last time, 0 if none */
+};
+
+/*
+ * The distinct object keys of a document. Members with equal keys share the one stored copy,
+ * so the keys of a document can be compared by pointer. Records of one shape repeat their keys
+ * in order, so the key that followed the previous one is tried before hashing.
+ */
+struct JsonKeyTable {
+	JsonKeySlot* _slots;
+
+	size_t _capacity, _count;
+
+	size_t _last; /* 1 + the slot of the previous key, 0 if none */
+
+	size_t _lookups, _hits;
+
+	const JsonAllocator* _allocator; /* where the slots come from */
+
+	void Init(const JsonAllocator* allocator = nullptr);
+
+	void Free();
+
+	/* forgets the keys, which live in the arena, but keeps the slots */
+	void Clear();
+};
+
+/*
+ * A parsed tree whose nodes, strings and keys all live in one arena, each distinct key once.
+ * Free releases a handful of chunks without walking the tree. Values inside the
+ * document must not outlive it; Set* on them allocates from the heap, or from the allocator
+ * given to it, so such values have to be freed with JsonValue::Free, or all at once with
+ * JsonFreeEdits, before the document goes away.
+ */
+struct JsonDocument {
+	JsonValue _root;
+
+	JsonArena _arena;
+
+	JsonKeyTable _keys;
+
+	/* the arena, the key table and the stacks of JsonParse and JsonParseInsitu come from allocator */
+	void Init(const JsonAllocator* allocator = nullptr);
+
+	void Free();
 };
 
 
 struct JsonContext {
 	const char* _json;
 
+	const char* _end; /* one past the last input byte */
+
 	char* _stack;
 
 	size_t _size, _top;
 
+	JsonArena* _arena;
+
+	bool _insitu;
+
+	const JsonAllocator* _allocator; /* where the stack comes from */
+
 	void* Push(size_t size);
 
 	void* Pop(size_t size);
 };
 
+/* val->Init() and val->Free(); Value and Document in st_json_value.h call them for you */
 void JsonInit(JsonValue* val);
 
 void JsonFree(JsonValue* val);
 
+/* read-only mapping of a whole file; an empty file maps to an empty string */
+struct JsonMappedFile {
+	const char* _data;
+
+	size_t _size;
+
+	void* _mapping; /* platform handle, only used on Windows */
+
+	bool Open(const char* path);
+
+	void Close();
+};
+
 RetType JsonParse(JsonValue* val, const char* json);
 
+/* json needs no terminator; a NUL byte inside it is just an invalid character */
+RetType JsonParse(JsonValue* val, const char* json, size_t length);
+
+/* parses into doc->_root, recycling memory of whatever doc held before */
+RetType JsonParse(JsonDocument* doc, const char* json);
+
+RetType JsonParse(JsonDocument* doc, const char* json, size_t length);
+
+/*
+ * The tree and the parse stacks from allocator. Every string and container block remembers its
+ * allocator, so JsonValue::Free needs nothing else, and Set* on the tree keep using it.
+ */
+RetType JsonParse(JsonValue* val, const char* json, size_t length, const JsonAllocator* allocator);
+
+/* maps the file read-only and parses it without copying it; PARSE_FILE_ERROR if it cannot be mapped */
+RetType JsonParseFile(JsonValue* val, const char* path, const JsonAllocator* allocator = nullptr);
+
+RetType JsonParseFile(JsonDocument* doc, const char* path);
+
+/*
+ * In-situ (destructive) parsing: strings and keys are unescaped inside json itself and
+ * _str/_key point into it, so no string is copied or allocated. Arrays and objects are
+ * still allocated as usual (from the arena for a JsonDocument).
+ * Lifetime rules:
+ *  - json is overwritten and is no longer valid JSON afterwards, whatever the result;
+ *  - json must stay alive and unmodified for as long as the parsed values are used;
+ *  - JsonValue::Free (or JsonDocument::Free) never frees json, releasing it is up to the caller,
+ *    after the values are done with.
+ */
+RetType JsonParseInsitu(JsonValue* val, char* json);
+
+RetType JsonParseInsitu(JsonValue* val, char* json, size_t length, const JsonAllocator* allocator = nullptr);
+
+RetType JsonParseInsitu(JsonDocument* doc, char* json);
+
+RetType JsonParseInsitu(JsonDocument* doc, char* json, size_t length);
+
+enum class JsonPushStatus {
+	PUSH_NEED_MORE=0,
+	PUSH_DONE,
+	PUSH_ERROR
+};
+
+/*
+ * Incremental parser for input that arrives in pieces. Chunks may be split anywhere, even
+ * inside a token, and the outcome (tree or error code) is the same as JsonParse on their
+ * concatenation. Feed reports PUSH_DONE as soon as the root value is complete, which for a
+ * bare number means once a byte after it arrives; Finish marks the end of the input.
+ * After PUSH_ERROR, _ret holds the error and the target is null.
+ */
+struct JsonPushParser {
+	JsonValue* _val;
+
+	JsonArena* _arena;
+
+	JsonKeyTable* _keys;
+
+	JsonContext _context; /* scratch for unescaping strings */
+
+	JsonContext _values; /* finished values waiting for their container */
+
+	JsonContext _frames; /* element count and kind of every open array and object */
+
+	JsonContext _token; /* the part of a string or number seen in earlier chunks */
+
+	const char* _literal;
+
+	size_t _literalPos;
+
+	int _state, _numberState;
+
+	bool _isKey, _escape;
+
+	RetType _ret;
+
+	/* parses into val, or into doc->_root recycling memory of whatever doc held before */
+	void Init(JsonValue* val, const JsonAllocator* allocator = nullptr);
+
+	void Init(JsonDocument* doc);
+
+	/* releases the parser's own buffers; a finished tree stays with the target */
+	void Free();
+
+	JsonPushStatus Feed(const char* json, size_t length);
+
+	JsonPushStatus Finish();
+};
+
+/* one record of newline-delimited JSON; on a bad line _val is null and _ret says why */
+struct JsonLine {
+	JsonValue _val;
+
+	RetType _ret;
+
+	size_t _lineNumber; /* 1-based, blank lines count */
+};
+
+/* _val lives in memory released once the callback returns; returning false stops the reader */
+typedef bool (*JsonLineCallback)(JsonLine* line, void* user);
+
+/*
+ * Parses NDJSON / JSON Lines: one value per line, lines holding only whitespace are skipped.
+ * The input is cut into line-aligned blocks of about JSON_LINES_BLOCK_SIZE that threadCount
+ * workers (0 for one per hardware thread) parse ahead, each with its own reused stacks and a
+ * per-block arena. callback runs on the calling thread with every line in input order, bad
+ * lines included. Returns PARSE_TERMINATED if the callback stopped it, PARSE_OK otherwise.
+ */
+RetType JsonParseLines(const char* json, size_t length, size_t threadCount, JsonLineCallback callback, void* user,
+                       const JsonAllocator* allocator = nullptr);
+
+/* maps the file like JsonParseFile; PARSE_FILE_ERROR if it cannot be mapped */
+RetType JsonParseLinesFile(const char* path, size_t threadCount, JsonLineCallback callback, void* user,
+                           const JsonAllocator* allocator = nullptr);
+
+/*
+ * Two-stage parser for large documents. Stage 1 classifies 64-byte blocks with SIMD into an
+ * index of brackets, colons, commas, opening quotes and the first byte of every other token,
+ * with escaped bytes and string contents masked out; it runs over chunks on threadCount threads
+ * (0 for one per hardware thread) when the input is large enough. Stage 2 walks the index to
+ * build the tree. The tree and the error codes are the same as JsonParse.
+ */
+RetType JsonParseIndexed(JsonValue* val, const char* json, size_t length, size_t threadCount,
+                         const JsonAllocator* allocator = nullptr);
+
+RetType JsonParseIndexed(JsonDocument* doc, const char* json, size_t length, size_t threadCount);
+
+struct JsonKeyStats {
+	size_t _lookups;  /* keys parsed */
+
+	size_t _hits;     /* keys that were already stored */
+
+	size_t _distinct; /* keys stored */
+
+	double _hitRate;
+};
+
+/* how well key interning did on the last parse into doc */
+void GetKeyStats(const JsonDocument* doc, JsonKeyStats* stats);
+
+/*
+ * The stored copy of key if the last parse met it, nullptr otherwise. Every member parsed with
+ * that key points at the returned copy, so comparing GetObjKey against it is enough.
+ */
+const char* FindDocumentKey(const JsonDocument* doc, const char* key, size_t size);
+
+/*
+ * One value of a lazily parsed document: where its text is, whose first byte tells the type, and
+ * how far to jump over it. Values sit in document order, every object key right before its value.
+ */
+struct JsonLazyValue {
+	size_t _offset;
+
+	size_t _skip; /* entries taken by the value and everything inside it */
+
+	size_t _size; /* elements of an array, members of an object, bytes between the quotes of a string */
+};
+
+/* where the last lookup in a container ended, so that walking it in order is linear */
+struct JsonLazyCursor {
+	const JsonLazyValue* _parent;
+
+	const JsonLazyValue* _child; /* an element, or the key of a member */
+
+	size_t _index;
+};
+
+/* a value GetLazyValue has decoded */
+struct JsonLazyCached {
+	const JsonLazyValue* _entry;
+
+	JsonValue* _value;
+};
+
+/*
+ * JsonParseLazy validates the whole input (the result is the same as JsonParse) but only records
+ * where each value is. Nothing is decoded until GetLazyValue asks for a value, which is then
+ * built from the document arena and cached. json is not copied and must outlive the document.
+ */
+struct JsonLazyDocument {
+	const char* _json;
+
+	size_t _length;
+
+	JsonContext _tape; /* the JsonLazyValue entries */
+
+	JsonContext _context, _values; /* scanning and decoding stacks */
+
+	JsonArena _arena; /* decoded values */
+
+	JsonLazyCached* _cache; /* open addressing over a power of two slots */
+
+	size_t _cacheCapacity, _cacheCount;
+
+	JsonLazyCursor _cursors[JSON_LAZY_CURSOR_COUNT]; /* most recently used first */
+
+	/* the tape, stacks, arena and cache come from allocator, which Free keeps */
+	void Init(const JsonAllocator* allocator = nullptr);
+
+	void Free();
+};
+
+/* recycles memory of whatever doc held before; values it handed out become invalid */
+RetType JsonParseLazy(JsonLazyDocument* doc, const char* json, size_t length);
+
+const JsonLazyValue* GetLazyRoot(const JsonLazyDocument* doc);
+
+JsonType GetLazyType(const JsonLazyDocument* doc, const JsonLazyValue* val);
+
+size_t GetLazyArraySize(const JsonLazyDocument* doc, const JsonLazyValue* val);
+
+/*
+ * Skips over the elements before it without looking inside them, starting from the last lookup
+ * in the same container when that was at an earlier index. The last JSON_LAZY_CURSOR_COUNT
+ * containers looked into are remembered, so nested loops up to that deep stay linear.
+ */
+const JsonLazyValue* GetLazyArrayElement(JsonLazyDocument* doc, const JsonLazyValue* val, size_t index);
+
+size_t GetLazyObjSize(const JsonLazyDocument* doc, const JsonLazyValue* val);
+
+/* the key as a string value */
+const JsonLazyValue* GetLazyObjKey(JsonLazyDocument* doc, const JsonLazyValue* val, size_t index);
+
+const JsonLazyValue* GetLazyObjValue(JsonLazyDocument* doc, const JsonLazyValue* val, size_t index);
+
+/*
+ * The value of a member named key, nullptr if there is none. The search starts at the member
+ * looked up last in the same object and wraps around, so if keys repeat, which one is found depends
+ * on that. Keys are compared in the input unless they hold escapes.
+ */
+const JsonLazyValue* FindLazyObjValue(JsonLazyDocument* doc, const JsonLazyValue* val, const char* key, size_t size);
+
+/* decodes val with its whole subtree on first use; the result lives as long as the document's parse */
+JsonValue* GetLazyValue(JsonLazyDocument* doc, const JsonLazyValue* val);
+
+/*
+ * Paths compiled into one trie for JsonParseProjected. A path is a JSON Pointer (RFC 6901:
+ * "" is the whole document, "/user/id" a member of a member, ~0 and ~1 stand for ~ and /)
+ * where a segment that is a single * matches every member or element, so no key * can be asked
+ * for. A numeric segment matches an array element as well as a member of that name.
+ */
+struct JsonPathSet {
+	JsonContext _nodes; /* trie nodes, the root first */
+
+	JsonContext _names; /* the unescaped segment of every node */
+
+	JsonContext _refs; /* the paths ending at each node */
+
+	size_t _pathCount;
+
+	void Init(const JsonAllocator* allocator = nullptr);
+
+	void Free();
+};
+
+/* replaces what set held; false with set empty if a path does not start with / */
+bool JsonCompilePaths(JsonPathSet* set, const char* const* paths, size_t count);
+
+struct JsonPathMatch {
+	size_t _path; /* index into the paths given to JsonCompilePaths */
+
+	const JsonValue* _val;
+};
+
+/*
+ * The values JsonParseProjected selected, in document order; a value that several paths select
+ * is reported once for each. They live in the projection's arena until the next parse into it.
+ */
+struct JsonProjection {
+	JsonArena _arena;
+
+	JsonContext _matches; /* the JsonPathMatch entries */
+
+	JsonContext _context, _values; /* parsing stacks */
+
+	void Init(const JsonAllocator* allocator = nullptr);
+
+	void Free();
+};
+
+/*
+ * Builds only the values the paths select, and what is inside them. Every subtree no path leads
+ * into is stepped over by matching brackets outside strings, a block of input at a time, without
+ * being parsed, so the cost follows the selection more than the document. The skipped text is
+ * not validated: an error in it may go unnoticed or be reported as a missing bracket.
+ * Where a key repeats, every member of that name is projected, as JsonParse keeps them all.
+ */
+RetType JsonParseProjected(JsonProjection* proj, const JsonPathSet* set, const char* json, size_t length);
+
+size_t GetMatchCount(const JsonProjection* proj);
+
+const JsonPathMatch* GetMatch(const JsonProjection* proj, size_t index);
+
 char* JsonStringify(const JsonValue* val,size_t* size);
 
+/* the text is built in memory from allocator, which the caller gives back to it */
+char* JsonStringify(const JsonValue* val, size_t* size, const JsonAllocator* allocator);
+
+/*
+ * What parses and stringifies did, for the overloads below. Every call adds to the collector, so
+ * one can cover a parse and the stringify of its result or a whole batch; maxima stay maxima.
+ * Only a library built with ST_JSON_STATS defined fills it in; otherwise the overloads are the
+ * plain calls and the collector keeps what Init gave it.
+ */
+struct JsonStats {
+	size_t _bytes;          /* input read by a parse, up to the error if it failed; text written by stringify */
+
+	/* values by JsonType, keys not included; none for a failed parse */
+	size_t _nodes[static_cast<size_t>(JsonType::JSON_OBJECT) + 1];
+
+	size_t _stringBytes;    /* string and key bytes, unescaped */
+
+	size_t _escapedBytes;   /* bytes of escape sequences read or written */
+
+	size_t _allocs;         /* malloc, calloc and realloc calls; a document arena counts its chunks */
+
+	size_t _allocBytes;
+
+	size_t _stackHighWater; /* most bytes held by one JsonContext stack */
+
+	size_t _stackReallocs;
+
+	size_t _maxDepth;       /* most arrays and objects open at once */
+
+	double _clearSeconds;   /* recycling the arena and keys of a document */
+
+	double _parseSeconds;   /* reading the input and building the tree */
+
+	double _stringifySeconds;
+
+	void Init();
+};
+
+RetType JsonParse(JsonValue* val, const char* json, size_t length, JsonStats* stats);
+
+RetType JsonParse(JsonDocument* doc, const char* json, size_t length, JsonStats* stats);
+
+char* JsonStringify(const JsonValue* val, size_t* size, JsonStats* stats);
+
+/*
+ * Binary forms of a tree for caches and stores: CBOR (RFC 8949) and MessagePack. Strings and
+ * containers go out with their lengths in front, so decoding allocates every block at its final
+ * size. Whole numbers are written as the shortest integer that holds them, others as a float32
+ * when that is exact and as a float64 otherwise. The buffer comes from allocator, the caller gives
+ * it back; MessagePack gives nullptr if a string or container has 2^32 or more bytes, elements
+ * or members.
+ */
+char* JsonEncodeCbor(const JsonValue* val, size_t* size, const JsonAllocator* allocator = nullptr);
+
+char* JsonEncodeMsgPack(const JsonValue* val, size_t* size, const JsonAllocator* allocator = nullptr);
+
+/*
+ * Decoding takes what the encoders write and whatever else JSON can hold: integers and floats of
+ * every width, as doubles, tags, which are dropped, and CBOR's undefined, as null. Indefinite
+ * lengths, byte strings, extension types, keys that are not strings and data that ends inside
+ * an item are PARSE_INVALID_BINARY; bytes after the item are PARSE_ROOT_NOT_SINGULAR. Strings
+ * are taken as they are, without checking that they are UTF-8.
+ */
+RetType JsonDecodeCbor(JsonValue* val, const char* data, size_t size, const JsonAllocator* allocator = nullptr);
+
+RetType JsonDecodeCbor(JsonDocument* doc, const char* data, size_t size);
+
+RetType JsonDecodeMsgPack(JsonValue* val, const char* data, size_t size, const JsonAllocator* allocator = nullptr);
+
+RetType JsonDecodeMsgPack(JsonDocument* doc, const char* data, size_t size);
+
+/*
+ * A value of a frozen tree: JsonValue's layout, with the pointer replaced by the distance in bytes
+ * from the value to its string, elements or members, so a frozen tree works wherever it is loaded.
+ */
+struct JsonFrozenValue {
+	union {
+		struct {
+			union {
+				double _number;
+
+				int64_t _offset;
+			};
+
+			uint32_t _sizeLow;
+
+			uint16_t _sizeHigh;
+
+			unsigned char _flags; /* JSON_VALUE_SHORT or 0 */
+
+			JsonType _type;
+		};
+
+		char _short[JSON_SHORT_STRING_MAX_SIZE + 1];
+	};
+
+	size_t Size() const {
+		return static_cast<size_t>(static_cast<uint64_t>(_sizeHigh) << 32 | _sizeLow);
+	}
+};
+
+struct JsonFrozenMember {
+	int64_t _keyOffset; /* from the member to its key */
+
+	uint64_t _keySize;
+
+	JsonFrozenValue _val;
+};
+
+/*
+ * Freezes a tree into one block holding a header, the values, the strings with their NULs (each
+ * distinct key once) and the hash index of every wide object, with no pointers in it. Written to
+ * a file and mapped with JsonMappedFile, it is read in place: JsonFrozenRoot looks at the header
+ * only, and the accessors below follow offsets, so loading costs nothing however big the tree
+ * is, and processes mapping the same file share its pages. The image is in the byte order of
+ * the machine that froze it. The buffer comes from allocator, the caller gives it back.
+ */
+char* JsonFreeze(const JsonValue* val, size_t* size, const JsonAllocator* allocator = nullptr);
+
+/* freezes into a file, replacing it; false if it cannot be written */
+bool JsonFreezeFile(const JsonValue* val, const char* path, const JsonAllocator* allocator = nullptr);
+
+/*
+ * The root of a frozen image, nullptr if the header is not that of an image of this size frozen
+ * with this byte order, or image is not 8-byte aligned. Nothing past the header is checked, so
+ * the image has to come from JsonFreeze.
+ */
+const JsonFrozenValue* JsonFrozenRoot(const void* image, size_t size);
+
+JsonType GetType(const JsonFrozenValue* val);
+
+double GetNumber(const JsonFrozenValue* val);
+
+bool GetBoolean(const JsonFrozenValue* val);
+
+/* NUL-terminated, inside the image */
+const char* GetString(const JsonFrozenValue* val);
+
+size_t GetStringSize(const JsonFrozenValue* val);
+
+size_t GetArraySize(const JsonFrozenValue* val);
+
+const JsonFrozenValue* GetArrayElement(const JsonFrozenValue* val, size_t index);
+
+size_t GetObjSize(const JsonFrozenValue* val);
+
+const char* GetObjKey(const JsonFrozenValue* val, size_t index);
+
+size_t GetObjKeySize(const JsonFrozenValue* val, size_t index);
+
+const JsonFrozenValue* GetObjValue(const JsonFrozenValue* val, size_t index);
+
+/* as for a JsonValue, except that the index of a wide object is frozen with it and never written */
+size_t FindObjIndex(const JsonFrozenValue* val, const char* key, size_t size);
+
+const JsonFrozenValue* FindObjValue(const JsonFrozenValue* val, const char* key, size_t size);
+
+/* takes the next piece of output; returning false fails the writer */
+typedef bool (*JsonSinkCallback)(const char* data, size_t size, void* user);
+
+/*
+ * Serializes into a buffer of JSON_WRITER_BUFFER_SIZE bytes that goes to the sink whenever it
+ * fills, so output of any size is written with that buffer and a few bytes per open container.
+ * Value writes a whole tree; the calls named like the reader events build output with no tree
+ * at all, and a JsonWriter can be handed to JsonParseSax to reformat input as it is read.
+ * Top-level values are separated by newlines. Every call returns false once the sink has
+ * failed; what was still buffered then is lost. Call Flush at the end, then Free.
+ */
+struct JsonWriter {
+	JsonSinkCallback _sink;
+
+	void* _user;
+
+	char* _buffer;
+
+	size_t _used;
+
+	size_t _written; /* bytes handed to the sink */
+
+	JsonContext _frames; /* members or elements written so far, and the kind, of every open container */
+
+	bool _afterKey; /* a key was written and its value is due */
+
+	bool _started; /* a top-level value has been begun */
+
+	bool _failed;
+
+	/* the buffer and the frames come from allocator */
+	void Init(JsonSinkCallback sink, void* user, const JsonAllocator* allocator = nullptr);
+
+	/* writes with fwrite, the file stays open */
+	void Init(FILE* file, const JsonAllocator* allocator = nullptr);
+
+	/* writes with write(2), the descriptor stays open */
+	void Init(int fd, const JsonAllocator* allocator = nullptr);
+
+	/* releases the buffers without flushing */
+	void Free();
+
+	bool Flush();
+
+	bool Null();
+
+	bool Bool(bool b);
+
+	bool Number(double d);
+
+	bool String(const char* str, size_t size);
+
+	bool StartObject();
+
+	bool Key(const char* str, size_t size);
+
+	/* the counts let the writer act as a reader handler, they are not checked */
+	bool EndObject(size_t memberCount = 0);
+
+	bool StartArray();
+
+	bool EndArray(size_t elementCount = 0);
+
+	/* val with its whole subtree, wherever a value may go */
+	bool Value(const JsonValue* val);
+};
+
 JsonType GetType(const JsonValue* val);
 
 double GetNumber(const JsonValue* val);
@@ -123,10 +807,109 @@ size_t GetObjKeySize(const JsonValue* val, size_t index);
 
 JsonValue* GetObjValue(const JsonValue* val, size_t index);
 
+#define JSON_KEY_NOT_EXIST (static_cast<size_t>(-1))
+
+/*
+ * The index of the first member named key, or JSON_KEY_NOT_EXIST. Objects of at least
+ * JSON_OBJ_INDEX_MIN_SIZE members are looked up through a hash index kept after their members;
+ * narrower than JSON_OBJ_INDEX_EAGER_SIZE, the first lookup builds it, which writes to the object,
+ * so threads sharing a tree must not make that first lookup at the same time.
+ */
+size_t FindObjIndex(const JsonValue* val, const char* key, size_t size);
+
+/* the value of the first member named key, nullptr if there is none */
+JsonValue* FindObjValue(const JsonValue* val, const char* key, size_t size);
+
 void SetBoolean(JsonValue* val, bool b);
 
 void SetNumber(JsonValue* val, double n);
 
+/*
+ * A string that does not fit in the value comes from the allocator of the block val held, so
+ * edits stay with the tree they are in; a value that held none, a new element or member value
+ * among them, gets the heap. The overload takes the allocator to use; GetAllocator of the
+ * container gives the one of its tree.
+ */
 void SetString(JsonValue* val, const char* str, size_t size);
 
+void SetString(JsonValue* val, const char* str, size_t size, const JsonAllocator* allocator);
+
+/* where the string or container block of val came from, nullptr for the heap or no block */
+const JsonAllocator* GetAllocator(const JsonValue* val);
+
+/* frees dst, hands it what src held and leaves src null, nothing is copied */
+void JsonMove(JsonValue* dst, JsonValue* src);
+
+void JsonSwap(JsonValue* lhs, JsonValue* rhs);
+
+/*
+ * Replaces dst with a copy of src and everything in it, owned by dst; src may be inside dst.
+ * The copy comes from the allocator of dst's block, like SetString, or from allocator.
+ */
+void JsonCopy(JsonValue* dst, const JsonValue* src);
+
+void JsonCopy(JsonValue* dst, const JsonValue* src, const JsonAllocator* allocator);
+
+/* makes a copy of src the root of doc, in its arena, without clearing what doc held */
+void JsonCopy(JsonDocument* doc, const JsonValue* src);
+
+/*
+ * Frees what was set or built into the tree of doc after parsing, which is on the heap, and leaves
+ * the root null; the arena is untouched. Unlike JsonDocument::Free this walks the whole tree.
+ */
+void JsonFreeEdits(JsonDocument* doc);
+
+/*
+ * Building trees in place. SetArray and SetObject make an empty container with room for capacity
+ * elements or members; adding more grows the room by half, so appending is amortized constant.
+ * Parsed containers can be changed too: the first time one needs room it moves to the heap, and
+ * from then on it is owned like a built one. Pointers to elements or members are invalidated by
+ * anything that grows, inserts or erases. New elements and member values start out null, to be
+ * filled by the setters or JsonMove. A container keeps the allocator of its block as it grows,
+ * and its new keys come from it; SetArray and SetObject pick one as SetString does.
+ */
+void SetArray(JsonValue* val, size_t capacity);
+
+void SetArray(JsonValue* val, size_t capacity, const JsonAllocator* allocator);
+
+size_t GetArrayCapacity(const JsonValue* val);
+
+void ReserveArray(JsonValue* val, size_t capacity);
+
+/* gives back the room beyond the size */
+void ShrinkArray(JsonValue* val);
+
+/* frees the elements and keeps the room */
+void ClearArray(JsonValue* val);
+
+JsonValue* PushBackArrayElement(JsonValue* val);
+
+void PopBackArrayElement(JsonValue* val);
+
+/* a new element at index, the ones from there on move up */
+JsonValue* InsertArrayElement(JsonValue* val, size_t index);
+
+void EraseArrayElement(JsonValue* val, size_t index, size_t count);
+
+void SetObject(JsonValue* val, size_t capacity);
+
+void SetObject(JsonValue* val, size_t capacity, const JsonAllocator* allocator);
+
+size_t GetObjCapacity(const JsonValue* val);
+
+void ReserveObj(JsonValue* val, size_t capacity);
+
+void ShrinkObj(JsonValue* val);
+
+void ClearObj(JsonValue* val);
+
+/*
+ * The value of the first member named key; a new member at the end, with a copy of key, if there
+ * is none. Appending keeps a built hash index, other changes make the next lookup rebuild it.
+ */
+JsonValue* SetObjectValue(JsonValue* val, const char* key, size_t size);
+
+/* the members after index move down */
+void RemoveObjectValue(JsonValue* val, size_t index);
+
 }
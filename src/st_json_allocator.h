@@ -0,0 +1,66 @@
+#pragma once
+#include "st_json.h"
+
+#include <cassert>
+#include <cstdlib>
+
+namespace ST_JSON {
+
+/*
+ * A JsonAllocator calling a C++ policy object, any type with these members:
+ *
+ *   void* Malloc(size_t size);
+ *   void* Realloc(void* ptr, size_t size);
+ *   void Free(void* ptr);
+ *
+ * The library still calls through the function pointers, which forward to the policy. The
+ * policy has to outlive the allocator and everything allocated through it.
+ */
+template <typename Policy>
+JsonAllocator MakeJsonAllocator(Policy* policy);
+
+/* the heap as a policy, for wrapping */
+struct JsonMallocPolicy {
+	void* Malloc(size_t size) {
+		return malloc(size);
+	}
+
+	void* Realloc(void* ptr, size_t size) {
+		return realloc(ptr, size);
+	}
+
+	void Free(void* ptr) {
+		free(ptr);
+	}
+};
+
+namespace INTERNAL {
+
+template <typename Policy>
+struct PolicyCalls {
+	static void* Malloc(void* user, size_t size) {
+		return static_cast<Policy*>(user)->Malloc(size);
+	}
+
+	static void* Realloc(void* user, void* ptr, size_t size) {
+		return static_cast<Policy*>(user)->Realloc(ptr, size);
+	}
+
+	static void Free(void* user, void* ptr) {
+		static_cast<Policy*>(user)->Free(ptr);
+	}
+};
+
+}
+
+template <typename Policy>
+JsonAllocator MakeJsonAllocator(Policy* policy) {
+	assert(policy!=nullptr);
+	JsonAllocator allocator = {
+		&INTERNAL::PolicyCalls<Policy>::Malloc, &INTERNAL::PolicyCalls<Policy>::Realloc,
+		&INTERNAL::PolicyCalls<Policy>::Free, policy
+	};
+	return allocator;
+}
+
+}
@@ -0,0 +1,653 @@
+#include "st_json.h"
+#include "st_json_internal.h"
+
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+using namespace ST_JSON;
+using namespace ST_JSON::INTERNAL;
+
+/* 2^64 and 2^63, exact as doubles: integers are written from -2^63 up to 2^64 - 1 */
+#define BINARY_TWO_64 18446744073709551616.0
+#define BINARY_TWO_63 9223372036854775808.0
+
+/* the output grows on a JsonContext stack, as JsonStringify's does */
+static void InitOutput(JsonContext* out, const JsonAllocator* allocator) {
+	InitStack(out, allocator);
+	out->_size  = JSON_STRINGIFY_STACK_INIT_SIZE;
+	out->_stack = static_cast<char*>(AllocMemory(allocator, JSON_STRINGIFY_STACK_INIT_SIZE));
+	out->_end   = nullptr;
+}
+
+static void PutByte(JsonContext* out, unsigned char byte) {
+	*static_cast<unsigned char*>(out->Push(1)) = byte;
+}
+
+/* the low bytes of n, most significant first, as both formats have them */
+static void PutBigEndian(JsonContext* out, uint64_t n, size_t bytes) {
+	unsigned char* p = static_cast<unsigned char*>(out->Push(bytes));
+	for (size_t i = bytes; i-- != 0; n >>= 8)
+		p[i] = static_cast<unsigned char>(n);
+}
+
+static void PutBytes(JsonContext* out, const char* data, size_t size) {
+	if (size != 0)
+		memcpy(out->Push(size), data, size);
+}
+
+/* a number both formats can write as an integer: whole, in range, and not -0 */
+static bool IsWhole(double d) {
+	return d >= -BINARY_TWO_63 && d < BINARY_TWO_64 && d == std::floor(d) && !(d == 0 && std::signbit(d));
+}
+
+static bool IsFloat32(double d) {
+	return std::fabs(d) <= FLT_MAX && static_cast<double>(static_cast<float>(d)) == d;
+}
+
+static uint32_t Float32Bits(double d) {
+	float f = static_cast<float>(d);
+	uint32_t bits;
+	memcpy(&bits, &f, 4);
+	return bits;
+}
+
+static uint64_t Float64Bits(double d) {
+	uint64_t bits;
+	memcpy(&bits, &d, 8);
+	return bits;
+}
+
+/* major type in the top three bits, then the argument in the low five or in 1, 2, 4 or 8 more bytes */
+static void PutCborHead(JsonContext* out, unsigned major, uint64_t arg) {
+	major <<= 5;
+	if (arg < 24)
+		PutByte(out, static_cast<unsigned char>(major | arg));
+	else if (arg <= 0xFF) {
+		PutByte(out, static_cast<unsigned char>(major | 24));
+		PutBigEndian(out, arg, 1);
+	}
+	else if (arg <= 0xFFFF) {
+		PutByte(out, static_cast<unsigned char>(major | 25));
+		PutBigEndian(out, arg, 2);
+	}
+	else if (arg <= 0xFFFFFFFF) {
+		PutByte(out, static_cast<unsigned char>(major | 26));
+		PutBigEndian(out, arg, 4);
+	}
+	else {
+		PutByte(out, static_cast<unsigned char>(major | 27));
+		PutBigEndian(out, arg, 8);
+	}
+}
+
+static void EncodeCbor(JsonContext* out, const JsonValue* val) {
+	switch (GetType(val)) {
+		case JsonType::JSON_NULL: PutByte(out, 0xF6);
+			break;
+		case JsonType::JSON_FALSE: PutByte(out, 0xF4);
+			break;
+		case JsonType::JSON_TRUE: PutByte(out, 0xF5);
+			break;
+		case JsonType::JSON_NUMBER: {
+			double d = GetNumber(val);
+			/* a negative integer n is stored as -1 - n */
+			if (IsWhole(d) && d >= 0)
+				PutCborHead(out, 0, static_cast<uint64_t>(d));
+			else if (IsWhole(d))
+				PutCborHead(out, 1, static_cast<uint64_t>(-1 - static_cast<int64_t>(d)));
+			else if (IsFloat32(d)) {
+				PutByte(out, 0xFA);
+				PutBigEndian(out, Float32Bits(d), 4);
+			}
+			else {
+				PutByte(out, 0xFB);
+				PutBigEndian(out, Float64Bits(d), 8);
+			}
+			break;
+		}
+		case JsonType::JSON_STRING:
+			PutCborHead(out, 3, GetStringSize(val));
+			PutBytes(out, GetString(val), GetStringSize(val));
+			break;
+		case JsonType::JSON_ARRAY:
+			PutCborHead(out, 4, val->Size());
+			for (size_t i = 0; i < val->Size(); ++i)
+				EncodeCbor(out, &val->_arrData[i]);
+			break;
+		case JsonType::JSON_OBJECT:
+			PutCborHead(out, 5, val->Size());
+			for (size_t i = 0; i < val->Size(); ++i) {
+				PutCborHead(out, 3, val->_objData[i]._keySize);
+				PutBytes(out, val->_objData[i]._key, val->_objData[i]._keySize);
+				EncodeCbor(out, &val->_objData[i]._val);
+			}
+			break;
+		default: assert(0&&"invalid type");
+	}
+}
+
+/* fix is the one-byte form for lengths up to fixMax, then the 8-bit (strings only), 16-bit and 32-bit forms */
+static bool PutMsgPackLength(JsonContext* out, size_t size, unsigned char fix, size_t fixMax, unsigned char op8,
+                             unsigned char op16) {
+	if (size <= fixMax)
+		PutByte(out, static_cast<unsigned char>(fix | size));
+	else if (op8 != 0 && size <= 0xFF) {
+		PutByte(out, op8);
+		PutBigEndian(out, size, 1);
+	}
+	else if (size <= 0xFFFF) {
+		PutByte(out, op16);
+		PutBigEndian(out, size, 2);
+	}
+	else if (static_cast<uint64_t>(size) <= 0xFFFFFFFF) {
+		PutByte(out, static_cast<unsigned char>(op16 + 1));
+		PutBigEndian(out, size, 4);
+	}
+	else
+		return false;
+	return true;
+}
+
+static void PutMsgPackInteger(JsonContext* out, double d) {
+	if (d >= 0) {
+		uint64_t n = static_cast<uint64_t>(d);
+		if (n <= 0x7F)
+			PutByte(out, static_cast<unsigned char>(n));
+		else if (n <= 0xFF) {
+			PutByte(out, 0xCC);
+			PutBigEndian(out, n, 1);
+		}
+		else if (n <= 0xFFFF) {
+			PutByte(out, 0xCD);
+			PutBigEndian(out, n, 2);
+		}
+		else if (n <= 0xFFFFFFFF) {
+			PutByte(out, 0xCE);
+			PutBigEndian(out, n, 4);
+		}
+		else {
+			PutByte(out, 0xCF);
+			PutBigEndian(out, n, 8);
+		}
+		return;
+	}
+	int64_t n = static_cast<int64_t>(d);
+	if (n >= -32)
+		PutByte(out, static_cast<unsigned char>(n));
+	else if (n >= INT8_MIN) {
+		PutByte(out, 0xD0);
+		PutBigEndian(out, static_cast<uint64_t>(n), 1);
+	}
+	else if (n >= INT16_MIN) {
+		PutByte(out, 0xD1);
+		PutBigEndian(out, static_cast<uint64_t>(n), 2);
+	}
+	else if (n >= INT32_MIN) {
+		PutByte(out, 0xD2);
+		PutBigEndian(out, static_cast<uint64_t>(n), 4);
+	}
+	else {
+		PutByte(out, 0xD3);
+		PutBigEndian(out, static_cast<uint64_t>(n), 8);
+	}
+}
+
+static bool EncodeMsgPack(JsonContext* out, const JsonValue* val) {
+	switch (GetType(val)) {
+		case JsonType::JSON_NULL: PutByte(out, 0xC0);
+			return true;
+		case JsonType::JSON_FALSE: PutByte(out, 0xC2);
+			return true;
+		case JsonType::JSON_TRUE: PutByte(out, 0xC3);
+			return true;
+		case JsonType::JSON_NUMBER: {
+			double d = GetNumber(val);
+			if (IsWhole(d))
+				PutMsgPackInteger(out, d);
+			else if (IsFloat32(d)) {
+				PutByte(out, 0xCA);
+				PutBigEndian(out, Float32Bits(d), 4);
+			}
+			else {
+				PutByte(out, 0xCB);
+				PutBigEndian(out, Float64Bits(d), 8);
+			}
+			return true;
+		}
+		case JsonType::JSON_STRING:
+			if (!PutMsgPackLength(out, GetStringSize(val), 0xA0, 31, 0xD9, 0xDA))
+				return false;
+			PutBytes(out, GetString(val), GetStringSize(val));
+			return true;
+		case JsonType::JSON_ARRAY:
+			if (!PutMsgPackLength(out, val->Size(), 0x90, 15, 0, 0xDC))
+				return false;
+			for (size_t i = 0; i < val->Size(); ++i) {
+				if (!EncodeMsgPack(out, &val->_arrData[i]))
+					return false;
+			}
+			return true;
+		case JsonType::JSON_OBJECT:
+			if (!PutMsgPackLength(out, val->Size(), 0x80, 15, 0, 0xDE))
+				return false;
+			for (size_t i = 0; i < val->Size(); ++i) {
+				const JsonObjMember* m = &val->_objData[i];
+				if (!PutMsgPackLength(out, m->_keySize, 0xA0, 31, 0xD9, 0xDA))
+					return false;
+				PutBytes(out, m->_key, m->_keySize);
+				if (!EncodeMsgPack(out, &m->_val))
+					return false;
+			}
+			return true;
+		default: assert(0&&"invalid type");
+			return false;
+	}
+}
+
+char* ST_JSON::JsonEncodeCbor(const JsonValue* val, size_t* size, const JsonAllocator* allocator) {
+	assert(val!=nullptr);
+	JsonContext out;
+	InitOutput(&out, allocator);
+	EncodeCbor(&out, val);
+	if (size)
+		*size = out._top;
+	return out._stack;
+}
+
+char* ST_JSON::JsonEncodeMsgPack(const JsonValue* val, size_t* size, const JsonAllocator* allocator) {
+	assert(val!=nullptr);
+	JsonContext out;
+	InitOutput(&out, allocator);
+	if (!EncodeMsgPack(&out, val)) {
+		FreeMemory(allocator, out._stack);
+		return nullptr;
+	}
+	if (size)
+		*size = out._top;
+	return out._stack;
+}
+
+/*
+ * Decoding. Containers are allocated at their stated size, filled with nulls, and then decoded
+ * into in place, so the tree is whole at every step and a failure frees it like any other.
+ */
+struct BinaryReader {
+	const unsigned char* _p;
+
+	const unsigned char* _end;
+
+	JsonArena* _arena;
+
+	JsonKeyTable* _keys;
+
+	const JsonAllocator* _allocator; /* for the tree when there is no arena */
+};
+
+static size_t Remaining(const BinaryReader* reader) {
+	return static_cast<size_t>(reader->_end - reader->_p);
+}
+
+static bool ReadBigEndian(BinaryReader* reader, size_t bytes, uint64_t* n) {
+	if (Remaining(reader) < bytes)
+		return false;
+	*n = 0;
+	for (size_t i = 0; i < bytes; ++i)
+		*n = *n << 8 | *reader->_p++;
+	return true;
+}
+
+static void SetDecodedNumber(JsonValue* val, double d) {
+	val->_type   = JsonType::JSON_NUMBER;
+	val->_number = d;
+}
+
+static double Float32Value(uint64_t bits) {
+	uint32_t b = static_cast<uint32_t>(bits);
+	float f;
+	memcpy(&f, &b, 4);
+	return f;
+}
+
+static double Float64Value(uint64_t bits) {
+	double d;
+	memcpy(&d, &bits, 8);
+	return d;
+}
+
+/* RFC 8949, appendix D */
+static double Float16Value(uint64_t bits) {
+	unsigned exponent = static_cast<unsigned>(bits >> 10 & 0x1F);
+	unsigned mantissa = static_cast<unsigned>(bits & 0x3FF);
+	double d          = exponent == 0
+		                    ? std::ldexp(mantissa, -24)
+		                    : exponent != 31
+		                    ? std::ldexp(mantissa + 1024, static_cast<int>(exponent) - 25)
+		                    : mantissa == 0
+		                    ? HUGE_VAL
+		                    : NAN;
+	return bits & 0x8000
+		       ? -d
+		       : d;
+}
+
+static RetType SetDecodedString(BinaryReader* reader, JsonValue* val, uint64_t size) {
+	if (size > Remaining(reader))
+		return RetType::PARSE_INVALID_BINARY;
+	const char* str = reinterpret_cast<const char*>(reader->_p);
+	reader->_p += size;
+	if (size <= JSON_SHORT_STRING_MAX_SIZE) {
+		SetShortString(val, str, static_cast<size_t>(size));
+		return RetType::PARSE_OK;
+	}
+	val->_type  = JsonType::JSON_STRING;
+	val->_str   = CopyString(reader->_arena, str, static_cast<size_t>(size), reader->_allocator);
+	val->_flags = TreeFlags(reader->_arena, reader->_allocator);
+	val->SetSize(static_cast<size_t>(size));
+	return RetType::PARSE_OK;
+}
+
+/* every element takes at least a byte, so a count larger than what is left is a lie, not a reason to allocate */
+static JsonValue* SetDecodedArray(BinaryReader* reader, JsonValue* val, uint64_t count) {
+	if (count > Remaining(reader))
+		return nullptr;
+	JsonValue* elements = nullptr;
+	if (count != 0) {
+		elements = static_cast<JsonValue*>(
+			AllocTree(reader->_arena, static_cast<size_t>(count) * sizeof(JsonValue), reader->_allocator));
+		for (size_t i = 0; i < count; ++i)
+			elements[i].Init();
+	}
+	val->_type    = JsonType::JSON_ARRAY;
+	val->_arrData = elements;
+	val->_flags   = TreeFlags(reader->_arena, reader->_allocator);
+	val->SetSize(static_cast<size_t>(count));
+	return elements;
+}
+
+static JsonObjMember* SetDecodedObject(BinaryReader* reader, JsonValue* val, uint64_t count) {
+	if (count > Remaining(reader) / 2)
+		return nullptr;
+	JsonObjMember* members = nullptr;
+	size_t n               = static_cast<size_t>(count);
+	if (n != 0) {
+		members = static_cast<JsonObjMember*>(
+			AllocTree(reader->_arena, n * sizeof(JsonObjMember) + ObjIndexBytes(n), reader->_allocator));
+		for (size_t i = 0; i < n; ++i) {
+			members[i]._key          = nullptr;
+			members[i]._keySize      = 0;
+			members[i]._keyBorrowed  = true;
+			members[i]._keyAllocated = false;
+			members[i]._val.Init();
+		}
+	}
+	val->_type    = JsonType::JSON_OBJECT;
+	val->_objData = members;
+	val->_flags   = TreeFlags(reader->_arena, reader->_allocator);
+	val->SetSize(n);
+	return members;
+}
+
+static RetType SetDecodedKey(BinaryReader* reader, JsonObjMember* member, uint64_t size) {
+	if (size > Remaining(reader))
+		return RetType::PARSE_INVALID_BINARY;
+	const char* key = reinterpret_cast<const char*>(reader->_p);
+	reader->_p += size;
+	member->_keySize = static_cast<size_t>(size);
+	if (reader->_keys) {
+		member->_key = const_cast<char*>(InternKey(reader->_keys, reader->_arena, key, member->_keySize, false));
+		member->_keyBorrowed = true;
+	}
+	else {
+		member->_key          = CopyString(reader->_arena, key, member->_keySize, reader->_allocator);
+		member->_keyBorrowed  = reader->_arena != nullptr;
+		member->_keyAllocated = !reader->_arena && reader->_allocator;
+	}
+	return RetType::PARSE_OK;
+}
+
+/* the members are all in, the hash index can be laid out behind them as the parser does */
+static void FinishDecodedObject(JsonValue* val) {
+	if (ObjIndexBytes(val->Size()) != 0) {
+		*ObjIndexOf(val) = 0;
+		if (val->Size() >= JSON_OBJ_INDEX_EAGER_SIZE)
+			BuildObjIndex(val);
+	}
+}
+
+/* the initial byte split in two and the argument after it; tags are read past, indefinite lengths refused */
+static RetType ReadCborHead(BinaryReader* reader, unsigned* major, unsigned* info, uint64_t* arg) {
+	for (;;) {
+		if (reader->_p == reader->_end)
+			return RetType::PARSE_INVALID_BINARY;
+		unsigned char initial = *reader->_p++;
+		*major                = initial >> 5;
+		*info                 = initial & 0x1F;
+		if (*info < 24)
+			*arg = *info;
+		else if (*info > 27 || !ReadBigEndian(reader, static_cast<size_t>(1) << (*info - 24), arg))
+			return RetType::PARSE_INVALID_BINARY;
+		if (*major != 6)
+			return RetType::PARSE_OK;
+	}
+}
+
+static RetType DecodeCbor(BinaryReader* reader, JsonValue* val) {
+	unsigned major, info;
+	uint64_t arg;
+	RetType ret;
+	if ((ret = ReadCborHead(reader, &major, &info, &arg)) != RetType::PARSE_OK)
+		return ret;
+	switch (major) {
+		case 0: SetDecodedNumber(val, static_cast<double>(arg));
+			return RetType::PARSE_OK;
+		case 1: SetDecodedNumber(val, -1.0 - static_cast<double>(arg));
+			return RetType::PARSE_OK;
+		case 3: return SetDecodedString(reader, val, arg);
+		case 4: {
+			JsonValue* elements = SetDecodedArray(reader, val, arg);
+			if (!elements && arg != 0)
+				return RetType::PARSE_INVALID_BINARY;
+			for (size_t i = 0; i < arg; ++i) {
+				if ((ret = DecodeCbor(reader, &elements[i])) != RetType::PARSE_OK)
+					return ret;
+			}
+			return RetType::PARSE_OK;
+		}
+		case 5: {
+			JsonObjMember* members = SetDecodedObject(reader, val, arg);
+			if (!members && arg != 0)
+				return RetType::PARSE_INVALID_BINARY;
+			for (size_t i = 0; i < arg; ++i) {
+				uint64_t keySize;
+				if ((ret = ReadCborHead(reader, &major, &info, &keySize)) != RetType::PARSE_OK)
+					return ret;
+				if (major != 3)
+					return RetType::PARSE_INVALID_BINARY;
+				if ((ret = SetDecodedKey(reader, &members[i], keySize)) != RetType::PARSE_OK ||
+					(ret = DecodeCbor(reader, &members[i]._val)) != RetType::PARSE_OK)
+					return ret;
+			}
+			FinishDecodedObject(val);
+			return RetType::PARSE_OK;
+		}
+		case 7:
+			/* simple values up to 23 are the info itself, a float's argument is its bits */
+			switch (info) {
+				case 20: val->_type = JsonType::JSON_FALSE;
+					return RetType::PARSE_OK;
+				case 21: val->_type = JsonType::JSON_TRUE;
+					return RetType::PARSE_OK;
+				case 22:
+				case 23: val->_type = JsonType::JSON_NULL;
+					return RetType::PARSE_OK;
+				case 25: SetDecodedNumber(val, Float16Value(arg));
+					return RetType::PARSE_OK;
+				case 26: SetDecodedNumber(val, Float32Value(arg));
+					return RetType::PARSE_OK;
+				case 27: SetDecodedNumber(val, Float64Value(arg));
+					return RetType::PARSE_OK;
+				default: return RetType::PARSE_INVALID_BINARY;
+			}
+		default: return RetType::PARSE_INVALID_BINARY; /* byte strings */
+	}
+}
+
+/* a two's complement integer of the given width */
+static bool ReadSigned(BinaryReader* reader, size_t bytes, double* d) {
+	uint64_t n;
+	if (!ReadBigEndian(reader, bytes, &n))
+		return false;
+	size_t shift = 64 - 8 * bytes;
+	*d           = static_cast<double>(static_cast<int64_t>(n << shift) >> shift);
+	return true;
+}
+
+static RetType DecodeMsgPack(BinaryReader* reader, JsonValue* val) {
+	if (reader->_p == reader->_end)
+		return RetType::PARSE_INVALID_BINARY;
+	unsigned char op = *reader->_p++;
+	uint64_t n;
+	double d;
+	RetType ret;
+	bool ok = true;
+	if (op <= 0x7F || op >= 0xE0) {
+		SetDecodedNumber(val, static_cast<double>(static_cast<signed char>(op)));
+		return RetType::PARSE_OK;
+	}
+	/* the fix forms carry the length in the low bits, the others in 1, 2 or 4 bytes after the opcode */
+	switch (op) {
+		case 0xC0: val->_type = JsonType::JSON_NULL;
+			return RetType::PARSE_OK;
+		case 0xC2: val->_type = JsonType::JSON_FALSE;
+			return RetType::PARSE_OK;
+		case 0xC3: val->_type = JsonType::JSON_TRUE;
+			return RetType::PARSE_OK;
+		case 0xCA:
+			if ((ok = ReadBigEndian(reader, 4, &n)))
+				SetDecodedNumber(val, Float32Value(n));
+			break;
+		case 0xCB:
+			if ((ok = ReadBigEndian(reader, 8, &n)))
+				SetDecodedNumber(val, Float64Value(n));
+			break;
+		case 0xCC:
+		case 0xCD:
+		case 0xCE:
+		case 0xCF:
+			if ((ok = ReadBigEndian(reader, static_cast<size_t>(1) << (op - 0xCC), &n)))
+				SetDecodedNumber(val, static_cast<double>(n));
+			break;
+		case 0xD0:
+		case 0xD1:
+		case 0xD2:
+		case 0xD3:
+			if ((ok = ReadSigned(reader, static_cast<size_t>(1) << (op - 0xD0), &d)))
+				SetDecodedNumber(val, d);
+			break;
+		case 0xD9:
+		case 0xDA:
+		case 0xDB:
+			if (!ReadBigEndian(reader, static_cast<size_t>(1) << (op - 0xD9), &n))
+				return RetType::PARSE_INVALID_BINARY;
+			return SetDecodedString(reader, val, n);
+		case 0xDC:
+		case 0xDD:
+			if (!ReadBigEndian(reader, static_cast<size_t>(2) << (op - 0xDC), &n))
+				return RetType::PARSE_INVALID_BINARY;
+			op = 0x90;
+			break;
+		case 0xDE:
+		case 0xDF:
+			if (!ReadBigEndian(reader, static_cast<size_t>(2) << (op - 0xDE), &n))
+				return RetType::PARSE_INVALID_BINARY;
+			op = 0x80;
+			break;
+		default:
+			if (op >= 0xA0 && op <= 0xBF)
+				return SetDecodedString(reader, val, op & 0x1F);
+			if (op >= 0x80 && op <= 0x9F) {
+				n  = op & 0x0F;
+				op &= 0xF0;
+			}
+			else
+				return RetType::PARSE_INVALID_BINARY; /* bin, ext and the unused 0xC1 */
+	}
+	if (!ok)
+		return RetType::PARSE_INVALID_BINARY;
+	if (op == 0x90) {
+		JsonValue* elements = SetDecodedArray(reader, val, n);
+		if (!elements && n != 0)
+			return RetType::PARSE_INVALID_BINARY;
+		for (size_t i = 0; i < n; ++i) {
+			if ((ret = DecodeMsgPack(reader, &elements[i])) != RetType::PARSE_OK)
+				return ret;
+		}
+	}
+	else if (op == 0x80) {
+		JsonObjMember* members = SetDecodedObject(reader, val, n);
+		if (!members && n != 0)
+			return RetType::PARSE_INVALID_BINARY;
+		for (size_t i = 0; i < n; ++i) {
+			uint64_t keySize;
+			if (reader->_p == reader->_end)
+				return RetType::PARSE_INVALID_BINARY;
+			unsigned char keyOp = *reader->_p++;
+			if (keyOp >= 0xA0 && keyOp <= 0xBF)
+				keySize = keyOp & 0x1F;
+			else if (keyOp < 0xD9 || keyOp > 0xDB || !ReadBigEndian(reader, static_cast<size_t>(1) << (keyOp - 0xD9), &keySize))
+				return RetType::PARSE_INVALID_BINARY;
+			if ((ret = SetDecodedKey(reader, &members[i], keySize)) != RetType::PARSE_OK ||
+				(ret = DecodeMsgPack(reader, &members[i]._val)) != RetType::PARSE_OK)
+				return ret;
+		}
+		FinishDecodedObject(val);
+	}
+	return RetType::PARSE_OK;
+}
+
+typedef RetType (*BinaryDecoder)(BinaryReader* reader, JsonValue* val);
+
+static RetType DecodeRoot(BinaryDecoder decode, JsonValue* val, const char* data, size_t size, JsonArena* arena,
+                          JsonKeyTable* keys, const JsonAllocator* allocator) {
+	BinaryReader reader;
+	reader._p         = reinterpret_cast<const unsigned char*>(data);
+	reader._end       = reader._p + size;
+	reader._arena     = arena;
+	reader._keys      = keys;
+	reader._allocator = allocator;
+
+	val->Init();
+	RetType ret = decode(&reader, val);
+	if (ret == RetType::PARSE_OK && reader._p != reader._end)
+		ret = RetType::PARSE_ROOT_NOT_SINGULAR;
+	if (ret != RetType::PARSE_OK)
+		val->Free();
+	return ret;
+}
+
+RetType ST_JSON::JsonDecodeCbor(JsonValue* val, const char* data, size_t size, const JsonAllocator* allocator) {
+	assert(val!=nullptr&&(data!=nullptr||size==0));
+	return DecodeRoot(DecodeCbor, val, data, size, nullptr, nullptr, allocator);
+}
+
+RetType ST_JSON::JsonDecodeCbor(JsonDocument* doc, const char* data, size_t size) {
+	assert(doc!=nullptr&&(data!=nullptr||size==0));
+	doc->_arena.Clear();
+	doc->_keys.Clear();
+	return DecodeRoot(DecodeCbor, &doc->_root, data, size, &doc->_arena, &doc->_keys, nullptr);
+}
+
+RetType ST_JSON::JsonDecodeMsgPack(JsonValue* val, const char* data, size_t size, const JsonAllocator* allocator) {
+	assert(val!=nullptr&&(data!=nullptr||size==0));
+	return DecodeRoot(DecodeMsgPack, val, data, size, nullptr, nullptr, allocator);
+}
+
+RetType ST_JSON::JsonDecodeMsgPack(JsonDocument* doc, const char* data, size_t size) {
+	assert(doc!=nullptr&&(data!=nullptr||size==0));
+	doc->_arena.Clear();
+	doc->_keys.Clear();
+	return DecodeRoot(DecodeMsgPack, &doc->_root, data, size, &doc->_arena, &doc->_keys, nullptr);
+}
@@ -0,0 +1,471 @@
+#pragma once
+#include "st_json.h"
+#include "st_json_internal.h"
+#include "st_json_reader.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <utility>  /* std::move */
+#include <vector>
+
+/*
+ * Declares the members of a struct that JsonParseBound reads and JsonWriteBound writes, by their
+ * names, which are also the keys. Put it at namespace scope next to the struct, up to 32 members:
+ *
+ *   struct Point { double x; double y; JsonOptional<std::string> label; };
+ *   ST_JSON_BIND(Point, x, y, label)
+ *
+ * It defines JsonBindVisit(Point&, Visitor&), found by argument-dependent lookup, which calls
+ * visitor.Visit(name, nameSize, index, member) for every member in turn until one returns false.
+ */
+#define ST_JSON_BIND(Type, ...) \
+	template <typename Visitor> \
+	inline void JsonBindVisit(Type& obj, Visitor& visitor) { \
+		ST_JSON_BIND_EACH(ST_JSON_BIND_FIELD, __VA_ARGS__) \
+	}
+
+#define ST_JSON_BIND_FIELD(name, index) \
+	if (!visitor.Visit(#name, sizeof(#name) - 1, index, obj.name)) \
+		return;
+
+/* the expansion steps go through ST_JSON_BIND_EXPAND so __VA_ARGS__ splits the same way on MSVC */
+#define ST_JSON_BIND_EXPAND(x) x
+#define ST_JSON_BIND_CAT(a, b) ST_JSON_BIND_CAT_(a, b)
+#define ST_JSON_BIND_CAT_(a, b) a##b
+#define ST_JSON_BIND_COUNT(...) \
+	ST_JSON_BIND_EXPAND(ST_JSON_BIND_COUNT_(__VA_ARGS__, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, \
+		18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1))
+#define ST_JSON_BIND_COUNT_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, \
+	_20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, N, ...) N
+#define ST_JSON_BIND_EACH(m, ...) \
+	ST_JSON_BIND_EXPAND(ST_JSON_BIND_CAT(ST_JSON_BIND_EACH_, ST_JSON_BIND_COUNT(__VA_ARGS__))(m, __VA_ARGS__))
+
+/* the index a member gets is the number of members from it to the last, minus one */
+#define ST_JSON_BIND_EACH_1(m, a) m(a, 0)
+#define ST_JSON_BIND_EACH_2(m, a, ...) m(a, 1) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_1(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_3(m, a, ...) m(a, 2) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_2(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_4(m, a, ...) m(a, 3) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_3(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_5(m, a, ...) m(a, 4) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_4(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_6(m, a, ...) m(a, 5) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_5(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_7(m, a, ...) m(a, 6) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_6(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_8(m, a, ...) m(a, 7) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_7(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_9(m, a, ...) m(a, 8) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_8(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_10(m, a, ...) m(a, 9) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_9(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_11(m, a, ...) m(a, 10) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_10(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_12(m, a, ...) m(a, 11) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_11(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_13(m, a, ...) m(a, 12) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_12(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_14(m, a, ...) m(a, 13) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_13(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_15(m, a, ...) m(a, 14) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_14(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_16(m, a, ...) m(a, 15) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_15(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_17(m, a, ...) m(a, 16) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_16(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_18(m, a, ...) m(a, 17) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_17(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_19(m, a, ...) m(a, 18) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_18(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_20(m, a, ...) m(a, 19) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_19(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_21(m, a, ...) m(a, 20) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_20(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_22(m, a, ...) m(a, 21) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_21(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_23(m, a, ...) m(a, 22) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_22(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_24(m, a, ...) m(a, 23) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_23(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_25(m, a, ...) m(a, 24) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_24(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_26(m, a, ...) m(a, 25) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_25(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_27(m, a, ...) m(a, 26) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_26(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_28(m, a, ...) m(a, 27) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_27(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_29(m, a, ...) m(a, 28) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_28(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_30(m, a, ...) m(a, 29) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_29(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_31(m, a, ...) m(a, 30) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_30(m, __VA_ARGS__))
+#define ST_JSON_BIND_EACH_32(m, a, ...) m(a, 31) ST_JSON_BIND_EXPAND(ST_JSON_BIND_EACH_31(m, __VA_ARGS__))
+
+namespace ST_JSON {
+
+/* a member that may be missing, or null; the other members of a bound struct are required */
+template <typename T>
+struct JsonOptional {
+	T _value;
+
+	bool _has;
+
+	JsonOptional() : _value(), _has(false) {}
+};
+
+/*
+ * Typed binding: parses straight into C++ objects and writes them out, with no tree in between.
+ * Bound are structs declared with ST_JSON_BIND, bool, the integer and floating-point types,
+ * std::string, std::vector and JsonOptional of any of them, nested as deep as the input is.
+ * Members are matched by key with comparisons the compiler unrolls, members of unknown keys are
+ * checked and skipped, and a key seen twice is read twice. Members the input does not mention
+ * keep what they held. Syntax errors are those of JsonParse; a value of the wrong type for its
+ * member, or a number an integer member cannot hold exactly, is PARSE_TYPE_MISMATCH, and an
+ * object without a required member is PARSE_MISSING_FIELD. After an error out is partly read.
+ */
+template <typename T>
+RetType JsonParseBound(T* out, const char* json);
+
+/* the reader's stack comes from allocator; what the members hold is theirs to allocate */
+template <typename T>
+RetType JsonParseBound(T* out, const char* json, size_t length, const JsonAllocator* allocator = nullptr);
+
+/* writes members in declaration order, leaving out optional ones that have no value */
+template <typename T>
+bool JsonWriteBound(JsonWriter* writer, const T& value);
+
+namespace INTERNAL {
+
+/* Read starts at the first byte of the value, Write writes one value where the writer is */
+template <typename T, typename Enable = void>
+struct JsonBindTraits;
+
+/* accepts every event, for the values of unknown keys */
+struct BindSkipHandler {
+	bool Null() { return true; }
+
+	bool Bool(bool) { return true; }
+
+	bool Number(double) { return true; }
+
+	bool String(const char*, size_t) { return true; }
+
+	bool StartObject() { return true; }
+
+	bool Key(const char*, size_t) { return true; }
+
+	bool EndObject(size_t) { return true; }
+
+	bool StartArray() { return true; }
+
+	bool EndArray(size_t) { return true; }
+};
+
+/* a value that does not fit: the syntax error if it is not even valid JSON */
+inline RetType BindMismatch(JsonContext* context) {
+	BindSkipHandler skip;
+	RetType ret = SaxParseValue(context, &skip);
+	return ret == RetType::PARSE_OK
+		       ? RetType::PARSE_TYPE_MISMATCH
+		       : ret;
+}
+
+inline bool BindStartsNumber(char ch) {
+	return ch == '-' || (ch >= '0' && ch <= '9');
+}
+
+/* reads the member the key names, if the struct has one */
+struct BindReadField {
+	JsonContext* _context;
+	const char* _key;
+	size_t _size;
+	uint64_t _seen; /* bit i for the member with index i */
+	RetType _ret;
+	bool _matched;
+
+	template <typename F>
+	bool Visit(const char* name, size_t nameSize, size_t index, F& field) {
+		if (nameSize != _size || memcmp(name, _key, nameSize) != 0)
+			return true;
+		_seen |= static_cast<uint64_t>(1) << index;
+		_matched = true;
+		_ret     = JsonBindTraits<F>::Read(_context, &field);
+		return false;
+	}
+};
+
+struct BindCheckFields {
+	uint64_t _seen;
+	bool _complete;
+
+	template <typename F>
+	bool Visit(const char*, size_t, size_t index, F&) {
+		if (JsonBindTraits<F>::_optional || (_seen >> index & 1))
+			return true;
+		_complete = false;
+		return false;
+	}
+};
+
+struct BindWriteField {
+	JsonWriter* _writer;
+	bool _ok;
+
+	template <typename F>
+	bool Visit(const char* name, size_t nameSize, size_t, F& field) {
+		if (JsonBindTraits<F>::Absent(field))
+			return true;
+		_ok = _writer->Key(name, nameSize) && JsonBindTraits<F>::Write(_writer, field);
+		return _ok;
+	}
+};
+
+/* a struct declared with ST_JSON_BIND */
+template <typename T, typename Enable>
+struct JsonBindTraits {
+	static const bool _optional = false;
+
+	static bool Absent(const T&) { return false; }
+
+	static RetType Read(JsonContext* context, T* out) {
+		RetType ret;
+		if (CharAt(context->_json, context->_end) != '{')
+			return BindMismatch(context);
+		++context->_json;
+		ParseWhitespace(context);
+		uint64_t seen = 0;
+		if (CharAt(context->_json, context->_end) == '}')
+			++context->_json;
+		else {
+			for (;;) {
+				if (CharAt(context->_json, context->_end) != '"')
+					return RetType::PARSE_MISSING_KEY;
+				BindReadField reader;
+				if ((ret = ParseStringRaw(context, &reader._key, &reader._size)) != RetType::PARSE_OK)
+					return ret;
+				ParseWhitespace(context);
+				if (CharAt(context->_json, context->_end) != ':')
+					return RetType::PARSE_MISSING_COLON;
+				++context->_json;
+				ParseWhitespace(context);
+				reader._context = context;
+				reader._seen    = seen;
+				reader._ret     = RetType::PARSE_OK;
+				reader._matched = false;
+				JsonBindVisit(*out, reader);
+				if (!reader._matched) {
+					BindSkipHandler skip;
+					reader._ret = SaxParseValue(context, &skip);
+				}
+				if (reader._ret != RetType::PARSE_OK)
+					return reader._ret;
+				seen = reader._seen;
+				ParseWhitespace(context);
+				char ch = CharAt(context->_json, context->_end);
+				if (ch == ',') {
+					++context->_json;
+					ParseWhitespace(context);
+				}
+				else if (ch == '}') {
+					++context->_json;
+					break;
+				}
+				else
+					return RetType::LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+			}
+		}
+		BindCheckFields check = { seen, true };
+		JsonBindVisit(*out, check);
+		return check._complete
+			       ? RetType::PARSE_OK
+			       : RetType::PARSE_MISSING_FIELD;
+	}
+
+	static bool Write(JsonWriter* writer, const T& in) {
+		BindWriteField field = { writer, true };
+		if (!writer->StartObject())
+			return false;
+		/* the visitor only reads, the generated function takes the struct as it is declared */
+		JsonBindVisit(const_cast<T&>(in), field);
+		return field._ok && writer->EndObject();
+	}
+};
+
+template <>
+struct JsonBindTraits<bool> {
+	static const bool _optional = false;
+
+	static bool Absent(bool) { return false; }
+
+	static RetType Read(JsonContext* context, bool* out) {
+		switch (CharAt(context->_json, context->_end)) {
+			case 't': *out = true;
+				return ParseLiteral(context, "true", 4);
+			case 'f': *out = false;
+				return ParseLiteral(context, "false", 5);
+			default: return BindMismatch(context);
+		}
+	}
+
+	static bool Write(JsonWriter* writer, bool in) {
+		return writer->Bool(in);
+	}
+};
+
+/* numbers are read as doubles, so integers beyond 2^53 come in rounded */
+template <typename T>
+struct JsonBindTraits<T, typename std::enable_if<std::is_integral<T>::value>::type> {
+	static const bool _optional = false;
+
+	static bool Absent(T) { return false; }
+
+	static RetType Read(JsonContext* context, T* out) {
+		RetType ret;
+		double d;
+		if (!BindStartsNumber(CharAt(context->_json, context->_end)))
+			return BindMismatch(context);
+		if ((ret = ParseNumberRaw(context, &d)) != RetType::PARSE_OK)
+			return ret;
+		/* both bounds are powers of two, exact as doubles: [min, max + 1) */
+		double lo = static_cast<double>(std::numeric_limits<T>::min());
+		double hi = static_cast<double>(std::numeric_limits<T>::max() / 2 + 1) * 2;
+		if (!(d >= lo && d < hi) || static_cast<double>(static_cast<T>(d)) != d)
+			return RetType::PARSE_TYPE_MISMATCH;
+		*out = static_cast<T>(d);
+		return RetType::PARSE_OK;
+	}
+
+	static bool Write(JsonWriter* writer, T in) {
+		return writer->Number(static_cast<double>(in));
+	}
+};
+
+template <typename T>
+struct JsonBindTraits<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+	static const bool _optional = false;
+
+	static bool Absent(T) { return false; }
+
+	static RetType Read(JsonContext* context, T* out) {
+		RetType ret;
+		double d;
+		if (!BindStartsNumber(CharAt(context->_json, context->_end)))
+			return BindMismatch(context);
+		if ((ret = ParseNumberRaw(context, &d)) != RetType::PARSE_OK)
+			return ret;
+		*out = static_cast<T>(d);
+		return RetType::PARSE_OK;
+	}
+
+	static bool Write(JsonWriter* writer, T in) {
+		return writer->Number(static_cast<double>(in));
+	}
+};
+
+template <>
+struct JsonBindTraits<std::string> {
+	static const bool _optional = false;
+
+	static bool Absent(const std::string&) { return false; }
+
+	static RetType Read(JsonContext* context, std::string* out) {
+		RetType ret;
+		const char* str;
+		size_t len;
+		if (CharAt(context->_json, context->_end) != '"')
+			return BindMismatch(context);
+		if ((ret = ParseStringRaw(context, &str, &len)) != RetType::PARSE_OK)
+			return ret;
+		out->assign(str, len);
+		return RetType::PARSE_OK;
+	}
+
+	static bool Write(JsonWriter* writer, const std::string& in) {
+		return writer->String(in.data(), in.size());
+	}
+};
+
+/* replaces what the vector held; elements are read into a local and moved in, so bool works too */
+template <typename T, typename A>
+struct JsonBindTraits<std::vector<T, A>> {
+	static const bool _optional = false;
+
+	static bool Absent(const std::vector<T, A>&) { return false; }
+
+	static RetType Read(JsonContext* context, std::vector<T, A>* out) {
+		RetType ret;
+		if (CharAt(context->_json, context->_end) != '[')
+			return BindMismatch(context);
+		++context->_json;
+		out->clear();
+		ParseWhitespace(context);
+		if (CharAt(context->_json, context->_end) == ']') {
+			++context->_json;
+			return RetType::PARSE_OK;
+		}
+		for (;;) {
+			T element = T();
+			if ((ret = JsonBindTraits<T>::Read(context, &element)) != RetType::PARSE_OK)
+				return ret;
+			out->push_back(std::move(element));
+			ParseWhitespace(context);
+			char ch = CharAt(context->_json, context->_end);
+			if (ch == ',') {
+				++context->_json;
+				ParseWhitespace(context);
+			}
+			else if (ch == ']') {
+				++context->_json;
+				return RetType::PARSE_OK;
+			}
+			else
+				return RetType::PARSE_MISSING_COMMA_OR_SQUARE_BRACKET;
+		}
+	}
+
+	static bool Write(JsonWriter* writer, const std::vector<T, A>& in) {
+		if (!writer->StartArray())
+			return false;
+		for (size_t i = 0; i < in.size(); ++i) {
+			if (!JsonBindTraits<T>::Write(writer, in[i]))
+				return false;
+		}
+		return writer->EndArray();
+	}
+};
+
+/* null reads as no value; with none, a member is left out and an element is written as null */
+template <typename T>
+struct JsonBindTraits<JsonOptional<T>> {
+	static const bool _optional = true;
+
+	static bool Absent(const JsonOptional<T>& in) { return !in._has; }
+
+	static RetType Read(JsonContext* context, JsonOptional<T>* out) {
+		if (CharAt(context->_json, context->_end) == 'n') {
+			out->_has = false;
+			return ParseLiteral(context, "null", 4);
+		}
+		RetType ret = JsonBindTraits<T>::Read(context, &out->_value);
+		out->_has   = ret == RetType::PARSE_OK;
+		return ret;
+	}
+
+	static bool Write(JsonWriter* writer, const JsonOptional<T>& in) {
+		return in._has
+			       ? JsonBindTraits<T>::Write(writer, in._value)
+			       : writer->Null();
+	}
+};
+
+}
+
+template <typename T>
+RetType JsonParseBound(T* out, const char* json) {
+	assert(out!=nullptr&&json!=nullptr);
+	return JsonParseBound(out, json, strlen(json));
+}
+
+template <typename T>
+RetType JsonParseBound(T* out, const char* json, size_t length, const JsonAllocator* allocator) {
+	assert(out!=nullptr&&(json!=nullptr||length==0));
+	JsonContext c;
+	INTERNAL::InitStack(&c, allocator);
+	c._json = json;
+	c._end  = json + length;
+
+	INTERNAL::ParseWhitespace(&c);
+	RetType ret = INTERNAL::JsonBindTraits<T>::Read(&c, out);
+	if (ret == RetType::PARSE_OK) {
+		INTERNAL::ParseWhitespace(&c);
+		if (c._json != c._end)
+			ret = RetType::PARSE_ROOT_NOT_SINGULAR;
+	}
+	INTERNAL::FreeMemory(allocator, c._stack);
+	return ret;
+}
+
+template <typename T>
+bool JsonWriteBound(JsonWriter* writer, const T& value) {
+	assert(writer!=nullptr);
+	return INTERNAL::JsonBindTraits<T>::Write(writer, value);
+}
+
+}
@@ -0,0 +1,307 @@
+#include "st_json.h"
+#include "st_json_internal.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace ST_JSON;
+using namespace ST_JSON::INTERNAL;
+
+#define FROZEN_MAGIC "STJSONFZ"
+#define FROZEN_BYTE_ORDER 0x01020304u
+#define FROZEN_VERSION 1u
+
+/* blocks of values and members start on 8 bytes, strings anywhere */
+#define FROZEN_ALIGN(size) (((size) + 7) & ~static_cast<size_t>(7))
+
+struct FrozenHeader {
+	char _magic[8];
+
+	uint32_t _byteOrder; /* FROZEN_BYTE_ORDER as the freezing machine stores it */
+
+	uint32_t _version;
+
+	uint64_t _size; /* the whole image, header included */
+
+	JsonFrozenValue _root;
+};
+
+static_assert(sizeof(JsonFrozenValue) == 16, "a frozen value has the size of a JsonValue");
+static_assert(sizeof(JsonFrozenMember) == 32 && offsetof(JsonFrozenMember, _val) == 16, "no padding in a member");
+static_assert(sizeof(FrozenHeader) == 40, "no padding in the header");
+
+/* room for size zeroed bytes at the next multiple of 8, and where it is; the image grows on a stack */
+static size_t ReserveBlock(JsonContext* out, size_t size) {
+	size_t pos = FROZEN_ALIGN(out->_top);
+	if (pos + size != out->_top)
+		memset(out->Push(pos + size - out->_top), 0, pos + size - out->_top);
+	return pos;
+}
+
+static size_t PutFrozenString(JsonContext* out, const char* str, size_t size) {
+	size_t pos = out->_top;
+	char* p    = static_cast<char*>(out->Push(size + 1));
+	memcpy(p, str, size);
+	p[size] = '\0';
+	return pos;
+}
+
+/* where a key is in the image, for every distinct key, so records that repeat keys store them once */
+struct FrozenKey {
+	size_t _pos;
+
+	size_t _size; /* SIZE_MAX for a free slot */
+};
+
+/* the slots come from the allocator of the output */
+struct FrozenKeys {
+	FrozenKey* _slots;
+
+	size_t _capacity, _count;
+};
+
+static size_t PutFrozenKey(JsonContext* out, FrozenKeys* keys, const char* key, size_t size) {
+	if (2 * (keys->_count + 1) > keys->_capacity) {
+		FrozenKey* old     = keys->_slots;
+		size_t oldCapacity = keys->_capacity;
+		keys->_capacity    = oldCapacity
+			                     ? 2 * oldCapacity
+			                     : JSON_KEY_TABLE_INIT_SIZE;
+		keys->_slots = static_cast<FrozenKey*>(AllocMemory(out->_allocator, keys->_capacity * sizeof(FrozenKey)));
+		for (size_t i = 0; i < keys->_capacity; ++i)
+			keys->_slots[i] = FrozenKey{ 0, SIZE_MAX };
+		for (size_t i = 0; i < oldCapacity; ++i) {
+			if (old[i]._size == SIZE_MAX)
+				continue;
+			size_t s = HashKey(out->_stack + old[i]._pos, old[i]._size) & (keys->_capacity - 1);
+			while (keys->_slots[s]._size != SIZE_MAX)
+				s = (s + 1) & (keys->_capacity - 1);
+			keys->_slots[s] = old[i];
+		}
+		FreeMemory(out->_allocator, old);
+	}
+	size_t mask = keys->_capacity - 1;
+	size_t s    = HashKey(key, size) & mask;
+	for (; keys->_slots[s]._size != SIZE_MAX; s = (s + 1) & mask) {
+		const FrozenKey* k = &keys->_slots[s];
+		if (k->_size == size && memcmp(out->_stack + k->_pos, key, size) == 0)
+			return k->_pos;
+	}
+	keys->_slots[s] = FrozenKey{ PutFrozenString(out, key, size), size };
+	++keys->_count;
+	return keys->_slots[s]._pos;
+}
+
+/*
+ * Writes the value at pos, which is already reserved, then appends what it points to. The stack
+ * may move while it grows, so everything is addressed by position.
+ */
+static void FreezeValue(JsonContext* out, FrozenKeys* keys, size_t pos, const JsonValue* val) {
+	JsonFrozenValue node;
+	memset(&node, 0, sizeof(node));
+	switch (GetType(val)) {
+		case JsonType::JSON_NUMBER: node._number = GetNumber(val);
+			break;
+		case JsonType::JSON_STRING: {
+			size_t size = GetStringSize(val);
+			if (size <= JSON_SHORT_STRING_MAX_SIZE) {
+				memcpy(node._short, GetString(val), size);
+				node._flags = static_cast<unsigned char>(size << 4 | JSON_VALUE_SHORT);
+			}
+			else {
+				node._offset   = static_cast<int64_t>(PutFrozenString(out, GetString(val), size) - pos);
+				node._sizeLow  = static_cast<uint32_t>(size);
+				node._sizeHigh = static_cast<uint16_t>(static_cast<uint64_t>(size) >> 32);
+			}
+			break;
+		}
+		case JsonType::JSON_ARRAY:
+		case JsonType::JSON_OBJECT: {
+			size_t n       = val->Size();
+			bool object    = GetType(val) == JsonType::JSON_OBJECT;
+			size_t block   = ReserveBlock(out, object
+				                                   ? n * sizeof(JsonFrozenMember) + ObjIndexBytes(n)
+				                                   : n * sizeof(JsonFrozenValue));
+			node._offset   = static_cast<int64_t>(block - pos);
+			node._sizeLow  = static_cast<uint32_t>(n);
+			node._sizeHigh = static_cast<uint16_t>(static_cast<uint64_t>(n) >> 32);
+			if (!object)
+				break;
+			/* the slots hold member numbers, so the index of the tree fits the frozen members as it is */
+			size_t capacity = ObjIndexCapacity(n);
+			if (capacity != 0) {
+				uint32_t* index = ObjIndexOf(val);
+				if (index[0] != capacity)
+					BuildObjIndex(val);
+				memcpy(out->_stack + block + n * sizeof(JsonFrozenMember), index, (capacity + 1) * sizeof(uint32_t));
+			}
+			break;
+		}
+		default:
+			break;
+	}
+	node._type = GetType(val);
+	memcpy(out->_stack + pos, &node, sizeof(node));
+
+	if (node._type == JsonType::JSON_ARRAY) {
+		size_t block = pos + static_cast<size_t>(node._offset);
+		for (size_t i = 0; i < val->Size(); ++i)
+			FreezeValue(out, keys, block + i * sizeof(JsonFrozenValue), &val->_arrData[i]);
+	}
+	else if (node._type == JsonType::JSON_OBJECT) {
+		size_t block = pos + static_cast<size_t>(node._offset);
+		for (size_t i = 0; i < val->Size(); ++i) {
+			const JsonObjMember* m = &val->_objData[i];
+			size_t memberPos       = block + i * sizeof(JsonFrozenMember);
+			JsonFrozenMember member;
+			member._keyOffset = static_cast<int64_t>(PutFrozenKey(out, keys, m->_key, m->_keySize) - memberPos);
+			member._keySize   = m->_keySize;
+			memcpy(out->_stack + memberPos, &member, offsetof(JsonFrozenMember, _val));
+			FreezeValue(out, keys, memberPos + offsetof(JsonFrozenMember, _val), &m->_val);
+		}
+	}
+}
+
+char* ST_JSON::JsonFreeze(const JsonValue* val, size_t* size, const JsonAllocator* allocator) {
+	assert(val!=nullptr);
+	JsonContext out;
+	InitStack(&out, allocator);
+	out._size  = JSON_STRINGIFY_STACK_INIT_SIZE;
+	out._stack = static_cast<char*>(AllocMemory(allocator, JSON_STRINGIFY_STACK_INIT_SIZE));
+	out._end   = nullptr;
+
+	FrozenKeys keys;
+	keys._slots    = nullptr;
+	keys._capacity = 0;
+	keys._count    = 0;
+	ReserveBlock(&out, sizeof(FrozenHeader));
+	FreezeValue(&out, &keys, offsetof(FrozenHeader, _root), val);
+	FreeMemory(allocator, keys._slots);
+	ReserveBlock(&out, 0);
+	FrozenHeader* header = reinterpret_cast<FrozenHeader*>(out._stack);
+	memcpy(header->_magic, FROZEN_MAGIC, 8);
+	header->_byteOrder = FROZEN_BYTE_ORDER;
+	header->_version   = FROZEN_VERSION;
+	header->_size      = out._top;
+	if (size)
+		*size = out._top;
+	return out._stack;
+}
+
+bool ST_JSON::JsonFreezeFile(const JsonValue* val, const char* path, const JsonAllocator* allocator) {
+	assert(val!=nullptr&&path!=nullptr);
+	size_t size;
+	char* image = JsonFreeze(val, &size, allocator);
+	FILE* file  = fopen(path, "wb");
+	bool ok     = file && fwrite(image, 1, size, file) == size;
+	if (file && fclose(file) != 0)
+		ok = false;
+	FreeMemory(allocator, image);
+	return ok;
+}
+
+const JsonFrozenValue* ST_JSON::JsonFrozenRoot(const void* image, size_t size) {
+	const FrozenHeader* header = static_cast<const FrozenHeader*>(image);
+	if (!image || reinterpret_cast<uintptr_t>(image) % 8 != 0 || size < sizeof(FrozenHeader) ||
+		memcmp(header->_magic, FROZEN_MAGIC, 8) != 0 || header->_byteOrder != FROZEN_BYTE_ORDER ||
+		header->_version != FROZEN_VERSION || header->_size != size)
+		return nullptr;
+	return &header->_root;
+}
+
+static const char* FrozenTarget(const void* from, int64_t offset) {
+	return static_cast<const char*>(from) + offset;
+}
+
+static const JsonFrozenMember* FrozenMembers(const JsonFrozenValue* val) {
+	return reinterpret_cast<const JsonFrozenMember*>(FrozenTarget(val, val->_offset));
+}
+
+JsonType ST_JSON::GetType(const JsonFrozenValue* val) {
+	assert(val!=nullptr);
+	return val->_type;
+}
+
+double ST_JSON::GetNumber(const JsonFrozenValue* val) {
+	assert(val&&val->_type==JsonType::JSON_NUMBER);
+	return val->_number;
+}
+
+bool ST_JSON::GetBoolean(const JsonFrozenValue* val) {
+	assert(val&&(val->_type==JsonType::JSON_TRUE||val->_type==JsonType::JSON_FALSE));
+	return val->_type == JsonType::JSON_TRUE;
+}
+
+const char* ST_JSON::GetString(const JsonFrozenValue* val) {
+	assert(val&&val->_type==JsonType::JSON_STRING);
+	return val->_flags & JSON_VALUE_SHORT
+		       ? val->_short
+		       : FrozenTarget(val, val->_offset);
+}
+
+size_t ST_JSON::GetStringSize(const JsonFrozenValue* val) {
+	assert(val&&val->_type==JsonType::JSON_STRING);
+	return val->_flags & JSON_VALUE_SHORT
+		       ? static_cast<size_t>(val->_flags >> 4)
+		       : val->Size();
+}
+
+size_t ST_JSON::GetArraySize(const JsonFrozenValue* val) {
+	assert(val&&val->_type==JsonType::JSON_ARRAY);
+	return val->Size();
+}
+
+const JsonFrozenValue* ST_JSON::GetArrayElement(const JsonFrozenValue* val, size_t index) {
+	assert(val&&val->_type==JsonType::JSON_ARRAY&&index<val->Size());
+	return reinterpret_cast<const JsonFrozenValue*>(FrozenTarget(val, val->_offset)) + index;
+}
+
+size_t ST_JSON::GetObjSize(const JsonFrozenValue* val) {
+	assert(val&&val->_type==JsonType::JSON_OBJECT);
+	return val->Size();
+}
+
+const char* ST_JSON::GetObjKey(const JsonFrozenValue* val, size_t index) {
+	assert(val&&val->_type==JsonType::JSON_OBJECT&&index<val->Size());
+	const JsonFrozenMember* m = FrozenMembers(val) + index;
+	return FrozenTarget(m, m->_keyOffset);
+}
+
+size_t ST_JSON::GetObjKeySize(const JsonFrozenValue* val, size_t index) {
+	assert(val&&val->_type==JsonType::JSON_OBJECT&&index<val->Size());
+	return static_cast<size_t>(FrozenMembers(val)[index]._keySize);
+}
+
+const JsonFrozenValue* ST_JSON::GetObjValue(const JsonFrozenValue* val, size_t index) {
+	assert(val&&val->_type==JsonType::JSON_OBJECT&&index<val->Size());
+	return &FrozenMembers(val)[index]._val;
+}
+
+size_t ST_JSON::FindObjIndex(const JsonFrozenValue* val, const char* key, size_t size) {
+	assert(val&&val->_type==JsonType::JSON_OBJECT&&(key||size==0));
+	const JsonFrozenMember* members = FrozenMembers(val);
+	size_t capacity                 = ObjIndexCapacity(val->Size());
+	if (capacity == 0) {
+		for (size_t i = 0; i < val->Size(); ++i)
+			if (members[i]._keySize == size && memcmp(FrozenTarget(&members[i], members[i]._keyOffset), key, size) == 0)
+				return i;
+		return JSON_KEY_NOT_EXIST;
+	}
+	const uint32_t* slots = reinterpret_cast<const uint32_t*>(members + val->Size()) + 1;
+	for (size_t s = HashKey(key, size) & (capacity - 1); slots[s] != 0; s = (s + 1) & (capacity - 1)) {
+		const JsonFrozenMember* m = &members[slots[s] - 1];
+		if (m->_keySize == size && memcmp(FrozenTarget(m, m->_keyOffset), key, size) == 0)
+			return slots[s] - 1;
+	}
+	return JSON_KEY_NOT_EXIST;
+}
+
+const JsonFrozenValue* ST_JSON::FindObjValue(const JsonFrozenValue* val, const char* key, size_t size) {
+	size_t index = FindObjIndex(val, key, size);
+	return index != JSON_KEY_NOT_EXIST
+		       ? GetObjValue(val, index)
+		       : nullptr;
+}
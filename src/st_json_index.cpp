@@ -0,0 +1,605 @@
+#include "st_json.h"
+#include "st_json_internal.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>  /* uint32_t, uint64_t */
+#include <thread>
+#include <vector>
+
+/* every load stays inside the input, so unlike the scanning kernels this needs no sanitizer special case */
+#if !defined(ST_JSON_NO_SIMD)
+#if defined(__AVX2__)
+#define ST_JSON_INDEX_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ST_JSON_INDEX_SSE2
+#include <emmintrin.h>
+#endif
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace ST_JSON;
+using namespace ST_JSON::INTERNAL;
+
+/* stage 1 splits the input for threads only when every chunk gets at least this much */
+#define INDEX_CHUNK_MIN_SIZE (1024 * 1024)
+
+static inline unsigned CountTrailingZeros64(uint64_t mask) {
+	assert(mask != 0);
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanForward64(&index, mask);
+	return index;
+#elif defined(_MSC_VER)
+	unsigned long index;
+	if (_BitScanForward(&index, static_cast<unsigned long>(mask)))
+		return index;
+	_BitScanForward(&index, static_cast<unsigned long>(mask >> 32));
+	return index + 32;
+#else
+	return __builtin_ctzll(mask);
+#endif
+}
+
+static inline size_t PopCount64(uint64_t mask) {
+#if defined(_MSC_VER) && defined(_M_X64)
+	return static_cast<size_t>(__popcnt64(mask));
+#elif defined(_MSC_VER)
+	return __popcnt(static_cast<unsigned>(mask)) + __popcnt(static_cast<unsigned>(mask >> 32));
+#else
+	return static_cast<size_t>(__builtin_popcountll(mask));
+#endif
+}
+
+/* bit i of the result is the XOR of bits 0..i */
+static inline uint64_t PrefixXor(uint64_t x) {
+	x ^= x << 1;
+	x ^= x << 2;
+	x ^= x << 4;
+	x ^= x << 8;
+	x ^= x << 16;
+	x ^= x << 32;
+	return x;
+}
+
+/* one bit per byte of a 64-byte block */
+struct BlockMasks {
+	uint64_t _quote;
+
+	uint64_t _backslash;
+
+	uint64_t _whitespace;
+
+	uint64_t _structural; /* { } [ ] : , */
+};
+
+static void ClassifyBlock(const char* p, BlockMasks* m) {
+	m->_quote = m->_backslash = m->_whitespace = m->_structural = 0;
+#if defined(ST_JSON_INDEX_AVX2)
+	const __m256i quote     = _mm256_set1_epi8('\"');
+	const __m256i backslash = _mm256_set1_epi8('\\');
+	const __m256i space     = _mm256_set1_epi8(' ');
+	const __m256i tab       = _mm256_set1_epi8('\t');
+	const __m256i newline   = _mm256_set1_epi8('\n');
+	const __m256i cr        = _mm256_set1_epi8('\r');
+	const __m256i lower     = _mm256_set1_epi8(0x20);
+	const __m256i open      = _mm256_set1_epi8('{');
+	const __m256i close     = _mm256_set1_epi8('}');
+	const __m256i colon     = _mm256_set1_epi8(':');
+	const __m256i comma     = _mm256_set1_epi8(',');
+	for (int i = 0; i < 2; ++i) {
+		__m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * i));
+		__m256i b = _mm256_or_si256(s, lower); /* '[' and ']' become '{' and '}' */
+		__m256i w = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(s, space), _mm256_cmpeq_epi8(s, tab)),
+		                            _mm256_or_si256(_mm256_cmpeq_epi8(s, newline), _mm256_cmpeq_epi8(s, cr)));
+		__m256i t = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(b, open), _mm256_cmpeq_epi8(b, close)),
+		                            _mm256_or_si256(_mm256_cmpeq_epi8(s, colon), _mm256_cmpeq_epi8(s, comma)));
+		int shift = 32 * i;
+		m->_quote |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(s, quote)))) << shift;
+		m->_backslash |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(s, backslash)))) << shift;
+		m->_whitespace |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(w))) << shift;
+		m->_structural |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(t))) << shift;
+	}
+#elif defined(ST_JSON_INDEX_SSE2)
+	const __m128i quote     = _mm_set1_epi8('\"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i space     = _mm_set1_epi8(' ');
+	const __m128i tab       = _mm_set1_epi8('\t');
+	const __m128i newline   = _mm_set1_epi8('\n');
+	const __m128i cr        = _mm_set1_epi8('\r');
+	const __m128i lower     = _mm_set1_epi8(0x20);
+	const __m128i open      = _mm_set1_epi8('{');
+	const __m128i close     = _mm_set1_epi8('}');
+	const __m128i colon     = _mm_set1_epi8(':');
+	const __m128i comma     = _mm_set1_epi8(',');
+	for (int i = 0; i < 4; ++i) {
+		__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+		__m128i b = _mm_or_si128(s, lower); /* '[' and ']' become '{' and '}' */
+		__m128i w = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(s, space), _mm_cmpeq_epi8(s, tab)),
+		                         _mm_or_si128(_mm_cmpeq_epi8(s, newline), _mm_cmpeq_epi8(s, cr)));
+		__m128i t = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(b, open), _mm_cmpeq_epi8(b, close)),
+		                         _mm_or_si128(_mm_cmpeq_epi8(s, colon), _mm_cmpeq_epi8(s, comma)));
+		int shift = 16 * i;
+		m->_quote |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(s, quote))) << shift;
+		m->_backslash |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(s, backslash))) << shift;
+		m->_whitespace |= static_cast<uint64_t>(_mm_movemask_epi8(w)) << shift;
+		m->_structural |= static_cast<uint64_t>(_mm_movemask_epi8(t)) << shift;
+	}
+#else
+	for (int i = 0; i < 64; ++i) {
+		uint64_t bit = 1ull << i;
+		switch (p[i]) {
+			case '\"': m->_quote |= bit;
+				break;
+			case '\\': m->_backslash |= bit;
+				break;
+			case ' ':
+			case '\t':
+			case '\n':
+			case '\r': m->_whitespace |= bit;
+				break;
+			case '{':
+			case '}':
+			case '[':
+			case ']':
+			case ':':
+			case ',': m->_structural |= bit;
+				break;
+		}
+	}
+#endif
+}
+
+/* what one block hands to the next */
+struct IndexCarry {
+	uint64_t _escaped; /* 1 if the block starts with an escaped byte */
+
+	uint64_t _inString; /* all ones if the block starts inside a string */
+
+	uint64_t _follows; /* 1 if the byte before the block ends a token */
+};
+
+/*
+ * The bytes escaped by a backslash: a run of backslashes escapes every second byte after its
+ * start, and the byte after the run when the run is odd. Adding each run to the odd-positioned
+ * run starts flips the parity of the runs that start on even bits (the simdjson trick).
+ */
+static inline uint64_t FindEscaped(uint64_t backslash, uint64_t* carry) {
+	const uint64_t evenBits = 0x5555555555555555ull;
+	backslash &= ~*carry;
+	uint64_t followsEscape     = backslash << 1 | *carry;
+	uint64_t oddSequenceStarts = backslash & ~evenBits & ~followsEscape;
+	uint64_t sequencesStartingOnEvenBits = oddSequenceStarts + backslash;
+	*carry = sequencesStartingOnEvenBits < backslash; /* the last run goes on in the next block */
+	uint64_t invertMask = sequencesStartingOnEvenBits << 1;
+	return (evenBits ^ invertMask) & followsEscape;
+}
+
+/*
+ * The bytes stage 2 visits: structural characters and opening quotes outside strings, and the
+ * first byte of every other token (numbers, literals and junk), i.e. any other byte outside a
+ * string that follows whitespace, a structural character or a quote.
+ */
+static inline uint64_t IndexBits(const BlockMasks* m, IndexCarry* carry) {
+	uint64_t escaped  = FindEscaped(m->_backslash, &carry->_escaped);
+	uint64_t quote    = m->_quote & ~escaped;
+	uint64_t inString = PrefixXor(quote) ^ carry->_inString; /* opening quotes in, closing quotes out */
+	carry->_inString  = static_cast<uint64_t>(static_cast<int64_t>(inString) >> 63);
+	uint64_t boundary = m->_structural | m->_whitespace | m->_quote;
+	uint64_t follows  = boundary << 1 | carry->_follows;
+	carry->_follows   = boundary >> 63;
+	uint64_t starts   = ~boundary & follows;
+	return ((m->_structural | starts) & ~inString) | (quote & inString);
+}
+
+/* the last block is padded with spaces, which never produce index entries */
+static inline void LoadBlock(const char* json, size_t pos, size_t end, BlockMasks* m) {
+	if (end - pos >= 64)
+		ClassifyBlock(json + pos, m);
+	else {
+		char block[64];
+		memset(block, ' ', sizeof(block));
+		memcpy(block, json + pos, end - pos);
+		ClassifyBlock(block, m);
+	}
+}
+
+static size_t IndexChunk(const char* json, size_t begin, size_t end, IndexCarry carry, uint32_t* out) {
+	uint32_t* cur = out;
+	for (size_t pos = begin; pos < end; pos += 64) {
+		BlockMasks m;
+		LoadBlock(json, pos, end, &m);
+		uint64_t bits = IndexBits(&m, &carry);
+		while (bits != 0) {
+			*cur++ = static_cast<uint32_t>(pos + CountTrailingZeros64(bits));
+			bits &= bits - 1;
+		}
+	}
+	return cur - out;
+}
+
+/* 1 if the chunk holds an odd number of unescaped quotes, so the next one starts inside a string */
+static uint64_t QuoteParity(const char* json, size_t begin, size_t end, uint64_t escaped) {
+	uint64_t parity = 0;
+	for (size_t pos = begin; pos < end; pos += 64) {
+		BlockMasks m;
+		LoadBlock(json, pos, end, &m);
+		parity ^= PrefixXor(m._quote & ~FindEscaped(m._backslash, &escaped)) >> 63;
+	}
+	return parity;
+}
+
+/* whether json[begin] is escaped only depends on the run of backslashes right before it */
+static uint64_t EscapedAt(const char* json, size_t begin) {
+	size_t run = 0;
+	while (run < begin && json[begin - 1 - run] == '\\')
+		++run;
+	return run & 1;
+}
+
+static uint64_t FollowsAt(const char* json, size_t begin) {
+	if (begin == 0)
+		return 1;
+	switch (json[begin - 1]) {
+		case ' ': case '\t': case '\n': case '\r':
+		case '{': case '}': case '[': case ']': case ':': case ',':
+		case '\"': return 1;
+		default: return 0;
+	}
+}
+
+/*
+ * Stage 1. Chunks are independent except for whether they start inside a string, so threads
+ * first find the quote parity of their chunk, then index it at its own offset in index; the
+ * pieces are moved together afterwards.
+ */
+static size_t BuildIndex(const char* json, size_t length, size_t threadCount, uint32_t* index) {
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	size_t chunks = length / INDEX_CHUNK_MIN_SIZE;
+	if (chunks > threadCount)
+		chunks = threadCount;
+	if (chunks <= 1) {
+		IndexCarry carry = { 0, 0, 1 };
+		return IndexChunk(json, 0, length, carry, index);
+	}
+	size_t chunkSize = (length / chunks + 63) & ~static_cast<size_t>(63);
+	std::vector<size_t> begins(chunks + 1);
+	std::vector<uint64_t> parities(chunks);
+	std::vector<size_t> counts(chunks);
+	for (size_t i = 0; i < chunks; ++i)
+		begins[i] = i * chunkSize < length ? i * chunkSize : length;
+	begins[chunks] = length;
+
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i + 1 < chunks; ++i)
+		threads.push_back(std::thread([&, i]() {
+			parities[i] = QuoteParity(json, begins[i], begins[i + 1], EscapedAt(json, begins[i]));
+		}));
+	for (size_t i = 0; i < threads.size(); ++i)
+		threads[i].join();
+	threads.clear();
+
+	uint64_t inString = 0;
+	for (size_t i = 0; i < chunks; ++i) {
+		IndexCarry carry = { EscapedAt(json, begins[i]), inString, FollowsAt(json, begins[i]) };
+		threads.push_back(std::thread([&, i, carry]() {
+			counts[i] = IndexChunk(json, begins[i], begins[i + 1], carry, index + begins[i]);
+		}));
+		inString ^= static_cast<uint64_t>(0) - parities[i];
+	}
+	for (size_t i = 0; i < threads.size(); ++i)
+		threads[i].join();
+
+	size_t count = counts[0];
+	for (size_t i = 1; i < chunks; ++i) {
+		memmove(index + count, index + begins[i], counts[i] * sizeof(uint32_t));
+		count += counts[i];
+	}
+	return count;
+}
+
+/* what a container skip needs of a block: quotes and backslashes to mask out strings, and the brackets */
+struct BracketMasks {
+	uint64_t _quote;
+
+	uint64_t _backslash;
+
+	uint64_t _open; /* [ { */
+
+	uint64_t _close; /* ] } */
+};
+
+static void ClassifyBrackets(const char* p, BracketMasks* m) {
+	m->_quote = m->_backslash = m->_open = m->_close = 0;
+#if defined(ST_JSON_INDEX_AVX2)
+	const __m256i quote     = _mm256_set1_epi8('\"');
+	const __m256i backslash = _mm256_set1_epi8('\\');
+	const __m256i lower     = _mm256_set1_epi8(0x20);
+	const __m256i open      = _mm256_set1_epi8('{');
+	const __m256i close     = _mm256_set1_epi8('}');
+	for (int i = 0; i < 2; ++i) {
+		__m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * i));
+		__m256i b = _mm256_or_si256(s, lower); /* '[' and ']' become '{' and '}' */
+		int shift = 32 * i;
+		m->_quote |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(s, quote)))) << shift;
+		m->_backslash |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(s, backslash)))) << shift;
+		m->_open |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(b, open)))) << shift;
+		m->_close |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(b, close)))) << shift;
+	}
+#elif defined(ST_JSON_INDEX_SSE2)
+	const __m128i quote     = _mm_set1_epi8('\"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i lower     = _mm_set1_epi8(0x20);
+	const __m128i open      = _mm_set1_epi8('{');
+	const __m128i close     = _mm_set1_epi8('}');
+	for (int i = 0; i < 4; ++i) {
+		__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+		__m128i b = _mm_or_si128(s, lower); /* '[' and ']' become '{' and '}' */
+		int shift = 16 * i;
+		m->_quote |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(s, quote))) << shift;
+		m->_backslash |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(s, backslash))) << shift;
+		m->_open |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(b, open))) << shift;
+		m->_close |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(b, close))) << shift;
+	}
+#else
+	for (int i = 0; i < 64; ++i) {
+		uint64_t bit = 1ull << i;
+		switch (p[i]) {
+			case '\"': m->_quote |= bit;
+				break;
+			case '\\': m->_backslash |= bit;
+				break;
+			case '{':
+			case '[': m->_open |= bit;
+				break;
+			case '}':
+			case ']': m->_close |= bit;
+				break;
+		}
+	}
+#endif
+}
+
+size_t ST_JSON::INTERNAL::SkipContainer(const char* json, size_t pos, size_t length, size_t depth) {
+	assert(depth!=0||(pos<length&&(json[pos]=='['||json[pos]=='{')));
+	uint64_t escaped  = 0;
+	uint64_t inString = 0;
+	for (; pos < length; pos += 64) {
+		BracketMasks m;
+		if (length - pos >= 64)
+			ClassifyBrackets(json + pos, &m);
+		else {
+			char block[64];
+			memset(block, ' ', sizeof(block));
+			memcpy(block, json + pos, length - pos);
+			ClassifyBrackets(block, &m);
+		}
+		uint64_t quote = m._quote & ~FindEscaped(m._backslash, &escaped);
+		uint64_t str   = PrefixXor(quote) ^ inString;
+		inString       = static_cast<uint64_t>(static_cast<int64_t>(str) >> 63);
+		uint64_t open  = m._open & ~str;
+		uint64_t close = m._close & ~str;
+		size_t closes  = PopCount64(close);
+		if (closes < depth) {
+			/* too few closing brackets to get back to the start */
+			depth += PopCount64(open) - closes;
+			continue;
+		}
+		for (uint64_t bits = open | close; bits != 0; bits &= bits - 1) {
+			unsigned i = CountTrailingZeros64(bits);
+			if (open >> i & 1)
+				++depth;
+			else if (--depth == 0)
+				return pos + i + 1;
+		}
+	}
+	return 0;
+}
+
+struct IndexFrame {
+	size_t _count;
+
+	bool _object;
+};
+
+static RetType WalkString(JsonContext* context, DomHandler* handler, bool isKey) {
+	const char* str;
+	size_t len;
+	RetType ret;
+	if ((ret = ParseStringRaw(context, &str, &len)) != RetType::PARSE_OK)
+		return ret;
+	if (isKey)
+		handler->Key(str, len);
+	else
+		handler->String(str, len);
+	return RetType::PARSE_OK;
+}
+
+/*
+ * Stage 2: the loop of SaxParseValue/Array/Object with an explicit stack, jumping from one
+ * index entry to the next instead of skipping whitespace. Every check is the one the recursive
+ * parser makes on the same byte, so the error codes agree with JsonParse.
+ */
+static RetType WalkIndex(const char* json, size_t length, const uint32_t* index, size_t count, JsonContext* context,
+                         JsonContext* frames, DomHandler* handler) {
+	const char* end = json + length;
+	size_t i        = 0;
+	RetType ret;
+	IndexFrame* frame;
+	context->_end = end;
+
+/* the byte at the next entry, or '\0' past the last one just as CharAt gives at the end */
+#define NEXT_CHAR() (i < count ? json[index[i]] : '\0')
+
+value:
+	if (i == count)
+		return RetType::PARSE_EXPECT_VALUE;
+	context->_json = json + index[i++];
+	switch (*context->_json) {
+		case '[': {
+			handler->StartArray();
+			if (NEXT_CHAR() == ']') {
+				++i;
+				handler->EndArray(0);
+				goto endValue;
+			}
+			frame          = static_cast<IndexFrame*>(frames->Push(sizeof(IndexFrame)));
+			frame->_count  = 0;
+			frame->_object = false;
+			goto value;
+		}
+		case '{': {
+			handler->StartObject();
+			if (NEXT_CHAR() == '}') {
+				++i;
+				handler->EndObject(0);
+				goto endValue;
+			}
+			frame          = static_cast<IndexFrame*>(frames->Push(sizeof(IndexFrame)));
+			frame->_count  = 0;
+			frame->_object = true;
+			goto key;
+		}
+		case '\"': {
+			if ((ret = WalkString(context, handler, false)) != RetType::PARSE_OK)
+				return ret;
+			goto skipInside;
+		}
+		case 'n': {
+			if ((ret = ParseLiteral(context, "null", 4)) != RetType::PARSE_OK)
+				return ret;
+			handler->Null();
+			goto endScalar;
+		}
+		case 'f': {
+			if ((ret = ParseLiteral(context, "false", 5)) != RetType::PARSE_OK)
+				return ret;
+			handler->Bool(false);
+			goto endScalar;
+		}
+		case 't': {
+			if ((ret = ParseLiteral(context, "true", 4)) != RetType::PARSE_OK)
+				return ret;
+			handler->Bool(true);
+			goto endScalar;
+		}
+		default: {
+			double d;
+			if ((ret = ParseNumberRaw(context, &d)) != RetType::PARSE_OK)
+				return ret;
+			handler->Number(d);
+			goto endScalar;
+		}
+	}
+
+key:
+	if (NEXT_CHAR() != '\"')
+		return RetType::PARSE_MISSING_KEY;
+	context->_json = json + index[i++];
+	if ((ret = WalkString(context, handler, true)) != RetType::PARSE_OK)
+		return ret;
+	/* only a string the decoder ends elsewhere than stage 1 did, which is an error anyway, has entries inside */
+	while (i < count && json + index[i] < context->_json)
+		++i;
+	if (NEXT_CHAR() != ':')
+		return RetType::PARSE_MISSING_COLON;
+	++i;
+	goto value;
+
+skipInside:
+	while (i < count && json + index[i] < context->_json)
+		++i;
+	goto endValue;
+
+endScalar:
+	/* the rest of a token is not indexed, so junk stuck to it ("12x", "nullx") shows up only here */
+	if (context->_json != end && !IsWhitespace(*context->_json) && (i == count || json + index[i] != context->_json)) {
+		if (frames->_top == 0)
+			return RetType::PARSE_ROOT_NOT_SINGULAR;
+		return reinterpret_cast<IndexFrame*>(frames->_stack + frames->_top - sizeof(IndexFrame))->_object
+			       ? RetType::LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET
+			       : RetType::PARSE_MISSING_COMMA_OR_SQUARE_BRACKET;
+	}
+
+endValue:
+	if (frames->_top == 0)
+		return i == count
+			       ? RetType::PARSE_OK
+			       : RetType::PARSE_ROOT_NOT_SINGULAR;
+	frame = reinterpret_cast<IndexFrame*>(frames->_stack + frames->_top - sizeof(IndexFrame));
+	++frame->_count;
+	if (frame->_object) {
+		if (NEXT_CHAR() == ',') {
+			++i;
+			goto key;
+		}
+		if (NEXT_CHAR() != '}')
+			return RetType::LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+		++i;
+		handler->EndObject(static_cast<IndexFrame*>(frames->Pop(sizeof(IndexFrame)))->_count);
+		goto endValue;
+	}
+	if (NEXT_CHAR() == ',') {
+		++i;
+		goto value;
+	}
+	if (NEXT_CHAR() != ']')
+		return RetType::PARSE_MISSING_COMMA_OR_SQUARE_BRACKET;
+	++i;
+	handler->EndArray(static_cast<IndexFrame*>(frames->Pop(sizeof(IndexFrame)))->_count);
+	goto endValue;
+#undef NEXT_CHAR
+}
+
+/* the stacks and the index come from allocator, or from the document's */
+static RetType ParseIndexed(JsonValue* val, const char* json, size_t length, JsonArena* arena, JsonKeyTable* keys,
+                            size_t threadCount, const JsonAllocator* allocator) {
+	if (arena)
+		allocator = arena->_allocator;
+	JsonContext context, values, frames;
+	InitStack(&context, allocator);
+	InitStack(&values, allocator);
+	InitStack(&frames, allocator);
+
+	RetType ret;
+	if (length >= UINT32_MAX) {
+		/* positions no longer fit the index */
+		ret = ParseWithStacks(val, json, length, arena, keys, &context, &values);
+	}
+	else {
+		/* at most one entry per byte; pages past the last entry are never touched */
+		uint32_t* index = static_cast<uint32_t*>(AllocMemory(allocator, (length + 1) * sizeof(uint32_t)));
+		size_t count    = BuildIndex(json, length, threadCount, index);
+		DomHandler handler = { &values, arena, keys, false, allocator };
+		val->Init();
+		ret = WalkIndex(json, length, index, count, &context, &frames, &handler);
+		if (ret == RetType::PARSE_OK) {
+			assert(values._top==sizeof(JsonValue));
+			*val = *static_cast<JsonValue*>(values.Pop(sizeof(JsonValue)));
+		}
+		FreeMemory(allocator, index);
+	}
+	FreeValueStack(&values);
+	FreeMemory(allocator, context._stack);
+	FreeMemory(allocator, frames._stack);
+	return ret;
+}
+
+RetType ST_JSON::JsonParseIndexed(JsonValue* val, const char* json, size_t length, size_t threadCount,
+                                  const JsonAllocator* allocator) {
+	assert(val!=nullptr&&(json!=nullptr||length==0));
+	return ParseIndexed(val, json, length, nullptr, nullptr, threadCount, allocator);
+}
+
+RetType ST_JSON::JsonParseIndexed(JsonDocument* doc, const char* json, size_t length, size_t threadCount) {
+	assert(doc!=nullptr&&(json!=nullptr||length==0));
+	doc->_arena.Clear();
+	doc->_keys.Clear();
+	return ParseIndexed(&doc->_root, json, length, &doc->_arena, &doc->_keys, threadCount, nullptr);
+}
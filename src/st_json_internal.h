@@ -0,0 +1,405 @@
+#pragma once
+#include "st_json.h"
+#include "st_json_number.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>  /* uint32_t, uint64_t */
+
+/* parser pieces shared by st_json.cpp and the templates in st_json_reader.h, not part of the API */
+namespace ST_JSON {
+namespace INTERNAL {
+
+inline bool IsWhitespace(char ch) {
+	return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+/* the byte at p, or '\0' at the end of the input */
+inline char CharAt(const char* p, const char* end) {
+	return p != end
+		       ? *p
+		       : '\0';
+}
+
+const char* SkipWhitespace(const char* p, const char* end);
+
+/* most tokens are not preceded by whitespace, so test one byte before calling the kernel */
+inline void ParseWhitespace(JsonContext* context) {
+	if (context->_json != context->_end && IsWhitespace(*context->_json))
+		context->_json = SkipWhitespace(context->_json, context->_end);
+}
+
+inline RetType ParseLiteral(JsonContext* context, const char* literal, size_t size) {
+	if (static_cast<size_t>(context->_end - context->_json) < size || memcmp(context->_json, literal, size) != 0)
+		return RetType::PARSE_INVALID_VALUE;
+	context->_json += size;
+	return RetType::PARSE_OK;
+}
+
+/* checks the grammar and collects the digits without converting them */
+RetType ScanNumber(JsonContext* context, DecimalNumber* number);
+
+RetType ParseNumberRaw(JsonContext* context, double* number);
+
+/* *str points into the input or into the popped context stack and stays valid until the next Push */
+RetType ParseStringRaw(JsonContext* context, const char** str, size_t* len);
+
+/* unescapes into the input buffer and NUL-terminates where the closing quote was */
+RetType ParseStringInsitu(JsonContext* context, char** str, size_t* len);
+
+/* the first '"', '\\' or control character in [p, end), end if none; reads whole aligned blocks */
+const char* ScanStringRun(const char* p, const char* end);
+
+/*
+ * The offset just past the bracket that closes the array or object opened at json[pos], 0 if it
+ * is never closed; with depth brackets already open, pos being outside a string, the one closing
+ * the outermost of them. Only strings and brackets are looked at, a block of 64 bytes at a time,
+ * so nothing inside is validated and [ may be closed by }.
+ */
+size_t SkipContainer(const char* json, size_t pos, size_t length, size_t depth = 0);
+
+/* writes the escape of a byte ScanStringRun stopped at, at most 6 bytes, and returns the end */
+char* EscapeChar(char* out, unsigned char ch);
+
+/*
+ * ST_JSON_STAT(statements) runs them with stats naming the collector of the JsonStats call on
+ * this thread, if one is running. Without ST_JSON_STATS it is nothing at all.
+ */
+#ifdef ST_JSON_STATS
+extern thread_local JsonStats* gStats;
+
+#define ST_JSON_STAT(...) do { if (JsonStats* stats = ::ST_JSON::INTERNAL::gStats) { __VA_ARGS__; } } while (0)
+
+inline void CountAlloc(JsonStats* stats, size_t size) {
+	++stats->_allocs;
+	stats->_allocBytes += size;
+}
+#else
+#define ST_JSON_STAT(...) ((void)0)
+#endif
+
+/* stacks, chunks and output, from allocator or the heap when it is nullptr */
+inline void* AllocMemory(const JsonAllocator* allocator, size_t size) {
+	return allocator
+		       ? allocator->_malloc(allocator->_user, size)
+		       : malloc(size);
+}
+
+inline void* ReallocMemory(const JsonAllocator* allocator, void* ptr, size_t size) {
+	if (!allocator)
+		return realloc(ptr, size);
+	return ptr
+		       ? allocator->_realloc(allocator->_user, ptr, size)
+		       : allocator->_malloc(allocator->_user, size);
+}
+
+inline void FreeMemory(const JsonAllocator* allocator, void* ptr) {
+	if (!allocator)
+		free(ptr);
+	else if (ptr)
+		allocator->_free(allocator->_user, ptr);
+}
+
+/* an empty stack that grows from allocator */
+inline void InitStack(JsonContext* context, const JsonAllocator* allocator = nullptr) {
+	context->_stack     = nullptr;
+	context->_size      = 0;
+	context->_top       = 0;
+	context->_arena     = nullptr;
+	context->_insitu    = false;
+	context->_allocator = allocator;
+}
+
+/*
+ * String, key and container blocks of a tree. One from an allocator starts a word early with a
+ * pointer to it, which JSON_VALUE_ALLOCATED or _keyAllocated announce; block is past that word.
+ */
+inline void* AllocBlock(const JsonAllocator* allocator, size_t size) {
+	if (!allocator)
+		return malloc(size);
+	const JsonAllocator** block = static_cast<const JsonAllocator**>(
+		allocator->_malloc(allocator->_user, sizeof(JsonAllocator*) + size));
+	block[0] = allocator;
+	return block + 1;
+}
+
+inline void* ReallocBlock(const JsonAllocator* allocator, void* block, size_t size) {
+	if (!allocator)
+		return realloc(block, size);
+	return static_cast<const JsonAllocator**>(allocator->_realloc(
+		allocator->_user, static_cast<const JsonAllocator**>(block) - 1, sizeof(JsonAllocator*) + size)) + 1;
+}
+
+inline void FreeBlock(const JsonAllocator* allocator, void* block) {
+	if (!allocator)
+		free(block);
+	else
+		allocator->_free(allocator->_user, static_cast<const JsonAllocator**>(block) - 1);
+}
+
+inline const JsonAllocator* BlockAllocator(const void* block) {
+	return static_cast<const JsonAllocator* const*>(block)[-1];
+}
+
+/* what a new string or container block is flagged with */
+inline unsigned char TreeFlags(JsonArena* arena, const JsonAllocator* allocator) {
+	return arena
+		       ? JSON_VALUE_BORROWED
+		       : allocator
+		       ? JSON_VALUE_ALLOCATED
+		       : 0;
+}
+
+/* tree memory comes from the document arena when parsing into a JsonDocument, from allocator otherwise */
+inline void* AllocTree(JsonArena* arena, size_t size, const JsonAllocator* allocator = nullptr) {
+	if (arena)
+		return arena->Alloc(size);
+	ST_JSON_STAT(CountAlloc(stats, size));
+	return AllocBlock(allocator, size);
+}
+
+inline char* CopyString(JsonArena* arena, const char* str, size_t size, const JsonAllocator* allocator = nullptr) {
+	char* copy = static_cast<char*>(AllocTree(arena, size + 1, allocator));
+	memcpy(copy, str, size);
+	copy[size] = '\0';
+	return copy;
+}
+
+/* the value keeps the string and its NUL in place of the payload, nothing to allocate or free */
+inline void SetShortString(JsonValue* val, const char* str, size_t size) {
+	assert(size<=JSON_SHORT_STRING_MAX_SIZE);
+	memcpy(val->_short, str, size);
+	val->_short[size] = '\0';
+	val->_flags       = static_cast<unsigned char>(size << 4 | JSON_VALUE_SHORT);
+	val->_type        = JsonType::JSON_STRING;
+}
+
+inline uint64_t HashKey(const char* key, size_t size) {
+	uint64_t h = 0x9E3779B97F4A7C15ull ^ size;
+	uint64_t w;
+	for (; size >= 8; key += 8, size -= 8) {
+		memcpy(&w, key, 8);
+		h = (h ^ w) * 0xBF58476D1CE4E5B9ull;
+		h ^= h >> 31;
+	}
+	/* the tail in fixed-size loads, most keys are all tail; the length is already in h */
+	if (size >= 4) {
+		uint32_t lo, hi;
+		memcpy(&lo, key, 4);
+		memcpy(&hi, key + size - 4, 4);
+		w = static_cast<uint64_t>(hi) << 32 | lo;
+	}
+	else {
+		w = size
+			    ? static_cast<uint64_t>(static_cast<unsigned char>(key[0])) << 16
+			    | static_cast<uint64_t>(static_cast<unsigned char>(key[size >> 1])) << 8
+			    | static_cast<unsigned char>(key[size - 1])
+			    : 0;
+	}
+	h = (h ^ w) * 0x94D049BB133111EBull;
+	return h ^ (h >> 29);
+}
+
+/* arrays and objects that were built or grown in place have room for this many elements or members */
+inline size_t ContainerCapacity(const JsonValue* val) {
+	return val->_flags & JSON_VALUE_RESERVED
+		       ? reinterpret_cast<const size_t*>(val->_arrData)[-1]
+		       : val->Size();
+}
+
+/* what to free: a reserved block starts at its capacity word, an empty container has none */
+inline void* ContainerBlock(const JsonValue* val) {
+	if (!val->_arrData)
+		return nullptr;
+	return val->_flags & JSON_VALUE_RESERVED
+		       ? static_cast<void*>(reinterpret_cast<size_t*>(val->_arrData) - 1)
+		       : static_cast<void*>(val->_arrData);
+}
+
+/* where the string or container block of val came from, nullptr for the heap */
+inline const JsonAllocator* ValueAllocator(const JsonValue* val) {
+	if (!(val->_flags & JSON_VALUE_ALLOCATED))
+		return nullptr;
+	const void* block = val->_type == JsonType::JSON_STRING
+		                    ? val->_str
+		                    : ContainerBlock(val);
+	return block
+		       ? BlockAllocator(block)
+		       : nullptr;
+}
+
+/*
+ * The hash index of a wide object lives in the member block, right after the members (after room
+ * for capacity members in a reserved block): a word holding 0 until the index is built and its
+ * capacity afterwards, then capacity slots of member index + 1 (0 for a free slot), probed
+ * linearly and never more than half full.
+ */
+inline size_t ObjIndexCapacity(size_t memberCount) {
+	if (memberCount < JSON_OBJ_INDEX_MIN_SIZE || memberCount >= UINT32_MAX)
+		return 0;
+	size_t capacity = 1;
+	while (capacity < 2 * memberCount)
+		capacity <<= 1;
+	return capacity;
+}
+
+inline size_t ObjIndexBytes(size_t memberCount) {
+	size_t capacity = ObjIndexCapacity(memberCount);
+	return capacity
+		       ? (capacity + 1) * sizeof(uint32_t)
+		       : 0;
+}
+
+inline uint32_t* ObjIndexOf(const JsonValue* val) {
+	return reinterpret_cast<uint32_t*>(val->_objData + ContainerCapacity(val));
+}
+
+/* fills in the index of an object that has room for one */
+void BuildObjIndex(const JsonValue* val);
+
+/* the stored copy of key, made on first sight; insitu keys are stored as they lie in the input */
+const char* InternKey(JsonKeyTable* keys, JsonArena* arena, const char* key, size_t size, bool insitu);
+
+/* a copy of src and everything in it, from arena if there is one, keys interned if keys is given */
+void CopyTree(JsonValue* dst, const JsonValue* src, JsonArena* arena, JsonKeyTable* keys,
+              const JsonAllocator* allocator = nullptr);
+
+/*
+ * Builds the tree from reader events. Finished values, keys included as strings, wait on the
+ * stack until their container ends and moves them into one block; the root is the last one left.
+ */
+struct DomHandler {
+	JsonContext* _values; /* only the stack is used */
+	JsonArena* _arena;
+	JsonKeyTable* _keys;  /* nullptr copies every key */
+	bool _insitu;
+	const JsonAllocator* _allocator; /* for the tree when there is no arena */
+
+	JsonValue* PushValue(JsonType type) {
+		JsonValue* v = static_cast<JsonValue*>(_values->Push(sizeof(JsonValue)));
+		v->Init();
+		v->_type = type;
+		return v;
+	}
+
+	bool Null() {
+		PushValue(JsonType::JSON_NULL);
+		return true;
+	}
+
+	bool Bool(bool b) {
+		PushValue(b
+			          ? JsonType::JSON_TRUE
+			          : JsonType::JSON_FALSE);
+		return true;
+	}
+
+	bool Number(double d) {
+		PushValue(JsonType::JSON_NUMBER)->_number = d;
+		return true;
+	}
+
+	/* for keys, which a member keeps as a pointer, in-situ strings and strings too long to be short */
+	void PushString(const char* str, size_t size) {
+		JsonValue* v = PushValue(JsonType::JSON_STRING);
+		if (_insitu) {
+			v->_str   = const_cast<char*>(str);
+			v->_flags = JSON_VALUE_BORROWED;
+		}
+		else {
+			v->_str   = CopyString(_arena, str, size, _allocator);
+			v->_flags = TreeFlags(_arena, _allocator);
+		}
+		v->SetSize(size);
+	}
+
+	bool String(const char* str, size_t size) {
+		if (size <= JSON_SHORT_STRING_MAX_SIZE && !_insitu)
+			SetShortString(PushValue(JsonType::JSON_STRING), str, size);
+		else
+			PushString(str, size);
+		return true;
+	}
+
+	bool Key(const char* str, size_t size) {
+		if (!_keys) {
+			PushString(str, size);
+			return true;
+		}
+		JsonValue* v = PushValue(JsonType::JSON_STRING);
+		v->_str      = const_cast<char*>(InternKey(_keys, _arena, str, size, _insitu));
+		v->_flags    = JSON_VALUE_BORROWED;
+		v->SetSize(size);
+		return true;
+	}
+
+	bool StartObject() {
+		return true;
+	}
+
+	bool EndObject(size_t memberCount) {
+		JsonObjMember* members = nullptr;
+		size_t indexBytes      = ObjIndexBytes(memberCount);
+		if (memberCount != 0) {
+			members = static_cast<JsonObjMember*>(AllocTree(_arena, memberCount * sizeof(JsonObjMember) + indexBytes,
+			                                                _allocator));
+			JsonValue* kv = static_cast<JsonValue*>(_values->Pop(memberCount * 2 * sizeof(JsonValue)));
+			for (size_t i = 0; i < memberCount; ++i) {
+				members[i]._key          = kv[2 * i]._str;
+				members[i]._keySize      = kv[2 * i].Size();
+				members[i]._keyBorrowed  = (kv[2 * i]._flags & JSON_VALUE_BORROWED) != 0;
+				members[i]._keyAllocated = (kv[2 * i]._flags & JSON_VALUE_ALLOCATED) != 0;
+				members[i]._val          = kv[2 * i + 1];
+			}
+		}
+		JsonValue* v = PushValue(JsonType::JSON_OBJECT);
+		v->_objData = members;
+		v->_flags   = TreeFlags(_arena, members ? _allocator : nullptr);
+		v->SetSize(memberCount);
+		if (indexBytes != 0) {
+			*ObjIndexOf(v) = 0;
+			if (memberCount >= JSON_OBJ_INDEX_EAGER_SIZE)
+				BuildObjIndex(v);
+		}
+		return true;
+	}
+
+	bool StartArray() {
+		return true;
+	}
+
+	bool EndArray(size_t elementCount) {
+		JsonValue* elements = nullptr;
+		if (elementCount != 0) {
+			size_t size = elementCount * sizeof(JsonValue);
+			elements    = static_cast<JsonValue*>(AllocTree(_arena, size, _allocator));
+			memcpy(elements, _values->Pop(size), size);
+		}
+		JsonValue* v = PushValue(JsonType::JSON_ARRAY);
+		v->_arrData = elements;
+		v->_flags   = TreeFlags(_arena, elements ? _allocator : nullptr);
+		v->SetSize(elementCount);
+		return true;
+	}
+};
+
+/* a failed parse leaves the finished values of every open container behind */
+inline void DropValues(JsonContext* values) {
+	while (values->_top != 0)
+		static_cast<JsonValue*>(values->Pop(sizeof(JsonValue)))->Free();
+}
+
+inline void FreeValueStack(JsonContext* values) {
+	DropValues(values);
+	FreeMemory(values->_allocator, values->_stack);
+	values->_stack = nullptr;
+	values->_size  = 0;
+}
+
+/* JsonParse with stacks the caller keeps between calls, so parsing many small inputs allocates them once */
+RetType ParseWithStacks(JsonValue* val, const char* json, size_t length, JsonArena* arena, JsonKeyTable* keys,
+                        JsonContext* context, JsonContext* values);
+
+}
+}
@@ -0,0 +1,400 @@
+#include "st_json.h"
+#include "st_json_internal.h"
+#include "st_json_reader.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <math.h>    /* HUGE_VAL */
+#include <stdint.h>  /* uint64_t */
+
+using namespace ST_JSON;
+using namespace ST_JSON::INTERNAL;
+
+/* below 10^19 * 10^289 = 10^308 no number overflows, so only larger exponents pay for a conversion */
+#define LAZY_NUMBER_SAFE_EXP10 289
+
+#define LAZY_CACHE_INIT_CAPACITY 16
+
+static JsonLazyValue* LazyAt(JsonLazyDocument* doc, size_t index) {
+	return static_cast<JsonLazyValue*>(static_cast<void*>(doc->_tape._stack)) + index;
+}
+
+/* entries are addressed by index while scanning, pushing may move the tape */
+static size_t LazyPush(JsonLazyDocument* doc, const char* begin) {
+	size_t index     = doc->_tape._top / sizeof(JsonLazyValue);
+	JsonLazyValue* v = static_cast<JsonLazyValue*>(doc->_tape.Push(sizeof(JsonLazyValue)));
+	v->_offset = begin - doc->_json;
+	v->_skip   = 1;
+	v->_size   = 0;
+	return index;
+}
+
+/* a container ends: fix up how many entries its contents took */
+static void LazyClose(JsonLazyDocument* doc, size_t index, size_t size) {
+	JsonLazyValue* v = LazyAt(doc, index);
+	v->_skip = doc->_tape._top / sizeof(JsonLazyValue) - index;
+	v->_size = size;
+}
+
+static void LazyResetCursors(JsonLazyDocument* doc) {
+	for (size_t i = 0; i < JSON_LAZY_CURSOR_COUNT; ++i)
+		doc->_cursors[i]._parent = nullptr;
+}
+
+static RetType LazyScanString(JsonLazyDocument* doc, JsonContext* context) {
+	const char* begin = context->_json;
+	const char* str;
+	size_t len;
+	RetType ret;
+	if ((ret = ParseStringRaw(context, &str, &len)) != RetType::PARSE_OK)
+		return ret;
+	LazyAt(doc, LazyPush(doc, begin))->_size = context->_json - begin - 2;
+	return RetType::PARSE_OK;
+}
+
+static RetType LazyScanNumber(JsonLazyDocument* doc, JsonContext* context) {
+	DecimalNumber num;
+	RetType ret;
+	if ((ret = ScanNumber(context, &num)) != RetType::PARSE_OK)
+		return ret;
+	if (num._exp10 > LAZY_NUMBER_SAFE_EXP10) {
+		double d = DecimalToDouble(&num);
+		if (d == HUGE_VAL || d == -HUGE_VAL)
+			return RetType::PARSE_NUMBER_TOO_BIG;
+	}
+	LazyPush(doc, num._begin);
+	return RetType::PARSE_OK;
+}
+
+static RetType LazyScanLiteral(JsonLazyDocument* doc, JsonContext* context, const char* literal, size_t size) {
+	const char* begin = context->_json;
+	RetType ret;
+	if ((ret = ParseLiteral(context, literal, size)) != RetType::PARSE_OK)
+		return ret;
+	LazyPush(doc, begin);
+	return RetType::PARSE_OK;
+}
+
+static RetType LazyScanValue(JsonLazyDocument* doc, JsonContext* context);
+
+/* SaxParseArray and SaxParseObject with the events replaced by tape entries, so the errors agree */
+static RetType LazyScanArray(JsonLazyDocument* doc, JsonContext* context) {
+	size_t index = LazyPush(doc, context->_json);
+	size_t size  = 0;
+	RetType ret;
+	++context->_json;
+	ParseWhitespace(context);
+	if (CharAt(context->_json, context->_end) == ']') {
+		++context->_json;
+		LazyClose(doc, index, 0);
+		return RetType::PARSE_OK;
+	}
+	for (;;) {
+		if ((ret = LazyScanValue(doc, context)) != RetType::PARSE_OK)
+			return ret;
+		++size;
+		ParseWhitespace(context);
+		char ch = CharAt(context->_json, context->_end);
+		if (ch == ',') {
+			++context->_json;
+			ParseWhitespace(context);
+		}
+		else if (ch == ']') {
+			++context->_json;
+			LazyClose(doc, index, size);
+			return RetType::PARSE_OK;
+		}
+		else
+			return RetType::PARSE_MISSING_COMMA_OR_SQUARE_BRACKET;
+	}
+}
+
+static RetType LazyScanObject(JsonLazyDocument* doc, JsonContext* context) {
+	size_t index = LazyPush(doc, context->_json);
+	size_t size  = 0;
+	RetType ret;
+	++context->_json;
+	ParseWhitespace(context);
+	if (CharAt(context->_json, context->_end) == '}') {
+		++context->_json;
+		LazyClose(doc, index, 0);
+		return RetType::PARSE_OK;
+	}
+	for (;;) {
+		if (CharAt(context->_json, context->_end) != '"')
+			return RetType::PARSE_MISSING_KEY;
+		if ((ret = LazyScanString(doc, context)) != RetType::PARSE_OK)
+			return ret;
+		ParseWhitespace(context);
+		if (CharAt(context->_json, context->_end) != ':')
+			return RetType::PARSE_MISSING_COLON;
+		++context->_json;
+		ParseWhitespace(context);
+		if ((ret = LazyScanValue(doc, context)) != RetType::PARSE_OK)
+			return ret;
+		++size;
+		ParseWhitespace(context);
+		char ch = CharAt(context->_json, context->_end);
+		if (ch == ',') {
+			++context->_json;
+			ParseWhitespace(context);
+		}
+		else if (ch == '}') {
+			++context->_json;
+			LazyClose(doc, index, size);
+			return RetType::PARSE_OK;
+		}
+		else
+			return RetType::LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+	}
+}
+
+static RetType LazyScanValue(JsonLazyDocument* doc, JsonContext* context) {
+	switch (CharAt(context->_json, context->_end)) {
+		case 'n': return LazyScanLiteral(doc, context, "null", 4);
+		case 'f': return LazyScanLiteral(doc, context, "false", 5);
+		case 't': return LazyScanLiteral(doc, context, "true", 4);
+		case '"': return LazyScanString(doc, context);
+		case '[': return LazyScanArray(doc, context);
+		case '{': return LazyScanObject(doc, context);
+		case '\0':
+			/* the end of the input, or else a NUL byte in it, which is just an invalid character */
+			if (context->_json == context->_end)
+				return RetType::PARSE_EXPECT_VALUE;
+			/* fall through */
+		default: return LazyScanNumber(doc, context);
+	}
+}
+
+void JsonLazyDocument::Init(const JsonAllocator* allocator) {
+	_json   = nullptr;
+	_length = 0;
+	InitStack(&_tape, allocator);
+	InitStack(&_context, allocator);
+	InitStack(&_values, allocator);
+	_arena.Init(allocator);
+	_cache         = nullptr;
+	_cacheCapacity = 0;
+	_cacheCount    = 0;
+	LazyResetCursors(this);
+}
+
+void JsonLazyDocument::Free() {
+	const JsonAllocator* allocator = _arena._allocator;
+	FreeMemory(allocator, _tape._stack);
+	FreeMemory(allocator, _context._stack);
+	FreeValueStack(&_values);
+	_arena.Free();
+	FreeMemory(allocator, _cache);
+	Init(allocator);
+}
+
+RetType ST_JSON::JsonParseLazy(JsonLazyDocument* doc, const char* json, size_t length) {
+	assert(doc!=nullptr&&(json!=nullptr||length==0));
+	doc->_json      = json;
+	doc->_length    = length;
+	doc->_tape._top = 0;
+	LazyResetCursors(doc);
+	if (doc->_cacheCount != 0) {
+		memset(doc->_cache, 0, doc->_cacheCapacity * sizeof(JsonLazyCached));
+		doc->_cacheCount = 0;
+	}
+	doc->_arena.Clear();
+	JsonContext* context = &doc->_context;
+	context->_json   = json;
+	context->_end    = json + length;
+	context->_arena  = nullptr;
+	context->_insitu = false;
+
+	ParseWhitespace(context);
+	RetType ret;
+	if ((ret = LazyScanValue(doc, context)) == RetType::PARSE_OK) {
+		ParseWhitespace(context);
+		if (context->_json != context->_end)
+			ret = RetType::PARSE_ROOT_NOT_SINGULAR;
+	}
+	if (ret != RetType::PARSE_OK)
+		doc->_tape._top = 0;
+	return ret;
+}
+
+const JsonLazyValue* ST_JSON::GetLazyRoot(const JsonLazyDocument* doc) {
+	assert(doc&&doc->_tape._top!=0);
+	return static_cast<const JsonLazyValue*>(static_cast<const void*>(doc->_tape._stack));
+}
+
+/* the first byte of a validated value is enough to tell what it is */
+JsonType ST_JSON::GetLazyType(const JsonLazyDocument* doc, const JsonLazyValue* val) {
+	assert(doc&&val);
+	switch (doc->_json[val->_offset]) {
+		case 'n': return JsonType::JSON_NULL;
+		case 't': return JsonType::JSON_TRUE;
+		case 'f': return JsonType::JSON_FALSE;
+		case '"': return JsonType::JSON_STRING;
+		case '[': return JsonType::JSON_ARRAY;
+		case '{': return JsonType::JSON_OBJECT;
+		default: return JsonType::JSON_NUMBER;
+	}
+}
+
+size_t ST_JSON::GetLazyArraySize(const JsonLazyDocument* doc, const JsonLazyValue* val) {
+	assert(val&&GetLazyType(doc,val)==JsonType::JSON_ARRAY);
+	(void)doc;
+	return val->_size;
+}
+
+/* the cursor of val, moved to the front; a new one takes the place of the least recently used */
+static JsonLazyCursor* LazyCursor(JsonLazyDocument* doc, const JsonLazyValue* val) {
+	size_t i = 0;
+	while (i + 1 < JSON_LAZY_CURSOR_COUNT && doc->_cursors[i]._parent != val)
+		++i;
+	JsonLazyCursor cursor = doc->_cursors[i];
+	if (cursor._parent != val) {
+		cursor._parent = val;
+		cursor._child  = val + 1;
+		cursor._index  = 0;
+	}
+	memmove(&doc->_cursors[1], &doc->_cursors[0], i * sizeof(JsonLazyCursor));
+	doc->_cursors[0] = cursor;
+	return &doc->_cursors[0];
+}
+
+/* the entry after an element, or the key of the next member */
+static const JsonLazyValue* LazyNext(bool object, const JsonLazyValue* child) {
+	return object
+		       ? child + 1 + child[1]._skip
+		       : child + child->_skip;
+}
+
+/* the element, or the key of the member, at index */
+static const JsonLazyValue* LazyChild(JsonLazyDocument* doc, const JsonLazyValue* val, size_t index, bool object) {
+	JsonLazyCursor* cursor = LazyCursor(doc, val);
+	if (cursor->_index > index) {
+		cursor->_child = val + 1;
+		cursor->_index = 0;
+	}
+	for (; cursor->_index < index; ++cursor->_index)
+		cursor->_child = LazyNext(object, cursor->_child);
+	return cursor->_child;
+}
+
+const JsonLazyValue* ST_JSON::GetLazyArrayElement(JsonLazyDocument* doc, const JsonLazyValue* val, size_t index) {
+	assert(doc&&val&&GetLazyType(doc,val)==JsonType::JSON_ARRAY&&index<val->_size);
+	return LazyChild(doc, val, index, false);
+}
+
+size_t ST_JSON::GetLazyObjSize(const JsonLazyDocument* doc, const JsonLazyValue* val) {
+	assert(val&&GetLazyType(doc,val)==JsonType::JSON_OBJECT);
+	(void)doc;
+	return val->_size;
+}
+
+const JsonLazyValue* ST_JSON::GetLazyObjKey(JsonLazyDocument* doc, const JsonLazyValue* val, size_t index) {
+	assert(doc&&val&&GetLazyType(doc,val)==JsonType::JSON_OBJECT&&index<val->_size);
+	return LazyChild(doc, val, index, true);
+}
+
+const JsonLazyValue* ST_JSON::GetLazyObjValue(JsonLazyDocument* doc, const JsonLazyValue* val, size_t index) {
+	return GetLazyObjKey(doc, val, index) + 1;
+}
+
+/*
+ * Every escape is longer than the text it stands for, so a key is never equal to a longer text,
+ * and one with as many bytes as the text is equal to it exactly when the bytes are.
+ */
+static bool LazyKeyEquals(JsonLazyDocument* doc, const JsonLazyValue* k, const char* key, size_t size,
+                          bool plainKey) {
+	const char* raw = doc->_json + k->_offset + 1;
+	if (k->_size < size)
+		return false;
+	if (k->_size == size && plainKey)
+		return memcmp(raw, key, size) == 0;
+	if (memchr(raw, '\\', k->_size) == nullptr)
+		return k->_size == size && memcmp(raw, key, size) == 0;
+	JsonValue* decoded = GetLazyValue(doc, k);
+	return GetStringSize(decoded) == size && memcmp(GetString(decoded), key, size) == 0;
+}
+
+const JsonLazyValue* ST_JSON::FindLazyObjValue(JsonLazyDocument* doc, const JsonLazyValue* val, const char* key,
+                                               size_t size) {
+	assert(doc&&val&&GetLazyType(doc,val)==JsonType::JSON_OBJECT&&(key||size==0));
+	if (val->_size == 0)
+		return nullptr;
+	bool plainKey = memchr(key, '\\', size) == nullptr;
+	/* start at the member looked up last and wrap around, so fields read in document order cost one pass */
+	JsonLazyCursor* cursor = LazyCursor(doc, val);
+	const JsonLazyValue* k = cursor->_child;
+	size_t i               = cursor->_index;
+	for (size_t n = 0; n < val->_size; ++n) {
+		if (LazyKeyEquals(doc, k, key, size, plainKey)) {
+			cursor->_child = k;
+			cursor->_index = i;
+			return k + 1;
+		}
+		if (++i == val->_size) {
+			k = val + 1;
+			i = 0;
+		}
+		else
+			k = LazyNext(true, k);
+	}
+	return nullptr;
+}
+
+static size_t LazyCacheSlot(const JsonLazyDocument* doc, const JsonLazyValue* val) {
+	uint64_t index = static_cast<uint64_t>(val - GetLazyRoot(doc));
+	return static_cast<size_t>((index * 0x9E3779B97F4A7C15ull) >> 32) & (doc->_cacheCapacity - 1);
+}
+
+static void LazyCacheInsert(JsonLazyDocument* doc, const JsonLazyValue* val, JsonValue* value) {
+	size_t slot = LazyCacheSlot(doc, val);
+	while (doc->_cache[slot]._entry != nullptr)
+		slot = (slot + 1) & (doc->_cacheCapacity - 1);
+	doc->_cache[slot]._entry = val;
+	doc->_cache[slot]._value = value;
+	++doc->_cacheCount;
+}
+
+/* kept at most half full */
+static void LazyCacheGrow(JsonLazyDocument* doc) {
+	JsonLazyCached* old = doc->_cache;
+	size_t oldCapacity  = doc->_cacheCapacity;
+	doc->_cacheCapacity = oldCapacity
+		                      ? oldCapacity * 2
+		                      : LAZY_CACHE_INIT_CAPACITY;
+	doc->_cache      = static_cast<JsonLazyCached*>(
+		AllocMemory(doc->_arena._allocator, doc->_cacheCapacity * sizeof(JsonLazyCached)));
+	doc->_cacheCount = 0;
+	memset(doc->_cache, 0, doc->_cacheCapacity * sizeof(JsonLazyCached));
+	for (size_t i = 0; i < oldCapacity; ++i) {
+		if (old[i]._entry != nullptr)
+			LazyCacheInsert(doc, old[i]._entry, old[i]._value);
+	}
+	FreeMemory(doc->_arena._allocator, old);
+}
+
+JsonValue* ST_JSON::GetLazyValue(JsonLazyDocument* doc, const JsonLazyValue* val) {
+	assert(doc&&val);
+	if (doc->_cacheCount != 0) {
+		for (size_t slot = LazyCacheSlot(doc, val); doc->_cache[slot]._entry != nullptr;
+		     slot = (slot + 1) & (doc->_cacheCapacity - 1)) {
+			if (doc->_cache[slot]._entry == val)
+				return doc->_cache[slot]._value;
+		}
+	}
+	JsonContext* context = &doc->_context;
+	context->_json       = doc->_json + val->_offset;
+	context->_end        = doc->_json + doc->_length;
+	DomHandler handler   = { &doc->_values, &doc->_arena, nullptr, false, nullptr };
+	/* the text was validated by JsonParseLazy, parsing it again cannot fail, and it stops where the value ends */
+	RetType ret = SaxParseValue(context, &handler);
+	assert(ret==RetType::PARSE_OK);
+	(void)ret;
+	JsonValue* value = static_cast<JsonValue*>(doc->_arena.Alloc(sizeof(JsonValue)));
+	*value           = *static_cast<JsonValue*>(doc->_values.Pop(sizeof(JsonValue)));
+	if (2 * (doc->_cacheCount + 1) > doc->_cacheCapacity)
+		LazyCacheGrow(doc);
+	LazyCacheInsert(doc, val, value);
+	return value;
+}
@@ -0,0 +1,193 @@
+#include "st_json.h"
+#include "st_json_internal.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace ST_JSON;
+using namespace ST_JSON::INTERNAL;
+
+/* blocks a worker may run ahead of the callback, per worker, which bounds the memory held by results */
+#define LINES_BLOCKS_AHEAD 4
+
+/* a line-aligned slice of the input and, once a worker is done with it, its parsed lines */
+struct LineBlock {
+	const char* _begin;
+
+	const char* _end;
+
+	std::vector<JsonLine> _lines; /* line numbers relative to the block until delivered */
+
+	size_t _lineCount; /* lines started in the block, blank ones included */
+
+	JsonArena _arena;
+
+	bool _parsed;
+};
+
+struct LineReader {
+	std::vector<LineBlock> _blocks;
+
+	size_t _window; /* blocks allowed between the last delivered one and the next to parse */
+
+	std::mutex _mutex;
+
+	std::condition_variable _parsedCond; /* a block has been parsed */
+
+	std::condition_variable _deliveredCond; /* the callback is done with a block */
+
+	size_t _next; /* the next block for a worker */
+
+	size_t _delivered; /* blocks the callback is done with */
+
+	bool _stop;
+
+	const JsonAllocator* _allocator; /* for the block arenas and the worker stacks */
+};
+
+/* cuts right after a newline so that no line spans two blocks */
+static void SplitBlocks(LineReader* reader, const char* json, size_t length) {
+	const char* p   = json;
+	const char* end = json + length;
+	do {
+		const char* cut = end;
+		if (static_cast<size_t>(end - p) > JSON_LINES_BLOCK_SIZE) {
+			const char* nl = static_cast<const char*>(memchr(p + JSON_LINES_BLOCK_SIZE, '\n', end - p - JSON_LINES_BLOCK_SIZE));
+			if (nl)
+				cut = nl + 1;
+		}
+		LineBlock block;
+		block._begin     = p;
+		block._end       = cut;
+		block._lineCount = 0;
+		block._parsed    = false;
+		block._arena.Init(reader->_allocator);
+		reader->_blocks.push_back(block);
+		p = cut;
+	}
+	while (p != end);
+}
+
+static void ParseBlock(LineBlock* block, JsonContext* context, JsonContext* values) {
+	const char* p   = block->_begin;
+	const char* end = block->_end;
+	while (p != end) {
+		const char* nl      = static_cast<const char*>(memchr(p, '\n', end - p));
+		const char* lineEnd = nl
+			                      ? nl
+			                      : end;
+		++block->_lineCount;
+		if (SkipWhitespace(p, lineEnd) != lineEnd) {
+			JsonLine line;
+			line._lineNumber = block->_lineCount;
+			line._ret        = ParseWithStacks(&line._val, p, lineEnd - p, &block->_arena, nullptr, context, values);
+			block->_lines.push_back(line);
+		}
+		p = nl
+			    ? nl + 1
+			    : end;
+	}
+}
+
+static void RunWorker(LineReader* reader) {
+	JsonContext context, values;
+	InitStack(&context, reader->_allocator);
+	InitStack(&values, reader->_allocator);
+	for (;;) {
+		size_t index;
+		{
+			std::unique_lock<std::mutex> lock(reader->_mutex);
+			reader->_deliveredCond.wait(lock, [reader]() {
+				return reader->_stop || reader->_next == reader->_blocks.size() ||
+				       reader->_next < reader->_delivered + reader->_window;
+			});
+			if (reader->_stop || reader->_next == reader->_blocks.size())
+				break;
+			index = reader->_next++;
+		}
+		ParseBlock(&reader->_blocks[index], &context, &values);
+		{
+			std::lock_guard<std::mutex> lock(reader->_mutex);
+			reader->_blocks[index]._parsed = true;
+		}
+		reader->_parsedCond.notify_all();
+	}
+	FreeMemory(reader->_allocator, context._stack);
+	FreeMemory(reader->_allocator, values._stack);
+}
+
+RetType ST_JSON::JsonParseLines(const char* json, size_t length, size_t threadCount, JsonLineCallback callback,
+                                void* user, const JsonAllocator* allocator) {
+	assert((json!=nullptr||length==0)&&callback!=nullptr);
+	if (length == 0)
+		return RetType::PARSE_OK;
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0)
+		threadCount = 1;
+
+	LineReader reader;
+	reader._allocator = allocator;
+	SplitBlocks(&reader, json, length);
+	if (threadCount > reader._blocks.size())
+		threadCount = reader._blocks.size();
+	reader._window    = threadCount * LINES_BLOCKS_AHEAD;
+	reader._next      = 0;
+	reader._delivered = 0;
+	reader._stop      = false;
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < threadCount; ++i)
+		workers.push_back(std::thread(RunWorker, &reader));
+
+	RetType ret      = RetType::PARSE_OK;
+	size_t firstLine = 1;
+	for (size_t i = 0; i < reader._blocks.size() && ret == RetType::PARSE_OK; ++i) {
+		LineBlock* block = &reader._blocks[i];
+		{
+			std::unique_lock<std::mutex> lock(reader._mutex);
+			reader._parsedCond.wait(lock, [block]() {
+				return block->_parsed;
+			});
+		}
+		for (size_t j = 0; j < block->_lines.size(); ++j) {
+			JsonLine* line = &block->_lines[j];
+			line->_lineNumber += firstLine - 1;
+			if (!callback(line, user)) {
+				ret = RetType::PARSE_TERMINATED;
+				break;
+			}
+		}
+		firstLine += block->_lineCount;
+		/* the tree lives in the arena, strings and nodes alike */
+		block->_arena.Free();
+		std::vector<JsonLine>().swap(block->_lines);
+		{
+			std::lock_guard<std::mutex> lock(reader._mutex);
+			reader._delivered = i + 1;
+			reader._stop      = ret != RetType::PARSE_OK;
+		}
+		reader._deliveredCond.notify_all();
+	}
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+	/* after a stop, blocks parsed ahead were never delivered */
+	for (size_t i = reader._delivered; i < reader._blocks.size(); ++i)
+		reader._blocks[i]._arena.Free();
+	return ret;
+}
+
+RetType ST_JSON::JsonParseLinesFile(const char* path, size_t threadCount, JsonLineCallback callback, void* user,
+                                    const JsonAllocator* allocator) {
+	assert(path!=nullptr&&callback!=nullptr);
+	JsonMappedFile file;
+	if (!file.Open(path))
+		return RetType::PARSE_FILE_ERROR;
+	RetType ret = JsonParseLines(file._data, file._size, threadCount, callback, user, allocator);
+	file.Close();
+	return ret;
+}
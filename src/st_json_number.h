@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace ST_JSON {
+
+/*
+ * A validated JSON number as ParseNumber collects it in its single pass:
+ * value = (-1)^_negative * _mantissa * 10^_exp10, where _mantissa keeps at most
+ * 19 significant digits and _truncated tells whether nonzero digits were dropped.
+ * [_begin, _end) is the original text, only read again by the slow path.
+ */
+struct DecimalNumber {
+	uint64_t _mantissa;
+
+	int64_t _exp10;
+
+	bool _negative;
+
+	bool _truncated;
+
+	const char* _begin;
+
+	const char* _end;
+};
+
+/* exponent digits past this are still validated but no longer change the value */
+#define DECIMAL_MAX_EXPONENT 100000
+
+/* correctly rounded (round-half-even) conversion; overflow yields +-HUGE_VAL */
+double DecimalToDouble(const DecimalNumber* num);
+
+#define JSON_NUMBER_MAX_CHARS 32
+
+/*
+ * Writes the shortest text that parses back to exactly d, at most JSON_NUMBER_MAX_CHARS
+ * bytes and not NUL-terminated; returns the length. Non-finite values are written as null.
+ */
+size_t FormatDouble(double d, char* buffer);
+
+}
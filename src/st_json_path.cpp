@@ -0,0 +1,481 @@
+#include "st_json.h"
+#include "st_json_internal.h"
+#include "st_json_reader.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+using namespace ST_JSON;
+using namespace ST_JSON::INTERNAL;
+
+#define PATH_NONE static_cast<size_t>(-1)
+
+/*
+ * A trie node. Going from a node by a key or an index leads to the child of that name if there
+ * is one, else to the wildcard child: paths through * are also inserted below every named sibling,
+ * so one node is ever reached and a value is looked at once whatever the set.
+ */
+struct PathNode {
+	size_t _name, _nameSize; /* in JsonPathSet::_names */
+
+	size_t _index; /* the segment as an array index, PATH_NONE if it is not one */
+
+	size_t _child, _sibling; /* the named children, the last linked first */
+
+	size_t _wildcard;
+
+	size_t _ref; /* the first of the paths ending here */
+};
+
+struct PathRef {
+	size_t _path;
+
+	size_t _next;
+};
+
+/* a segment of the path being compiled, unescaped */
+struct PathSegment {
+	const char* _name;
+
+	size_t _size;
+
+	bool _wildcard;
+};
+
+/* nodes and refs are addressed by index while compiling, pushing may move them */
+static PathNode* NodeAt(const JsonPathSet* set, size_t node) {
+	return static_cast<PathNode*>(static_cast<void*>(set->_nodes._stack)) + node;
+}
+
+static PathRef* RefAt(const JsonPathSet* set, size_t ref) {
+	return static_cast<PathRef*>(static_cast<void*>(set->_refs._stack)) + ref;
+}
+
+static const char* NameOf(const JsonPathSet* set, const PathNode* n) {
+	return set->_names._stack + n->_name;
+}
+
+static size_t NewNode(JsonPathSet* set, const char* name, size_t size, size_t index) {
+	size_t node = set->_nodes._top / sizeof(PathNode);
+	size_t off  = set->_names._top;
+	if (size != 0)
+		memcpy(set->_names.Push(size), name, size);
+	PathNode* n  = static_cast<PathNode*>(set->_nodes.Push(sizeof(PathNode)));
+	n->_name     = off;
+	n->_nameSize = size;
+	n->_index    = index;
+	n->_child    = n->_sibling = n->_wildcard = n->_ref = PATH_NONE;
+	return node;
+}
+
+/* the paths ending at a node are kept in the order they were given */
+static void AddRef(JsonPathSet* set, size_t node, size_t path) {
+	size_t ref = set->_refs._top / sizeof(PathRef);
+	PathRef* r = static_cast<PathRef*>(set->_refs.Push(sizeof(PathRef)));
+	r->_path   = path;
+	r->_next   = PATH_NONE;
+	size_t* link = &NodeAt(set, node)->_ref;
+	while (*link != PATH_NONE)
+		link = &RefAt(set, *link)->_next;
+	*link = ref;
+}
+
+static size_t NamedChild(const JsonPathSet* set, size_t node, const char* name, size_t size) {
+	for (size_t c = NodeAt(set, node)->_child; c != PATH_NONE; c = NodeAt(set, c)->_sibling) {
+		const PathNode* n = NodeAt(set, c);
+		if (n->_nameSize == size && memcmp(NameOf(set, n), name, size) == 0)
+			return c;
+	}
+	return PATH_NONE;
+}
+
+static void LinkChild(JsonPathSet* set, size_t node, size_t child) {
+	NodeAt(set, child)->_sibling = NodeAt(set, node)->_child;
+	NodeAt(set, node)->_child    = child;
+}
+
+/* gives dst, a new node, everything below src */
+static void CloneInto(JsonPathSet* set, size_t dst, size_t src) {
+	for (size_t r = NodeAt(set, src)->_ref; r != PATH_NONE; r = RefAt(set, r)->_next)
+		AddRef(set, dst, RefAt(set, r)->_path);
+	if (NodeAt(set, src)->_wildcard != PATH_NONE) {
+		size_t w = NewNode(set, nullptr, 0, PATH_NONE);
+		NodeAt(set, dst)->_wildcard = w;
+		CloneInto(set, w, NodeAt(set, src)->_wildcard);
+	}
+	for (size_t c = NodeAt(set, src)->_child; c != PATH_NONE; c = NodeAt(set, c)->_sibling) {
+		/* the name may move while the copy is pushed */
+		size_t name = NodeAt(set, c)->_name, size = NodeAt(set, c)->_nameSize;
+		size_t copy = NewNode(set, nullptr, 0, NodeAt(set, c)->_index);
+		NodeAt(set, copy)->_name     = name;
+		NodeAt(set, copy)->_nameSize = size;
+		LinkChild(set, dst, copy);
+		CloneInto(set, copy, c);
+	}
+}
+
+static size_t ParseIndex(const char* name, size_t size) {
+	if (size == 0 || size > 18 || (name[0] == '0' && size > 1))
+		return PATH_NONE;
+	size_t index = 0;
+	for (size_t i = 0; i < size; ++i) {
+		if (name[i] < '0' || name[i] > '9')
+			return PATH_NONE;
+		index = index * 10 + (name[i] - '0');
+	}
+	return index;
+}
+
+static void InsertPath(JsonPathSet* set, size_t node, const PathSegment* segments, size_t count, size_t path) {
+	if (count == 0) {
+		AddRef(set, node, path);
+		return;
+	}
+	if (segments->_wildcard) {
+		if (NodeAt(set, node)->_wildcard == PATH_NONE) {
+			size_t w = NewNode(set, nullptr, 0, PATH_NONE);
+			NodeAt(set, node)->_wildcard = w;
+		}
+		InsertPath(set, NodeAt(set, node)->_wildcard, segments + 1, count - 1, path);
+		for (size_t c = NodeAt(set, node)->_child; c != PATH_NONE; c = NodeAt(set, c)->_sibling)
+			InsertPath(set, c, segments + 1, count - 1, path);
+		return;
+	}
+	size_t child = NamedChild(set, node, segments->_name, segments->_size);
+	if (child == PATH_NONE) {
+		child = NewNode(set, segments->_name, segments->_size, ParseIndex(segments->_name, segments->_size));
+		if (NodeAt(set, node)->_wildcard != PATH_NONE)
+			CloneInto(set, child, NodeAt(set, node)->_wildcard);
+		LinkChild(set, node, child);
+	}
+	InsertPath(set, child, segments + 1, count - 1, path);
+}
+
+/* splits a pointer into segments unescaped into buffer, which has room for the whole pointer */
+static bool SplitPath(const char* path, char* buffer, PathSegment* segments, size_t* count) {
+	*count = 0;
+	if (*path == '\0')
+		return true;
+	if (*path != '/')
+		return false;
+	while (*path == '/') {
+		PathSegment* s = &segments[(*count)++];
+		s->_name = buffer;
+		for (++path; *path != '/' && *path != '\0'; ++path) {
+			if (*path != '~')
+				*buffer++ = *path;
+			else if (path[1] == '0' || path[1] == '1')
+				*buffer++ = *++path == '0'
+					            ? '~'
+					            : '/';
+			else
+				return false;
+		}
+		s->_size     = buffer - s->_name;
+		s->_wildcard = s->_size == 1 && s->_name[0] == '*';
+	}
+	return true;
+}
+
+void JsonPathSet::Init(const JsonAllocator* allocator) {
+	InitStack(&_nodes, allocator);
+	InitStack(&_names, allocator);
+	InitStack(&_refs, allocator);
+	_pathCount = 0;
+}
+
+void JsonPathSet::Free() {
+	const JsonAllocator* allocator = _nodes._allocator;
+	FreeMemory(allocator, _nodes._stack);
+	FreeMemory(allocator, _names._stack);
+	FreeMemory(allocator, _refs._stack);
+	Init(allocator);
+}
+
+bool ST_JSON::JsonCompilePaths(JsonPathSet* set, const char* const* paths, size_t count) {
+	assert(set!=nullptr&&(paths!=nullptr||count==0));
+	set->_nodes._top = set->_names._top = set->_refs._top = 0;
+	set->_pathCount = 0;
+	NewNode(set, nullptr, 0, PATH_NONE);
+	const JsonAllocator* allocator = set->_nodes._allocator;
+	for (size_t i = 0; i < count; ++i) {
+		size_t size = strlen(paths[i]);
+		char* buffer = static_cast<char*>(AllocMemory(allocator, size + 1));
+		PathSegment* segments = static_cast<PathSegment*>(AllocMemory(allocator, (size + 1) * sizeof(PathSegment)));
+		size_t segmentCount;
+		bool ok = SplitPath(paths[i], buffer, segments, &segmentCount);
+		if (ok)
+			InsertPath(set, 0, segments, segmentCount, i);
+		FreeMemory(allocator, buffer);
+		FreeMemory(allocator, segments);
+		if (!ok) {
+			set->_nodes._top = set->_names._top = set->_refs._top = 0;
+			NewNode(set, nullptr, 0, PATH_NONE);
+			return false;
+		}
+	}
+	set->_pathCount = count;
+	return true;
+}
+
+/* where the walk goes from node by a member key or an element index */
+static size_t StepKey(const JsonPathSet* set, size_t node, const char* key, size_t size) {
+	size_t child = NamedChild(set, node, key, size);
+	return child != PATH_NONE
+		       ? child
+		       : NodeAt(set, node)->_wildcard;
+}
+
+static size_t StepIndex(const JsonPathSet* set, size_t node, size_t index) {
+	for (size_t c = NodeAt(set, node)->_child; c != PATH_NONE; c = NodeAt(set, c)->_sibling) {
+		if (NodeAt(set, c)->_index == index)
+			return c;
+	}
+	return NodeAt(set, node)->_wildcard;
+}
+
+static bool HasChildren(const JsonPathSet* set, size_t node) {
+	return NodeAt(set, node)->_child != PATH_NONE || NodeAt(set, node)->_wildcard != PATH_NONE;
+}
+
+static void AddMatches(JsonProjection* proj, const JsonPathSet* set, size_t node, const JsonValue* val) {
+	for (size_t r = NodeAt(set, node)->_ref; r != PATH_NONE; r = RefAt(set, r)->_next) {
+		JsonPathMatch* m = static_cast<JsonPathMatch*>(proj->_matches.Push(sizeof(JsonPathMatch)));
+		m->_path         = RefAt(set, r)->_path;
+		m->_val          = val;
+	}
+}
+
+/* paths that go on below a built value are followed in the tree */
+static void MatchBuilt(JsonProjection* proj, const JsonPathSet* set, size_t node, const JsonValue* val) {
+	if (!HasChildren(set, node))
+		return;
+	if (val->_type == JsonType::JSON_OBJECT) {
+		for (size_t i = 0; i < GetObjSize(val); ++i) {
+			size_t child = StepKey(set, node, GetObjKey(val, i), GetObjKeySize(val, i));
+			if (child != PATH_NONE) {
+				AddMatches(proj, set, child, GetObjValue(val, i));
+				MatchBuilt(proj, set, child, GetObjValue(val, i));
+			}
+		}
+	}
+	else if (val->_type == JsonType::JSON_ARRAY) {
+		for (size_t i = 0; i < GetArraySize(val); ++i) {
+			size_t child = StepIndex(set, node, i);
+			if (child != PATH_NONE) {
+				AddMatches(proj, set, child, GetArrayElement(val, i));
+				MatchBuilt(proj, set, child, GetArrayElement(val, i));
+			}
+		}
+	}
+}
+
+/* steps over a string without unescaping it; escapes are only told apart from the closing quote */
+static RetType SkipString(JsonContext* context) {
+	const char* p   = context->_json + 1;
+	const char* end = context->_end;
+	for (;;) {
+		p = ScanStringRun(p, end);
+		if (p == end)
+			return RetType::PARSE_MISSING_QUOTATION_MARK;
+		if (*p == '"') {
+			context->_json = p + 1;
+			return RetType::PARSE_OK;
+		}
+		p += *p == '\\' && end - p > 1
+			     ? 2
+			     : 1;
+	}
+}
+
+/* steps over the rest of an array or object, from between its values, once nothing more in it can match */
+static RetType SkipRest(JsonContext* context, bool object) {
+	size_t size = SkipContainer(context->_json, 0, context->_end - context->_json, 1);
+	if (size == 0)
+		return object
+			       ? RetType::LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET
+			       : RetType::PARSE_MISSING_COMMA_OR_SQUARE_BRACKET;
+	context->_json += size;
+	return RetType::PARSE_OK;
+}
+
+static RetType SkipValue(JsonContext* context) {
+	switch (CharAt(context->_json, context->_end)) {
+		case 'n': return ParseLiteral(context, "null", 4);
+		case 'f': return ParseLiteral(context, "false", 5);
+		case 't': return ParseLiteral(context, "true", 4);
+		case '"': return SkipString(context);
+		case '[': ++context->_json;
+			return SkipRest(context, false);
+		case '{': ++context->_json;
+			return SkipRest(context, true);
+		case '\0':
+			/* the end of the input, or else a NUL byte in it, which is just an invalid character */
+			if (context->_json == context->_end)
+				return RetType::PARSE_EXPECT_VALUE;
+			/* fall through */
+		default: {
+			DecimalNumber number;
+			return ScanNumber(context, &number);
+		}
+	}
+}
+
+static RetType ProjectValue(JsonProjection* proj, const JsonPathSet* set, JsonContext* context, size_t node);
+
+/*
+ * SaxParseArray and SaxParseObject walking the trie alongside, so the errors agree. Without a
+ * wildcard, an array is left past the highest index a child asks for. An object is walked to its
+ * end whatever the set, since a key may repeat and every member of a selected name is projected.
+ */
+static RetType ProjectArray(JsonProjection* proj, const JsonPathSet* set, JsonContext* context, size_t node) {
+	size_t index = 0;
+	size_t last  = 0; /* 1 + the highest index a child asks for */
+	RetType ret;
+	for (size_t c = NodeAt(set, node)->_child; c != PATH_NONE; c = NodeAt(set, c)->_sibling) {
+		if (NodeAt(set, c)->_index != PATH_NONE && NodeAt(set, c)->_index >= last)
+			last = NodeAt(set, c)->_index + 1;
+	}
+	bool bounded = NodeAt(set, node)->_wildcard == PATH_NONE;
+	++context->_json;
+	ParseWhitespace(context);
+	if (CharAt(context->_json, context->_end) == ']') {
+		++context->_json;
+		return RetType::PARSE_OK;
+	}
+	for (;;) {
+		if (bounded && index >= last)
+			return SkipRest(context, false);
+		size_t child = StepIndex(set, node, index++);
+		ret          = child != PATH_NONE
+			               ? ProjectValue(proj, set, context, child)
+			               : SkipValue(context);
+		if (ret != RetType::PARSE_OK)
+			return ret;
+		ParseWhitespace(context);
+		char ch = CharAt(context->_json, context->_end);
+		if (ch == ',') {
+			++context->_json;
+			ParseWhitespace(context);
+		}
+		else if (ch == ']') {
+			++context->_json;
+			return RetType::PARSE_OK;
+		}
+		else
+			return RetType::PARSE_MISSING_COMMA_OR_SQUARE_BRACKET;
+	}
+}
+
+static RetType ProjectObject(JsonProjection* proj, const JsonPathSet* set, JsonContext* context, size_t node) {
+	RetType ret;
+	++context->_json;
+	ParseWhitespace(context);
+	if (CharAt(context->_json, context->_end) == '}') {
+		++context->_json;
+		return RetType::PARSE_OK;
+	}
+	for (;;) {
+		if (CharAt(context->_json, context->_end) != '"')
+			return RetType::PARSE_MISSING_KEY;
+		const char* key;
+		size_t size;
+		if ((ret = ParseStringRaw(context, &key, &size)) != RetType::PARSE_OK)
+			return ret;
+		/* key may be on the context stack, use it before anything else is pushed */
+		size_t child = StepKey(set, node, key, size);
+		ParseWhitespace(context);
+		if (CharAt(context->_json, context->_end) != ':')
+			return RetType::PARSE_MISSING_COLON;
+		++context->_json;
+		ParseWhitespace(context);
+		ret = child != PATH_NONE
+			      ? ProjectValue(proj, set, context, child)
+			      : SkipValue(context);
+		if (ret != RetType::PARSE_OK)
+			return ret;
+		ParseWhitespace(context);
+		char ch = CharAt(context->_json, context->_end);
+		if (ch == ',') {
+			++context->_json;
+			ParseWhitespace(context);
+		}
+		else if (ch == '}') {
+			++context->_json;
+			return RetType::PARSE_OK;
+		}
+		else
+			return RetType::LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+	}
+}
+
+/* a value some path ends at is built whole, one that paths only pass through is walked, the rest skipped */
+static RetType ProjectValue(JsonProjection* proj, const JsonPathSet* set, JsonContext* context, size_t node) {
+	if (NodeAt(set, node)->_ref != PATH_NONE) {
+		DomHandler handler = { &proj->_values, &proj->_arena, nullptr, false, nullptr };
+		RetType ret;
+		if ((ret = SaxParseValue(context, &handler)) != RetType::PARSE_OK)
+			return ret;
+		JsonValue* value = static_cast<JsonValue*>(proj->_arena.Alloc(sizeof(JsonValue)));
+		*value           = *static_cast<JsonValue*>(proj->_values.Pop(sizeof(JsonValue)));
+		AddMatches(proj, set, node, value);
+		MatchBuilt(proj, set, node, value);
+		return RetType::PARSE_OK;
+	}
+	char ch = CharAt(context->_json, context->_end);
+	if (ch == '{' && HasChildren(set, node))
+		return ProjectObject(proj, set, context, node);
+	if (ch == '[' && HasChildren(set, node))
+		return ProjectArray(proj, set, context, node);
+	return SkipValue(context);
+}
+
+void JsonProjection::Init(const JsonAllocator* allocator) {
+	_arena.Init(allocator);
+	InitStack(&_matches, allocator);
+	InitStack(&_context, allocator);
+	InitStack(&_values, allocator);
+}
+
+void JsonProjection::Free() {
+	const JsonAllocator* allocator = _arena._allocator;
+	_arena.Free();
+	FreeMemory(allocator, _matches._stack);
+	FreeMemory(allocator, _context._stack);
+	FreeValueStack(&_values);
+	Init(allocator);
+}
+
+RetType ST_JSON::JsonParseProjected(JsonProjection* proj, const JsonPathSet* set, const char* json, size_t length) {
+	assert(proj!=nullptr&&set!=nullptr&&set->_nodes._top!=0&&(json!=nullptr||length==0));
+	proj->_arena.Clear();
+	proj->_matches._top  = 0;
+	JsonContext* context = &proj->_context;
+	context->_json       = json;
+	context->_end        = json + length;
+	context->_top        = 0;
+
+	ParseWhitespace(context);
+	RetType ret;
+	if ((ret = ProjectValue(proj, set, context, 0)) == RetType::PARSE_OK) {
+		ParseWhitespace(context);
+		if (context->_json != context->_end)
+			ret = RetType::PARSE_ROOT_NOT_SINGULAR;
+	}
+	if (ret != RetType::PARSE_OK) {
+		DropValues(&proj->_values);
+		proj->_matches._top = 0;
+	}
+	return ret;
+}
+
+size_t ST_JSON::GetMatchCount(const JsonProjection* proj) {
+	assert(proj!=nullptr);
+	return proj->_matches._top / sizeof(JsonPathMatch);
+}
+
+const JsonPathMatch* ST_JSON::GetMatch(const JsonProjection* proj, size_t index) {
+	assert(proj!=nullptr&&index<GetMatchCount(proj));
+	return static_cast<const JsonPathMatch*>(static_cast<const void*>(proj->_matches._stack)) + index;
+}
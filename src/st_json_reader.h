@@ -0,0 +1,251 @@
+#pragma once
+#include "st_json.h"
+#include "st_json_internal.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+namespace ST_JSON {
+
+/*
+ * Event-driven parsing. The handler is any type with these members, the calls are resolved at
+ * compile time so they inline; returning false stops the parse with PARSE_TERMINATED:
+ *
+ *   bool Null();
+ *   bool Bool(bool b);
+ *   bool Number(double d);
+ *   bool String(const char* str, size_t size);
+ *   bool StartObject();
+ *   bool Key(const char* str, size_t size);
+ *   bool EndObject(size_t memberCount);
+ *   bool StartArray();
+ *   bool EndArray(size_t elementCount);
+ *
+ * str is only valid during the call, except in situ where it is the NUL-terminated text inside
+ * json. No tree is built: the reader needs memory for the nesting depth and the longest escaped
+ * string only. On error the handler has seen the events up to the bad token.
+ */
+template <typename Handler>
+RetType JsonParseSax(Handler* handler, const char* json);
+
+/* the reader's stack comes from allocator */
+template <typename Handler>
+RetType JsonParseSax(Handler* handler, const char* json, size_t length, const JsonAllocator* allocator = nullptr);
+
+template <typename Handler>
+RetType JsonParseSaxInsitu(Handler* handler, char* json);
+
+template <typename Handler>
+RetType JsonParseSaxInsitu(Handler* handler, char* json, size_t length, const JsonAllocator* allocator = nullptr);
+
+namespace INTERNAL {
+
+template <typename Handler>
+RetType SaxParseValue(JsonContext* context, Handler* handler);
+
+template <typename Handler>
+RetType SaxParseString(JsonContext* context, Handler* handler, bool isKey) {
+	RetType ret;
+	bool accepted;
+	if (context->_insitu) {
+		char* str;
+		size_t len;
+		if ((ret = ParseStringInsitu(context, &str, &len)) != RetType::PARSE_OK)
+			return ret;
+		accepted = isKey
+			           ? handler->Key(str, len)
+			           : handler->String(str, len);
+	}
+	else {
+		const char* str;
+		size_t len;
+		if ((ret = ParseStringRaw(context, &str, &len)) != RetType::PARSE_OK)
+			return ret;
+		accepted = isKey
+			           ? handler->Key(str, len)
+			           : handler->String(str, len);
+	}
+	return accepted
+		       ? RetType::PARSE_OK
+		       : RetType::PARSE_TERMINATED;
+}
+
+template <typename Handler>
+RetType SaxParseArray(JsonContext* context, Handler* handler) {
+	size_t size = 0;
+	RetType ret;
+	assert(CharAt(context->_json, context->_end) == '[');
+	++context->_json;
+	if (!handler->StartArray())
+		return RetType::PARSE_TERMINATED;
+	ParseWhitespace(context);
+	if (CharAt(context->_json, context->_end) == ']') {
+		++context->_json;
+		return handler->EndArray(0)
+			       ? RetType::PARSE_OK
+			       : RetType::PARSE_TERMINATED;
+	}
+	for (;;) {
+		if ((ret = SaxParseValue(context, handler)) != RetType::PARSE_OK)
+			return ret;
+		++size;
+		ParseWhitespace(context);
+		char ch = CharAt(context->_json, context->_end);
+		if (ch == ',') {
+			++context->_json;
+			ParseWhitespace(context);
+		}
+		else if (ch == ']') {
+			++context->_json;
+			return handler->EndArray(size)
+				       ? RetType::PARSE_OK
+				       : RetType::PARSE_TERMINATED;
+		}
+		else
+			return RetType::PARSE_MISSING_COMMA_OR_SQUARE_BRACKET;
+	}
+}
+
+template <typename Handler>
+RetType SaxParseObject(JsonContext* context, Handler* handler) {
+	size_t size = 0;
+	RetType ret;
+	assert(CharAt(context->_json, context->_end) == '{');
+	++context->_json;
+	if (!handler->StartObject())
+		return RetType::PARSE_TERMINATED;
+	ParseWhitespace(context);
+	if (CharAt(context->_json, context->_end) == '}') {
+		++context->_json;
+		return handler->EndObject(0)
+			       ? RetType::PARSE_OK
+			       : RetType::PARSE_TERMINATED;
+	}
+	for (;;) {
+		if (CharAt(context->_json, context->_end) != '"')
+			return RetType::PARSE_MISSING_KEY;
+		if ((ret = SaxParseString(context, handler, true)) != RetType::PARSE_OK)
+			return ret;
+		ParseWhitespace(context);
+		if (CharAt(context->_json, context->_end) != ':')
+			return RetType::PARSE_MISSING_COLON;
+		++context->_json;
+		ParseWhitespace(context);
+		if ((ret = SaxParseValue(context, handler)) != RetType::PARSE_OK)
+			return ret;
+		++size;
+		ParseWhitespace(context);
+		char ch = CharAt(context->_json, context->_end);
+		if (ch == ',') {
+			++context->_json;
+			ParseWhitespace(context);
+		}
+		else if (ch == '}') {
+			++context->_json;
+			return handler->EndObject(size)
+				       ? RetType::PARSE_OK
+				       : RetType::PARSE_TERMINATED;
+		}
+		else
+			return RetType::LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+	}
+}
+
+template <typename Handler>
+RetType SaxParseValue(JsonContext* context, Handler* handler) {
+	RetType ret;
+	bool accepted;
+	switch (CharAt(context->_json, context->_end)) {
+		case 'n': {
+			if ((ret = ParseLiteral(context, "null", 4)) != RetType::PARSE_OK)
+				return ret;
+			accepted = handler->Null();
+			break;
+		}
+		case 'f': {
+			if ((ret = ParseLiteral(context, "false", 5)) != RetType::PARSE_OK)
+				return ret;
+			accepted = handler->Bool(false);
+			break;
+		}
+		case 't': {
+			if ((ret = ParseLiteral(context, "true", 4)) != RetType::PARSE_OK)
+				return ret;
+			accepted = handler->Bool(true);
+			break;
+		}
+		case '"': return SaxParseString(context, handler, false);
+		case '[': return SaxParseArray(context, handler);
+		case '{': return SaxParseObject(context, handler);
+		case '\0':
+			/* the end of the input, or else a NUL byte in it, which is just an invalid character */
+			if (context->_json == context->_end)
+				return RetType::PARSE_EXPECT_VALUE;
+			/* fall through */
+		default: {
+			double d;
+			if ((ret = ParseNumberRaw(context, &d)) != RetType::PARSE_OK)
+				return ret;
+			accepted = handler->Number(d);
+		}
+	}
+	return accepted
+		       ? RetType::PARSE_OK
+		       : RetType::PARSE_TERMINATED;
+}
+
+/* context supplies the input and a stack that may be kept for the next parse */
+template <typename Handler>
+RetType SaxParseRoot(JsonContext* context, Handler* handler) {
+	ParseWhitespace(context);
+	RetType ret;
+	if ((ret = SaxParseValue(context, handler)) == RetType::PARSE_OK) {
+		ParseWhitespace(context);
+		if (context->_json != context->_end)
+			ret = RetType::PARSE_ROOT_NOT_SINGULAR;
+	}
+	assert(context->_top==0);
+	return ret;
+}
+
+template <typename Handler>
+RetType SaxParseRoot(Handler* handler, const char* json, size_t length, bool insitu, const JsonAllocator* allocator) {
+	JsonContext c;
+	InitStack(&c, allocator);
+	c._json   = json;
+	c._end    = json + length;
+	c._insitu = insitu;
+
+	RetType ret = SaxParseRoot(&c, handler);
+	FreeMemory(allocator, c._stack);
+	return ret;
+}
+
+}
+
+template <typename Handler>
+RetType JsonParseSax(Handler* handler, const char* json) {
+	assert(handler!=nullptr&&json!=nullptr);
+	return INTERNAL::SaxParseRoot(handler, json, strlen(json), false, nullptr);
+}
+
+template <typename Handler>
+RetType JsonParseSax(Handler* handler, const char* json, size_t length, const JsonAllocator* allocator) {
+	assert(handler!=nullptr&&(json!=nullptr||length==0));
+	return INTERNAL::SaxParseRoot(handler, json, length, false, allocator);
+}
+
+template <typename Handler>
+RetType JsonParseSaxInsitu(Handler* handler, char* json) {
+	assert(handler!=nullptr&&json!=nullptr);
+	return INTERNAL::SaxParseRoot(handler, json, strlen(json), true, nullptr);
+}
+
+template <typename Handler>
+RetType JsonParseSaxInsitu(Handler* handler, char* json, size_t length, const JsonAllocator* allocator) {
+	assert(handler!=nullptr&&(json!=nullptr||length==0));
+	return INTERNAL::SaxParseRoot(handler, json, length, true, allocator);
+}
+
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include "st_json.h"
+
+#include <cassert>
+#include <utility>  /* std::move */
+
+namespace ST_JSON {
+
+/*
+ * Owning handles over the C-style API: what they hold is freed when they go out of scope. They
+ * move but do not copy, DeepCopy says when a copy is wanted. Moving a handle, swapping two, or
+ * taking a subtree out of one tree and giving it to another moves the 16 bytes of a JsonValue
+ * whatever is below it. A Value owns a tree on the heap; a Document keeps its tree in an arena.
+ * Pointers from Get and Root work with every function of st_json.h.
+ */
+class Value {
+public:
+	Value() noexcept {
+		_val.Init();
+	}
+
+	~Value() {
+		_val.Free();
+	}
+
+	Value(Value&& other) noexcept : _val(other._val) {
+		other._val.Init();
+	}
+
+	Value& operator=(Value&& other) noexcept {
+		if (this != &other)
+			JsonMove(&_val, &other._val);
+		return *this;
+	}
+
+	Value(const Value&) = delete;
+
+	Value& operator=(const Value&) = delete;
+
+	void Swap(Value& other) noexcept {
+		JsonSwap(&_val, &other._val);
+	}
+
+	Value DeepCopy() const {
+		Value copy;
+		JsonCopy(&copy._val, &_val);
+		return copy;
+	}
+
+	/* frees what the value held first */
+	RetType Parse(const char* json, size_t length) {
+		_val.Free();
+		return JsonParse(&_val, json, length);
+	}
+
+	RetType Parse(const char* json) {
+		_val.Free();
+		return JsonParse(&_val, json);
+	}
+
+	/*
+	 * Takes over the subtree at slot, which is left null, for instance an element or member value
+	 * of another tree. A subtree of a Document stays in its arena: it must not outlive the
+	 * document, DeepCopy it instead.
+	 */
+	void Take(JsonValue* slot) {
+		assert(slot!=&_val);
+		JsonMove(&_val, slot);
+	}
+
+	/* hands the tree to slot, in another tree or not, and becomes null */
+	void Give(JsonValue* slot) {
+		assert(slot!=&_val);
+		JsonMove(slot, &_val);
+	}
+
+	JsonValue* Get() noexcept {
+		return &_val;
+	}
+
+	const JsonValue* Get() const noexcept {
+		return &_val;
+	}
+
+private:
+	JsonValue _val;
+};
+
+class Document {
+public:
+	Document() noexcept {
+		_doc.Init();
+	}
+
+	/* the arena, keys and parse stacks come from allocator, which has to outlive the document */
+	explicit Document(const JsonAllocator* allocator) noexcept {
+		_doc.Init(allocator);
+	}
+
+	/* what was set or built into the tree after parsing is on the heap, and freed with it */
+	~Document() {
+		JsonFreeEdits(&_doc);
+		_doc.Free();
+	}
+
+	Document(Document&& other) noexcept : _doc(other._doc) {
+		other._doc.Init(other._doc._arena._allocator);
+	}
+
+	Document& operator=(Document&& other) noexcept {
+		if (this != &other) {
+			Document old(std::move(*this));
+			Swap(other);
+		}
+		return *this;
+	}
+
+	Document(const Document&) = delete;
+
+	Document& operator=(const Document&) = delete;
+
+	void Swap(Document& other) noexcept {
+		JsonDocument temp = _doc;
+		_doc              = other._doc;
+		other._doc        = temp;
+	}
+
+	/* a document of its own with a copy of the tree, keys interned again */
+	Document DeepCopy() const {
+		Document copy(_doc._arena._allocator);
+		JsonCopy(&copy._doc, &_doc._root);
+		return copy;
+	}
+
+	/* recycles the arena; subtrees taken out of the document become invalid */
+	RetType Parse(const char* json, size_t length) {
+		JsonFreeEdits(&_doc);
+		return JsonParse(&_doc, json, length);
+	}
+
+	RetType Parse(const char* json) {
+		JsonFreeEdits(&_doc);
+		return JsonParse(&_doc, json);
+	}
+
+	JsonValue* Root() noexcept {
+		return &_doc._root;
+	}
+
+	const JsonValue* Root() const noexcept {
+		return &_doc._root;
+	}
+
+	JsonDocument* Get() noexcept {
+		return &_doc;
+	}
+
+	const JsonDocument* Get() const noexcept {
+		return &_doc;
+	}
+
+private:
+	JsonDocument _doc;
+};
+
+}
@@ -0,0 +1,267 @@
+#include "st_json.h"
+#include "st_json_internal.h"
+#include "st_json_number.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <errno.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace ST_JSON;
+using namespace ST_JSON::INTERNAL;
+
+struct WriterFrame {
+	size_t _count;
+
+	bool _object;
+};
+
+static bool FileSink(const char* data, size_t size, void* user) {
+	return fwrite(data, 1, size, static_cast<FILE*>(user)) == size;
+}
+
+static bool FdSink(const char* data, size_t size, void* user) {
+	int fd = static_cast<int>(reinterpret_cast<intptr_t>(user));
+	while (size != 0) {
+#ifdef _WIN32
+		int n = _write(fd, data, static_cast<unsigned>(size < 0x40000000 ? size : 0x40000000));
+#else
+		ssize_t n = write(fd, data, size);
+#endif
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		data += n;
+		size -= static_cast<size_t>(n);
+	}
+	return true;
+}
+
+void JsonWriter::Init(JsonSinkCallback sink, void* user, const JsonAllocator* allocator) {
+	assert(sink!=nullptr);
+	_sink     = sink;
+	_user     = user;
+	_buffer   = static_cast<char*>(AllocMemory(allocator, JSON_WRITER_BUFFER_SIZE));
+	_used     = 0;
+	_written  = 0;
+	InitStack(&_frames, allocator);
+	_afterKey = false;
+	_started  = false;
+	_failed   = false;
+}
+
+void JsonWriter::Init(FILE* file, const JsonAllocator* allocator) {
+	assert(file!=nullptr);
+	Init(FileSink, file, allocator);
+}
+
+void JsonWriter::Init(int fd, const JsonAllocator* allocator) {
+	assert(fd>=0);
+	Init(FdSink, reinterpret_cast<void*>(static_cast<intptr_t>(fd)), allocator);
+}
+
+void JsonWriter::Free() {
+	FreeMemory(_frames._allocator, _buffer);
+	FreeMemory(_frames._allocator, _frames._stack);
+	_buffer = nullptr;
+	InitStack(&_frames, _frames._allocator);
+}
+
+bool JsonWriter::Flush() {
+	if (_failed)
+		return false;
+	if (_used != 0) {
+		if (!_sink(_buffer, _used, _user)) {
+			_failed = true;
+			return false;
+		}
+		_written += _used;
+		_used = 0;
+	}
+	return true;
+}
+
+/* room for size more bytes, size being at most the buffer */
+static inline bool Reserve(JsonWriter* writer, size_t size) {
+	assert(size<=JSON_WRITER_BUFFER_SIZE);
+	return JSON_WRITER_BUFFER_SIZE - writer->_used >= size || writer->Flush();
+}
+
+static inline bool PutChar(JsonWriter* writer, char ch) {
+	if (!Reserve(writer, 1))
+		return false;
+	writer->_buffer[writer->_used++] = ch;
+	return true;
+}
+
+static inline bool PutLiteral(JsonWriter* writer, const char* str, size_t size) {
+	if (!Reserve(writer, size))
+		return false;
+	memcpy(writer->_buffer + writer->_used, str, size);
+	writer->_used += size;
+	return true;
+}
+
+/* copies clean runs through the buffer, flushing in between, and escapes the bytes that end them */
+static bool PutString(JsonWriter* writer, const char* str, size_t size) {
+	const char* end = str + size;
+	if (!PutChar(writer, '"'))
+		return false;
+	while (str != end) {
+		const char* run = ScanStringRun(str, end);
+		while (str != run) {
+			if (writer->_used == JSON_WRITER_BUFFER_SIZE && !writer->Flush())
+				return false;
+			size_t n = JSON_WRITER_BUFFER_SIZE - writer->_used;
+			if (n > static_cast<size_t>(run - str))
+				n = run - str;
+			memcpy(writer->_buffer + writer->_used, str, n);
+			writer->_used += n;
+			str += n;
+		}
+		if (str == end)
+			break;
+		if (!Reserve(writer, 6))
+			return false;
+		writer->_used = EscapeChar(writer->_buffer + writer->_used, static_cast<unsigned char>(*str++)) - writer->_buffer;
+	}
+	return PutChar(writer, '"');
+}
+
+static bool PutNumber(JsonWriter* writer, double d) {
+	if (!Reserve(writer, JSON_NUMBER_MAX_CHARS))
+		return false;
+	writer->_used += FormatDouble(d, writer->_buffer + writer->_used);
+	return true;
+}
+
+static WriterFrame* TopFrame(JsonWriter* writer) {
+	return writer->_frames._top != 0
+		       ? reinterpret_cast<WriterFrame*>(writer->_frames._stack + writer->_frames._top - sizeof(WriterFrame))
+		       : nullptr;
+}
+
+/* the separator a value needs where it goes: a comma between elements, a newline between top-level values */
+static bool BeginValue(JsonWriter* writer) {
+	if (writer->_failed)
+		return false;
+	WriterFrame* frame = TopFrame(writer);
+	if (!frame) {
+		bool first       = !writer->_started;
+		writer->_started = true;
+		return first || PutChar(writer, '\n');
+	}
+	if (frame->_object) {
+		assert(writer->_afterKey&&"a member value needs its key first");
+		writer->_afterKey = false;
+		return true;
+	}
+	return frame->_count++ == 0 || PutChar(writer, ',');
+}
+
+static bool WriteValue(JsonWriter* writer, const JsonValue* val) {
+	switch (GetType(val)) {
+		case JsonType::JSON_NULL: return PutLiteral(writer, "null", 4);
+		case JsonType::JSON_TRUE: return PutLiteral(writer, "true", 4);
+		case JsonType::JSON_FALSE: return PutLiteral(writer, "false", 5);
+		case JsonType::JSON_NUMBER: return PutNumber(writer, GetNumber(val));
+		case JsonType::JSON_STRING: return PutString(writer, GetString(val), GetStringSize(val));
+		case JsonType::JSON_ARRAY:
+			if (!PutChar(writer, '['))
+				return false;
+			for (size_t i = 0; i < GetArraySize(val); ++i) {
+				if ((i > 0 && !PutChar(writer, ',')) || !WriteValue(writer, GetArrayElement(val, i)))
+					return false;
+			}
+			return PutChar(writer, ']');
+		case JsonType::JSON_OBJECT:
+			if (!PutChar(writer, '{'))
+				return false;
+			for (size_t i = 0; i < GetObjSize(val); ++i) {
+				if ((i > 0 && !PutChar(writer, ',')) || !PutString(writer, GetObjKey(val, i), GetObjKeySize(val, i)) ||
+					!PutChar(writer, ':') || !WriteValue(writer, GetObjValue(val, i)))
+					return false;
+			}
+			return PutChar(writer, '}');
+		default: assert(0&&"invalid type");
+			return false;
+	}
+}
+
+bool JsonWriter::Null() {
+	return BeginValue(this) && PutLiteral(this, "null", 4);
+}
+
+bool JsonWriter::Bool(bool b) {
+	return BeginValue(this) && (b
+		                            ? PutLiteral(this, "true", 4)
+		                            : PutLiteral(this, "false", 5));
+}
+
+bool JsonWriter::Number(double d) {
+	return BeginValue(this) && PutNumber(this, d);
+}
+
+bool JsonWriter::String(const char* str, size_t size) {
+	assert(str||size==0);
+	return BeginValue(this) && PutString(this, str, size);
+}
+
+static bool StartContainer(JsonWriter* writer, bool object) {
+	char open = object
+		            ? '{'
+		            : '[';
+	if (!BeginValue(writer) || !PutChar(writer, open))
+		return false;
+	WriterFrame* frame = static_cast<WriterFrame*>(writer->_frames.Push(sizeof(WriterFrame)));
+	frame->_count      = 0;
+	frame->_object     = object;
+	return true;
+}
+
+static bool EndContainer(JsonWriter* writer, bool object) {
+	assert(TopFrame(writer)&&TopFrame(writer)->_object==object&&!writer->_afterKey);
+	char close = object
+		             ? '}'
+		             : ']';
+	writer->_frames.Pop(sizeof(WriterFrame));
+	return !writer->_failed && PutChar(writer, close);
+}
+
+bool JsonWriter::StartObject() {
+	return StartContainer(this, true);
+}
+
+bool JsonWriter::Key(const char* str, size_t size) {
+	WriterFrame* frame = TopFrame(this);
+	assert(str||size==0);
+	assert(frame&&frame->_object&&!_afterKey&&"a key goes in an object, before its value");
+	if (_failed || (frame->_count++ != 0 && !PutChar(this, ',')) || !PutString(this, str, size) || !PutChar(this, ':'))
+		return false;
+	_afterKey = true;
+	return true;
+}
+
+bool JsonWriter::EndObject(size_t) {
+	return EndContainer(this, true);
+}
+
+bool JsonWriter::StartArray() {
+	return StartContainer(this, false);
+}
+
+bool JsonWriter::EndArray(size_t) {
+	return EndContainer(this, false);
+}
+
+bool JsonWriter::Value(const JsonValue* val) {
+	assert(val!=nullptr);
+	return BeginValue(this) && WriteValue(this, val);
+}
@@ -1,6 +1,12 @@
 #include<iostream>
+#include<cstring>
+#include<atomic>
 
 #include "st_json.h"
+#include "st_json_allocator.h"
+#include "st_json_bind.h"
+#include "st_json_reader.h"
+#include "st_json_value.h"
 #include "../3rd/ST_UNIT_TEST/st_unit_test.h"
 using namespace std;
 using namespace ST_UNIT_TEST;
@@ -81,6 +87,19 @@ static void TestParseNumber() {
 	TEST_NUMBER(-2.2250738585072014e-308, "-2.2250738585072014e-308");
 	TEST_NUMBER(1.7976931348623157e+308, "1.7976931348623157e+308"); /* Max double */
 	TEST_NUMBER(-1.7976931348623157e+308, "-1.7976931348623157e+308");
+
+	TEST_NUMBER(1e23, "1e23");                                   /* not exact: Clinger fast path must decline */
+	TEST_NUMBER(9007199254740992.0, "9007199254740993");         /* 2^53 + 1, ties to even */
+	TEST_NUMBER(9007199254740994.0, "9007199254740993.0000000000000000001");
+	TEST_NUMBER(0.1, "0.1000000000000000055511151231257827021181583404541015625");
+	TEST_NUMBER(1.0, "0.99999999999999999999999999999999999999999999999999999999");
+	TEST_NUMBER(123456.0, "0.000000000000000000000000000000123456e36");
+	TEST_NUMBER(4.9406564584124654e-324, "2.4703282292062328e-324"); /* just above half the minimum denormal */
+	TEST_NUMBER(0.0, "2.4703282292062327e-324");
+
+	/* integer digits dropped past the slow path's digit cap still move the point */
+	string longNumber = "9007199254740993" + string(900, '0') + "1e-901";
+	TEST_NUMBER(9007199254740994.0, longNumber.c_str());
 }
 
 static void TestInValidNumber() {
@@ -99,6 +118,8 @@ static void TestParseNumberTooBig() {
 	printf("Test parse number too big \n");
 	TEST_ERROR(PARSE_NUMBER_TOO_BIG, "1e309");
 	TEST_ERROR(PARSE_NUMBER_TOO_BIG, "-1e309");
+	TEST_ERROR(PARSE_NUMBER_TOO_BIG, "1.7976931348623159e308");
+	TEST_ERROR(PARSE_NUMBER_TOO_BIG, "1e99999999999999999999");
 }
 
 static void TestParseInValidValue() {
@@ -128,6 +149,33 @@ static void TestParseString() {
 	TEST_STRING("\xE2\x82\xAC", "\"\\u20AC\"");            /* Euro sign U+20AC */
 	TEST_STRING("\xF0\x9D\x84\x9E", "\"\\uD834\\uDD1E\""); /* G clef sign U+1D11E */
 	TEST_STRING("\xF0\x9D\x84\x9E", "\"\\ud834\\udd1e\""); /* G clef sign U+1D11E */
+
+	/* runs longer than one vector, with the special byte at every lane position */
+	TEST_STRING("0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ",
+	            "\"0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ\"");
+	TEST_STRING("0123456789abcdefghijklmnopqrstuvwxyz\nABCDEFGHIJKLMNOPQRSTUVWXYZ",
+	            "\"0123456789abcdefghijklmnopqrstuvwxyz\\nABCDEFGHIJKLMNOPQRSTUVWXYZ\"");
+	TEST_STRING("0123456789abcdefghijklmnopqrstuvwxyz\"ABCDEFGHIJKLMNOPQRSTUVWXYZ\\",
+	            "\"0123456789abcdefghijklmnopqrstuvwxyz\\\"ABCDEFGHIJKLMNOPQRSTUVWXYZ\\\\\"");
+	{
+		char json[80];
+		for (size_t i = 0; i < 70; ++i) {
+			memset(json, 'a', sizeof(json));
+			json[0]     = '"';
+			json[i + 1] = '\x01';
+			json[72]    = '"';
+			json[73]    = '\0';
+			TEST_ERROR(PARSE_INVALID_STRING_CHAR, json);
+		}
+	}
+}
+
+static void TestParseWhitespace() {
+	JsonValue v;
+	v.Init();
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&v, " \t\r\n                                                  \n\t\ttrue \r\n\t                                 "));
+	ST_EXPECT_EQ_INT(JsonType::JSON_TRUE, GetType(&v));
+	ST_EXPECT_EQ_INT(RetType::PARSE_ROOT_NOT_SINGULAR, JsonParse(&v, "null                                                            x"));
 }
 
 static void TestParseMissingQuotationMark() {
@@ -276,6 +324,1642 @@ static void TestParseObject() {
     v.Free();
 }
 
+static void TestParseDocument() {
+	JsonDocument doc;
+	doc.Init();
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&doc, "{ \"a\" : [ 1, \"two\", { \"three\" : 3 } ], \"s\" : \"x\\ty\" }"));
+	ST_EXPECT_EQ_INT(JsonType::JSON_OBJECT, GetType(&doc._root));
+	ST_EXPECT_EQ_SIZE_T(2, GetObjSize(&doc._root));
+	ST_EXPECT_EQ_C_STR("a", GetObjKey(&doc._root, 0), GetObjKeySize(&doc._root, 0));
+	JsonValue* a = GetObjValue(&doc._root, 0);
+	ST_EXPECT_EQ_SIZE_T(3, GetArraySize(a));
+	ST_EXPECT_EQ_DOUBLE(1.0, GetNumber(GetArrayElement(a, 0)));
+	ST_EXPECT_EQ_C_STR("two", GetString(GetArrayElement(a, 1)), GetStringSize(GetArrayElement(a, 1)));
+	ST_EXPECT_EQ_C_STR("three", GetObjKey(GetArrayElement(a, 2), 0), GetObjKeySize(GetArrayElement(a, 2), 0));
+	ST_EXPECT_EQ_C_STR("x\ty", GetString(GetObjValue(&doc._root, 1)), GetStringSize(GetObjValue(&doc._root, 1)));
+
+	/* values inside the document can be reassigned */
+	SetString(GetArrayElement(a, 1), "2", 1);
+	ST_EXPECT_EQ_C_STR("2", GetString(GetArrayElement(a, 1)), GetStringSize(GetArrayElement(a, 1)));
+	GetArrayElement(a, 1)->Free();
+
+	/* reparsing recycles the arena */
+	ST_EXPECT_EQ_INT(RetType::PARSE_MISSING_COMMA_OR_SQUARE_BRACKET, JsonParse(&doc, "[ \"abc\", [ 1 } ]"));
+	ST_EXPECT_EQ_INT(JsonType::JSON_NULL, GetType(&doc._root));
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&doc, "[ \"abc\", [ 1 ] ]"));
+	ST_EXPECT_EQ_SIZE_T(2, GetArraySize(&doc._root));
+	doc.Free();
+
+	{
+		/* big arrays get chunks of their own */
+		string json = "[";
+		for (size_t i = 0; i < 100000; ++i)
+			json += i ? ",\"0123456789\"" : "\"0123456789\"";
+		json += "]";
+		doc.Init();
+		ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&doc, json.c_str()));
+		ST_EXPECT_EQ_SIZE_T(100000, GetArraySize(&doc._root));
+		ST_EXPECT_EQ_C_STR("0123456789", GetString(GetArrayElement(&doc._root, 99999)), GetStringSize(GetArrayElement(&doc._root, 99999)));
+		doc.Free();
+	}
+}
+
+static void TestParseInsitu() {
+	char json[] = "{ \"plain\" : \"abc\", \"esc\\naped\" : [ \"x\\ty\", \"\\u20AC\\uD834\\uDD1E!\" ], \"n\" : 1.5 }";
+	const char* begin = json;
+	const char* end   = json + sizeof(json);
+	JsonValue v;
+	v.Init();
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseInsitu(&v, json));
+	ST_EXPECT_EQ_SIZE_T(3, GetObjSize(&v));
+	ST_EXPECT_EQ_C_STR("plain", GetObjKey(&v, 0), GetObjKeySize(&v, 0));
+	ST_EXPECT_EQ_C_STR("abc", GetString(GetObjValue(&v, 0)), GetStringSize(GetObjValue(&v, 0)));
+	ST_EXPECT_EQ_C_STR("esc\naped", GetObjKey(&v, 1), GetObjKeySize(&v, 1));
+	JsonValue* a = GetObjValue(&v, 1);
+	ST_EXPECT_EQ_C_STR("x\ty", GetString(GetArrayElement(a, 0)), GetStringSize(GetArrayElement(a, 0)));
+	ST_EXPECT_EQ_C_STR("\xE2\x82\xAC\xF0\x9D\x84\x9E!", GetString(GetArrayElement(a, 1)), GetStringSize(GetArrayElement(a, 1)));
+	ST_EXPECT_EQ_DOUBLE(1.5, GetNumber(GetObjValue(&v, 2)));
+	/* strings point into the buffer and are NUL-terminated there */
+	ST_EXPECT_TRUE(GetObjKey(&v, 1) > begin && GetObjKey(&v, 1) < end);
+	ST_EXPECT_TRUE(GetString(GetArrayElement(a, 1)) > begin && GetString(GetArrayElement(a, 1)) < end);
+	ST_EXPECT_EQ_INT('\0', GetString(GetObjValue(&v, 0))[3]);
+	v.Free();
+
+	char bad[] = "[ \"abc\", \"\\x\" ]";
+	ST_EXPECT_EQ_INT(RetType::PARSE_INVALID_STRING_ESCAPE, JsonParseInsitu(&v, bad));
+	ST_EXPECT_EQ_INT(JsonType::JSON_NULL, GetType(&v));
+
+	char docJson[] = "[ \"a\\\"b\", { \"k\" : \"v\" } ]";
+	JsonDocument doc;
+	doc.Init();
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseInsitu(&doc, docJson));
+	ST_EXPECT_EQ_C_STR("a\"b", GetString(GetArrayElement(&doc._root, 0)), GetStringSize(GetArrayElement(&doc._root, 0)));
+	ST_EXPECT_EQ_C_STR("v", GetString(GetObjValue(GetArrayElement(&doc._root, 1), 0)), GetStringSize(GetObjValue(GetArrayElement(&doc._root, 1), 0)));
+	doc.Free();
+}
+
+static void TestParseLength() {
+	JsonValue v;
+	v.Init();
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&v, "[ 1, 2 ]garbage", 8));
+	ST_EXPECT_EQ_SIZE_T(2, GetArraySize(&v));
+	v.Free();
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&v, "12345", 2));
+	ST_EXPECT_EQ_DOUBLE(12.0, GetNumber(&v));
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&v, "\"abc\"\"", 5));
+	ST_EXPECT_EQ_C_STR("abc", GetString(&v), GetStringSize(&v));
+	v.Free();
+	ST_EXPECT_EQ_INT(RetType::PARSE_EXPECT_VALUE, JsonParse(&v, "", 0));
+	ST_EXPECT_EQ_INT(RetType::PARSE_INVALID_VALUE, JsonParse(&v, "true", 3));
+	ST_EXPECT_EQ_INT(RetType::PARSE_INVALID_VALUE, JsonParse(&v, "1.5", 2));
+	ST_EXPECT_EQ_INT(RetType::PARSE_MISSING_QUOTATION_MARK, JsonParse(&v, "\"abc\"", 4));
+	ST_EXPECT_EQ_INT(RetType::PARSE_INVALID_STRING_ESCAPE, JsonParse(&v, "\"a\\n\"", 3));
+	ST_EXPECT_EQ_INT(RetType::PARSE_INVALID_UNICODE_HEX, JsonParse(&v, "\"\\u0041\"", 5));
+	ST_EXPECT_EQ_INT(RetType::PARSE_MISSING_COMMA_OR_SQUARE_BRACKET, JsonParse(&v, "[1]", 2));
+	/* NUL is an ordinary byte when the length is given */
+	ST_EXPECT_EQ_INT(RetType::PARSE_INVALID_STRING_CHAR, JsonParse(&v, "\"a\0b\"", 5));
+	ST_EXPECT_EQ_INT(RetType::PARSE_ROOT_NOT_SINGULAR, JsonParse(&v, "null\0", 5));
+	ST_EXPECT_EQ_INT(JsonType::JSON_NULL, GetType(&v));
+	/* where a value should start too, so every engine tells it from input that was cut off */
+	struct {
+		const char* _json;
+		size_t _length;
+		RetType _ret;
+	} nul[] = {
+		{ "[1,\0]", 5, RetType::PARSE_INVALID_VALUE }, { "{\"a\":\0}", 7, RetType::PARSE_INVALID_VALUE },
+		{ "\0", 1, RetType::PARSE_INVALID_VALUE }, { "nul\0", 4, RetType::PARSE_INVALID_VALUE },
+		{ "[1,", 3, RetType::PARSE_EXPECT_VALUE }, { "{\"a\":", 5, RetType::PARSE_EXPECT_VALUE }
+	};
+	const char* paths[] = { "/*/b", "/a/b" }; /* walks into every value, so none is skipped unchecked */
+	JsonPathSet set;
+	JsonProjection proj;
+	JsonLazyDocument lazy;
+	set.Init();
+	proj.Init();
+	lazy.Init();
+	JsonCompilePaths(&set, paths, 2);
+	for (size_t i = 0; i < sizeof(nul) / sizeof(nul[0]); ++i) {
+		ST_EXPECT_EQ_INT(nul[i]._ret, JsonParse(&v, nul[i]._json, nul[i]._length));
+		ST_EXPECT_EQ_INT(nul[i]._ret, JsonParseIndexed(&v, nul[i]._json, nul[i]._length, 1));
+		ST_EXPECT_EQ_INT(nul[i]._ret, JsonParseLazy(&lazy, nul[i]._json, nul[i]._length));
+		ST_EXPECT_EQ_INT(nul[i]._ret, JsonParseProjected(&proj, &set, nul[i]._json, nul[i]._length));
+		JsonPushParser parser;
+		parser.Init(&v);
+		parser.Feed(nul[i]._json, nul[i]._length);
+		ST_EXPECT_EQ_INT(JsonPushStatus::PUSH_ERROR, parser.Finish());
+		ST_EXPECT_EQ_INT(nul[i]._ret, parser._ret);
+		parser.Free();
+	}
+	lazy.Free();
+	proj.Free();
+	set.Free();
+
+	char json[] = "[\"a\\tb\"]xx";
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseInsitu(&v, json, 8));
+	ST_EXPECT_EQ_C_STR("a\tb", GetString(GetArrayElement(&v, 0)), GetStringSize(GetArrayElement(&v, 0)));
+	v.Free();
+}
+
+static void TestParseFile() {
+	const char* path = "st_json_test_file.json";
+	JsonValue v;
+	v.Init();
+	ST_EXPECT_EQ_INT(RetType::PARSE_FILE_ERROR, JsonParseFile(&v, "st_json_no_such_file.json"));
+	ST_EXPECT_EQ_INT(JsonType::JSON_NULL, GetType(&v));
+
+	FILE* f = fopen(path, "wb");
+	fclose(f);
+	ST_EXPECT_EQ_INT(RetType::PARSE_EXPECT_VALUE, JsonParseFile(&v, path));
+
+	/* exactly one page, so any read past the end of the mapping would fault */
+	string json = "[\"";
+	json.append(4096 - 4, 'x');
+	json += "\"]";
+	f = fopen(path, "wb");
+	fwrite(json.data(), 1, json.size(), f);
+	fclose(f);
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseFile(&v, path));
+	ST_EXPECT_EQ_SIZE_T(4092, GetStringSize(GetArrayElement(&v, 0)));
+	v.Free();
+
+	json.resize(json.size() - 1); /* "[\"xxx...\"" */
+	f = fopen(path, "wb");
+	fwrite(json.data(), 1, json.size(), f);
+	fclose(f);
+	ST_EXPECT_EQ_INT(RetType::PARSE_MISSING_COMMA_OR_SQUARE_BRACKET, JsonParseFile(&v, path));
+
+	JsonDocument doc;
+	doc.Init();
+	f = fopen(path, "wb");
+	fputs("{ \"k\" : [ true, \"v\" ] }", f);
+	fclose(f);
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseFile(&doc, path));
+	ST_EXPECT_EQ_C_STR("v", GetString(GetArrayElement(GetObjValue(&doc._root, 0), 1)), GetStringSize(GetArrayElement(GetObjValue(&doc._root, 0), 1)));
+	doc.Free();
+	remove(path);
+}
+
+/* writes one token per event, and stops once _stopAfter events were seen */
+struct TraceHandler {
+	string _trace;
+	size_t _events;
+	size_t _stopAfter;
+
+	bool Add(const string& token) {
+		_trace += token;
+		_trace += ' ';
+		return ++_events < _stopAfter;
+	}
+
+	bool Null() { return Add("null"); }
+	bool Bool(bool b) { return Add(b ? "true" : "false"); }
+	bool Number(double d) { return Add("n" + std::to_string(static_cast<int>(d))); }
+	bool String(const char* str, size_t size) { return Add("s:" + string(str, size)); }
+	bool StartObject() { return Add("{"); }
+	bool Key(const char* str, size_t size) { return Add("k:" + string(str, size)); }
+	bool EndObject(size_t memberCount) { return Add("}" + std::to_string(memberCount)); }
+	bool StartArray() { return Add("["); }
+	bool EndArray(size_t elementCount) { return Add("]" + std::to_string(elementCount)); }
+};
+
+static void TestParseSax() {
+	TraceHandler h = { "", 0, static_cast<size_t>(-1) };
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseSax(&h, " { \"a\" : [ 1, \"x\\ty\", null ], \"b\\u0041\" : { }, \"c\" : [ true, false, [ ] ] } "));
+	ST_EXPECT_TRUE(h._trace == "{ k:a [ n1 s:x\ty null ]3 k:bA { }0 k:c [ true false [ ]0 ]3 }3 ");
+
+	h = { "", 0, 4 };
+	ST_EXPECT_EQ_INT(RetType::PARSE_TERMINATED, JsonParseSax(&h, "[ [ 1, 2 ], 3 ]"));
+	ST_EXPECT_TRUE(h._trace == "[ [ n1 n2 ");
+
+	/* events up to the bad token have been delivered */
+	h = { "", 0, static_cast<size_t>(-1) };
+	ST_EXPECT_EQ_INT(RetType::PARSE_MISSING_COLON, JsonParseSax(&h, "[ 7, { \"k\" 1 } ]"));
+	ST_EXPECT_TRUE(h._trace == "[ n7 { k:k ");
+	h = { "", 0, static_cast<size_t>(-1) };
+	ST_EXPECT_EQ_INT(RetType::PARSE_ROOT_NOT_SINGULAR, JsonParseSax(&h, "1 2"));
+	ST_EXPECT_TRUE(h._trace == "n1 ");
+	h = { "", 0, static_cast<size_t>(-1) };
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseSax(&h, "[ 5, 6 ]xx", 8));
+	ST_EXPECT_TRUE(h._trace == "[ n5 n6 ]2 ");
+
+	char json[] = "{ \"k\\n\" : \"v\" }";
+	h = { "", 0, static_cast<size_t>(-1) };
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseSaxInsitu(&h, json));
+	ST_EXPECT_TRUE(h._trace == "{ k:k\n s:v }1 ");
+
+	/* the DOM builder cleans up the values of every container still open */
+	JsonValue v;
+	v.Init();
+	ST_EXPECT_EQ_INT(RetType::PARSE_INVALID_VALUE, JsonParse(&v, "{ \"a\" : [ \"x\", { \"b\" : [ \"y\", nul ] } ] }"));
+	ST_EXPECT_EQ_INT(JsonType::JSON_NULL, GetType(&v));
+	ST_EXPECT_EQ_INT(RetType::PARSE_ROOT_NOT_SINGULAR, JsonParse(&v, "[ \"x\" ] 1"));
+	ST_EXPECT_EQ_INT(JsonType::JSON_NULL, GetType(&v));
+}
+
+/* feeds json in chunks of every size and checks the outcome against JsonParse */
+static void TestPushSplits(const char* json) {
+	size_t length = strlen(json);
+	JsonValue expect;
+	expect.Init();
+	RetType expectRet = JsonParse(&expect, json, length);
+	size_t expectSize = 0;
+	char* expectJson  = expectRet == RetType::PARSE_OK ? JsonStringify(&expect, &expectSize) : nullptr;
+	for (size_t chunk = 1; chunk <= length; ++chunk) {
+		JsonValue v;
+		JsonPushParser parser;
+		parser.Init(&v);
+		JsonPushStatus status = JsonPushStatus::PUSH_NEED_MORE;
+		for (size_t i = 0; i < length && status != JsonPushStatus::PUSH_ERROR; i += chunk)
+			status = parser.Feed(json + i, chunk < length - i ? chunk : length - i);
+		if (status != JsonPushStatus::PUSH_ERROR)
+			status = parser.Finish();
+		ST_EXPECT_EQ_INT(expectRet, parser._ret);
+		if (expectRet == RetType::PARSE_OK) {
+			size_t size;
+			char* actual = JsonStringify(&v, &size);
+			ST_EXPECT_EQ_INT(JsonPushStatus::PUSH_DONE, status);
+			ST_EXPECT_TRUE(string(expectJson, expectSize) == string(actual, size));
+			free(actual);
+		}
+		else {
+			ST_EXPECT_EQ_INT(JsonPushStatus::PUSH_ERROR, status);
+			ST_EXPECT_EQ_INT(JsonType::JSON_NULL, GetType(&v));
+		}
+		parser.Free();
+		v.Free();
+	}
+	free(expectJson);
+	expect.Free();
+}
+
+static void TestPushParser() {
+	TestPushSplits(" [ null , false , true , 123 , \"abc\" , [ [ ] ] , { } ] ");
+	TestPushSplits("{\"k\\\"ey\":[-0.5e-3,1E+2,0,\"\\u20AC\\uD834\\uDD1E\\n\"],\"o\":{\"a\":{\"b\":[]}}}");
+	TestPushSplits("-12.5e3");
+	TestPushSplits("\"\"");
+	TestPushSplits("");
+	TestPushSplits("  ");
+	TestPushSplits("nul");
+	TestPushSplits("[tru]");
+	TestPushSplits("[1,]");
+	TestPushSplits("[1 2]");
+	TestPushSplits("{\"a\":1 \"b\":2}");
+	TestPushSplits("{\"a\" 1}");
+	TestPushSplits("{1:1}");
+	TestPushSplits("{\"a\":1,}");
+	TestPushSplits("[\"a\\x\"]");
+	TestPushSplits("[\"a\\u12\"]");
+	TestPushSplits("[\"\\uD800\\u0041\"]");
+	TestPushSplits("[\"a\tb\"]");
+	TestPushSplits("[\"abc");
+	TestPushSplits("[\"abc\\");
+	TestPushSplits("[0123]");
+	TestPushSplits("[1.]");
+	TestPushSplits("[-]");
+	TestPushSplits("[1e]");
+	TestPushSplits("1e309");
+	TestPushSplits("[1e309]");
+	TestPushSplits("[1] x");
+	TestPushSplits("1 2");
+	TestPushSplits("[[[1]]");
+
+	/* done as soon as the root closes; a bare number needs the end of the input */
+	JsonValue v;
+	JsonPushParser parser;
+	parser.Init(&v);
+	ST_EXPECT_EQ_INT(JsonPushStatus::PUSH_NEED_MORE, parser.Feed("[ \"ab", 5));
+	ST_EXPECT_EQ_INT(JsonPushStatus::PUSH_DONE, parser.Feed("c\" ] ", 5));
+	ST_EXPECT_EQ_C_STR("abc", GetString(GetArrayElement(&v, 0)), GetStringSize(GetArrayElement(&v, 0)));
+	ST_EXPECT_EQ_INT(JsonPushStatus::PUSH_DONE, parser.Feed("\n", 1));
+	ST_EXPECT_EQ_INT(JsonPushStatus::PUSH_ERROR, parser.Feed("x", 1));
+	ST_EXPECT_EQ_INT(RetType::PARSE_ROOT_NOT_SINGULAR, parser._ret);
+	ST_EXPECT_EQ_INT(JsonType::JSON_NULL, GetType(&v));
+	parser.Free();
+	parser.Init(&v);
+	ST_EXPECT_EQ_INT(JsonPushStatus::PUSH_NEED_MORE, parser.Feed("12", 2));
+	ST_EXPECT_EQ_INT(JsonPushStatus::PUSH_NEED_MORE, parser.Feed("34", 2));
+	ST_EXPECT_EQ_INT(JsonPushStatus::PUSH_DONE, parser.Finish());
+	ST_EXPECT_EQ_DOUBLE(1234.0, GetNumber(&v));
+	parser.Free();
+
+	JsonDocument doc;
+	doc.Init();
+	parser.Init(&doc);
+	ST_EXPECT_EQ_INT(JsonPushStatus::PUSH_NEED_MORE, parser.Feed("{ \"k\" : [ tr", 12));
+	ST_EXPECT_EQ_INT(JsonPushStatus::PUSH_DONE, parser.Feed("ue ] }", 6));
+	ST_EXPECT_EQ_INT(JsonType::JSON_TRUE, GetType(GetArrayElement(GetObjValue(&doc._root, 0), 0)));
+	parser.Free();
+	doc.Free();
+}
+
+/* line n holds {"id":n,...}, except every 500th which is blank and every 997th which is cut short */
+static string MakeLines(size_t count) {
+	string json;
+	for (size_t n = 1; n <= count; ++n) {
+		if (n % 500 == 0)
+			json += "  ";
+		else if (n % 997 == 0)
+			json += "{\"id\":" + std::to_string(n) + ",";
+		else
+			json += "{\"id\":" + std::to_string(n) + ",\"name\":\"user\\t" + std::to_string(n) + "\"}";
+		json += n % 3 == 0 ? "\r\n" : "\n";
+	}
+	return json;
+}
+
+struct LinesState {
+	size_t _lastLine, _good, _bad, _mismatches, _stopAt;
+};
+
+static bool CheckLine(JsonLine* line, void* user) {
+	LinesState* state = static_cast<LinesState*>(user);
+	size_t n          = line->_lineNumber;
+	if (n <= state->_lastLine || n % 500 == 0)
+		++state->_mismatches;
+	state->_lastLine = n;
+	if (n % 997 == 0) {
+		state->_bad += line->_ret == RetType::LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET ||
+		               line->_ret == RetType::PARSE_MISSING_KEY;
+		state->_mismatches += GetType(&line->_val) != JsonType::JSON_NULL;
+	}
+	else if (line->_ret == RetType::PARSE_OK && GetNumber(GetObjValue(&line->_val, 0)) == static_cast<double>(n))
+		++state->_good;
+	else
+		++state->_mismatches;
+	return n < state->_stopAt;
+}
+
+static void TestParseLines() {
+	const size_t count = 120000; /* several blocks */
+	string json        = MakeLines(count);
+	const size_t bad   = count / 997 - count / (997 * 500);
+	const size_t blank = count / 500;
+	for (size_t threads = 0; threads <= 4; threads += 2) {
+		LinesState state = { 0, 0, 0, 0, static_cast<size_t>(-1) };
+		ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseLines(json.data(), json.size(), threads, CheckLine, &state));
+		ST_EXPECT_EQ_SIZE_T(0, state._mismatches);
+		ST_EXPECT_EQ_SIZE_T(bad, state._bad);
+		ST_EXPECT_EQ_SIZE_T(count - bad - blank, state._good);
+		ST_EXPECT_EQ_SIZE_T(count - 1, state._lastLine); /* the last line is blank */
+	}
+
+	LinesState state = { 0, 0, 0, 0, 70001 };
+	ST_EXPECT_EQ_INT(RetType::PARSE_TERMINATED, JsonParseLines(json.data(), json.size(), 4, CheckLine, &state));
+	ST_EXPECT_EQ_SIZE_T(70001, state._lastLine);
+
+	/* no trailing newline, and a bad last line */
+	state = { 0, 0, 0, 0, static_cast<size_t>(-1) };
+	const char* small = "{\"id\":1}\n\n[ 1 2 ]";
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseLines(small, strlen(small), 1, CheckLine, &state));
+	ST_EXPECT_EQ_SIZE_T(1, state._good);
+	ST_EXPECT_EQ_SIZE_T(3, state._lastLine);
+	ST_EXPECT_EQ_SIZE_T(1, state._mismatches);
+
+	const char* path = "st_json_test_lines.json";
+	FILE* f          = fopen(path, "wb");
+	fwrite(json.data(), 1, json.size(), f);
+	fclose(f);
+	state = { 0, 0, 0, 0, static_cast<size_t>(-1) };
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseLinesFile(path, 0, CheckLine, &state));
+	ST_EXPECT_EQ_SIZE_T(count - bad - blank, state._good);
+	remove(path);
+	ST_EXPECT_EQ_INT(RetType::PARSE_FILE_ERROR, JsonParseLinesFile(path, 0, CheckLine, &state));
+}
+
+/* same result as JsonParse, checked through the error code and the stringified tree */
+static void TestIndexedSame(const char* json, size_t length, size_t threadCount) {
+	JsonValue expect, v;
+	expect.Init();
+	RetType expectRet = JsonParse(&expect, json, length);
+	ST_EXPECT_EQ_INT(expectRet, JsonParseIndexed(&v, json, length, threadCount));
+	if (expectRet == RetType::PARSE_OK) {
+		size_t expectSize, size;
+		char* expectJson = JsonStringify(&expect, &expectSize);
+		char* actual     = JsonStringify(&v, &size);
+		ST_EXPECT_TRUE(string(expectJson, expectSize) == string(actual, size));
+		free(expectJson);
+		free(actual);
+	}
+	else
+		ST_EXPECT_EQ_INT(JsonType::JSON_NULL, GetType(&v));
+	v.Free();
+	expect.Free();
+}
+
+static void TestParseIndexed() {
+	const char* inputs[] = {
+		" [ null , false , true , 123 , \"abc\" , [ [ ] ] , { } ] ",
+		"{\"k\\\"ey\":[-0.5e-3,1E+2,0,\"\\u20AC\\uD834\\uDD1E\\n\"],\"o\":{\"a\":{\"b\":[]}}}",
+		"[\"\\\\\",\"\\\\\\\"\",\"a\\\\\\\\\"]", "-12.5e3", "\"\"", "", "  ", "nul", "nullx", "[tru]", "[1,]",
+		"[1 2]", "[1x]", "{\"a\":1 \"b\":2}", "{\"a\" 1}", "{1:1}", "{\"a\":1,}", "[\"a\\x\"]", "[\"a\\u12\"]",
+		"[\"\\uD800\\u0041\"]", "[\"a\tb\"]", "[\"abc", "[\"abc\\", "[0123]", "[1.]", "[-]", "[1e309]", "[1] x",
+		"1 2", "[[[1]]", "[\"a\"\"b\"]", "{\"a\":\"b\"\"c\"}", "[1]]", "]"
+	};
+	for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+		TestIndexedSame(inputs[i], strlen(inputs[i]), 1);
+
+	/* big enough for several chunks; backslash runs and quotes land on every block and chunk offset */
+	string json = "[";
+	for (size_t n = 0; json.size() < 3 * 1024 * 1024; ++n) {
+		json += "{\"id\":" + std::to_string(n) + ",\"s\":\"" + string(n % 7, '\\') + string(n % 7, '\\');
+		json += n % 5 == 0 ? "\\\"]}\\\"" : "[,:{";
+		json += "\",\"t\":[true,null,-1.5e" + std::to_string(n % 20) + "]},";
+	}
+	json += "{}]";
+	TestIndexedSame(json.data(), json.size(), 1);
+	TestIndexedSame(json.data(), json.size(), 4);
+	json[json.size() / 2] = '"';
+	TestIndexedSame(json.data(), json.size(), 4);
+
+	JsonDocument doc;
+	doc.Init();
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseIndexed(&doc, "{\"a\":[\"b\",2]}", 13, 0));
+	ST_EXPECT_EQ_C_STR("b", GetString(GetArrayElement(GetObjValue(&doc._root, 0), 0)), 1);
+	ST_EXPECT_EQ_INT(RetType::PARSE_MISSING_COLON, JsonParseIndexed(&doc, "{\"a\" 1}", 7, 0));
+	ST_EXPECT_EQ_INT(JsonType::JSON_NULL, GetType(&doc._root));
+	doc.Free();
+}
+
+static void TestParseLazy() {
+	const char* json = " { \"id\" : 7, \"n\\u0061me\" : \"x\\ty\", \"tags\" : [ \"a\", [ 1, 2 ], { } ], \"big\" : 1e300 } ";
+	JsonLazyDocument doc;
+	doc.Init();
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseLazy(&doc, json, strlen(json)));
+	const JsonLazyValue* root = GetLazyRoot(&doc);
+	ST_EXPECT_EQ_INT(JsonType::JSON_OBJECT, GetLazyType(&doc, root));
+	ST_EXPECT_EQ_SIZE_T(4, GetLazyObjSize(&doc, root));
+
+	const JsonLazyValue* tags = FindLazyObjValue(&doc, root, "tags", 4);
+	ST_EXPECT_TRUE(tags == GetLazyObjValue(&doc, root, 2));
+	ST_EXPECT_EQ_SIZE_T(3, GetLazyArraySize(&doc, tags));
+	const JsonLazyValue* inner = GetLazyArrayElement(&doc, tags, 1);
+	ST_EXPECT_EQ_INT(JsonType::JSON_ARRAY, GetLazyType(&doc, inner));
+	ST_EXPECT_EQ_INT(JsonType::JSON_OBJECT, GetLazyType(&doc, GetLazyArrayElement(&doc, tags, 2)));
+	ST_EXPECT_EQ_INT(JsonType::JSON_STRING, GetLazyType(&doc, GetLazyArrayElement(&doc, tags, 0)));
+	ST_EXPECT_EQ_DOUBLE(2.0, GetNumber(GetLazyValue(&doc, GetLazyArrayElement(&doc, inner, 1))));
+	/* only what was asked for is decoded, and the escaped key passed on the way to "tags" */
+	ST_EXPECT_EQ_SIZE_T(2, doc._cacheCount);
+
+	/* escaped keys are matched by their text, decoded values are cached */
+	const JsonLazyValue* name = FindLazyObjValue(&doc, root, "name", 4);
+	ST_EXPECT_TRUE(name == GetLazyObjValue(&doc, root, 1));
+	ST_EXPECT_EQ_C_STR("name", GetString(GetLazyValue(&doc, GetLazyObjKey(&doc, root, 1))), 4);
+	ST_EXPECT_TRUE(FindLazyObjValue(&doc, root, "n\\u0061me", 9) == nullptr);
+	JsonValue* v = GetLazyValue(&doc, name);
+	ST_EXPECT_EQ_C_STR("x\ty", GetString(v), GetStringSize(v));
+	ST_EXPECT_TRUE(v == GetLazyValue(&doc, name));
+	ST_EXPECT_TRUE(FindLazyObjValue(&doc, root, "nam", 3) == nullptr);
+	ST_EXPECT_TRUE(FindLazyObjValue(&doc, root, "id", 2) == GetLazyObjValue(&doc, root, 0));
+	ST_EXPECT_EQ_DOUBLE(1e300, GetNumber(GetLazyValue(&doc, GetLazyObjValue(&doc, root, 3))));
+
+	/* a whole subtree decodes like JsonParse would */
+	JsonValue expect;
+	expect.Init();
+	JsonParse(&expect, json);
+	size_t expectSize, size;
+	char* expectJson = JsonStringify(&expect, &expectSize);
+	char* actual     = JsonStringify(GetLazyValue(&doc, root), &size);
+	ST_EXPECT_TRUE(string(expectJson, expectSize) == string(actual, size));
+	free(expectJson);
+	free(actual);
+	expect.Free();
+
+	/* errors are the ones JsonParse reports, found without decoding */
+	const char* bad[] = { "", "[1,]", "{\"a\" 1}", "{1:1}", "[\"a\\x\"]", "[1e309]", "-1e400", "[0123]", "[1] x", "[\"\\uD800\"]" };
+	for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+		JsonValue e;
+		ST_EXPECT_EQ_INT(JsonParse(&e, bad[i]), JsonParseLazy(&doc, bad[i], strlen(bad[i])));
+	}
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseLazy(&doc, "1e308", 5));
+	ST_EXPECT_EQ_DOUBLE(1e308, GetNumber(GetLazyValue(&doc, GetLazyRoot(&doc))));
+	doc.Free();
+}
+
+static string ProjectedMatch(const JsonProjection* proj, size_t index) {
+	size_t size;
+	char* json = JsonStringify(GetMatch(proj, index)->_val, &size);
+	string s(json, size);
+	free(json);
+	return s;
+}
+
+static void TestParseProjected() {
+	/* the skipped members span several blocks and hide brackets and quotes in strings */
+	string json = "{\"user\":{\"name\":\"x\",\"id\":7},\"skip\":[\"]]}\\\"[\"," + string(100, ' ') +
+		"{\"a\":[[],{}]},\"" + string(70, '{') + "\"],\"items\":[{\"price\":1,\"n\":[1]},{\"n\":2},{\"price\":\"3\"}],"
+		"\"a/b\":{\"~\":true},\"0\":null}";
+	const char* paths[] = { "/user/id", "/items/*/price", "/a~1b/~0", "/items", "/items/1", "/0", "/missing/x", "/user/id/x" };
+	JsonPathSet set;
+	JsonProjection proj;
+	set.Init();
+	proj.Init();
+	ST_EXPECT_TRUE(JsonCompilePaths(&set, paths, sizeof(paths) / sizeof(paths[0])));
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseProjected(&proj, &set, json.c_str(), json.size()));
+	/* in document order, a value before what is selected inside it */
+	size_t expectPath[]       = { 0, 3, 1, 4, 1, 2, 5 };
+	const char* expectValue[] = { "7", "[{\"price\":1,\"n\":[1]},{\"n\":2},{\"price\":\"3\"}]", "1", "{\"n\":2}", "\"3\"", "true", "null" };
+	ST_EXPECT_EQ_SIZE_T(7, GetMatchCount(&proj));
+	for (size_t i = 0; i < 7 && i < GetMatchCount(&proj); ++i) {
+		ST_EXPECT_EQ_SIZE_T(expectPath[i], GetMatch(&proj, i)->_path);
+		ST_EXPECT_TRUE(ProjectedMatch(&proj, i) == expectValue[i]);
+	}
+
+	/* the root, and a wildcard over the elements of the root */
+	const char* root[] = { "", "/*" };
+	ST_EXPECT_TRUE(JsonCompilePaths(&set, root, 2));
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseProjected(&proj, &set, " [1,{\"k\":\"v\"}] ", 15));
+	ST_EXPECT_EQ_SIZE_T(3, GetMatchCount(&proj));
+	ST_EXPECT_TRUE(ProjectedMatch(&proj, 0) == "[1,{\"k\":\"v\"}]");
+	ST_EXPECT_TRUE(ProjectedMatch(&proj, 2) == "{\"k\":\"v\"}");
+
+	/* errors on the way to a selected value are the ones JsonParse reports */
+	const char* one[] = { "/a/0" };
+	ST_EXPECT_TRUE(JsonCompilePaths(&set, one, 1));
+	const char* bad[] = { "", "{\"a\":[,]}", "{\"a\" 1}", "{1:1}", "{\"a\":[1e309]}", "{\"b\":[1]} x", "{\"a\":[\"\\x\"]}" };
+	for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+		JsonValue e;
+		ST_EXPECT_EQ_INT(JsonParse(&e, bad[i]), JsonParseProjected(&proj, &set, bad[i], strlen(bad[i])));
+		ST_EXPECT_EQ_SIZE_T(0, GetMatchCount(&proj));
+	}
+	/* skipped values are only delimited */
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseProjected(&proj, &set, "{\"b\":[1,],\"a\":[2]}", 18));
+	ST_EXPECT_EQ_SIZE_T(1, GetMatchCount(&proj));
+	/* and so is what follows the last element that can match */
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseProjected(&proj, &set, "{\"a\":[2,x],\"a\":{}}", 18));
+	ST_EXPECT_EQ_SIZE_T(1, GetMatchCount(&proj));
+	/* a repeated key is projected each time, with or without a wildcard beside it */
+	const char* dup = "{\"a\":[1],\"b\":2,\"a\":[3]}";
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseProjected(&proj, &set, dup, strlen(dup)));
+	ST_EXPECT_EQ_SIZE_T(2, GetMatchCount(&proj));
+	ST_EXPECT_TRUE(ProjectedMatch(&proj, 1) == "3");
+	const char* dupWild[] = { "/a/0", "/*" };
+	ST_EXPECT_TRUE(JsonCompilePaths(&set, dupWild, 2));
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseProjected(&proj, &set, dup, strlen(dup)));
+	ST_EXPECT_EQ_SIZE_T(5, GetMatchCount(&proj));
+	ST_EXPECT_TRUE(ProjectedMatch(&proj, 4) == "3");
+	ST_EXPECT_TRUE(JsonCompilePaths(&set, one, 1));
+	ST_EXPECT_EQ_INT(RetType::PARSE_MISSING_COMMA_OR_SQUARE_BRACKET, JsonParseProjected(&proj, &set, "{\"b\":[[1]", 9));
+	ST_EXPECT_EQ_INT(RetType::PARSE_MISSING_QUOTATION_MARK, JsonParseProjected(&proj, &set, "{\"b\":\"x\\\"}", 10));
+
+	const char* invalid[] = { "a/b" };
+	ST_EXPECT_FALSE(JsonCompilePaths(&set, invalid, 1));
+	invalid[0] = "/a~2";
+	ST_EXPECT_FALSE(JsonCompilePaths(&set, invalid, 1));
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseProjected(&proj, &set, "[1]", 3));
+	ST_EXPECT_EQ_SIZE_T(0, GetMatchCount(&proj));
+	set.Free();
+	proj.Free();
+}
+
+/* an object of width members "k0".."k<width-1>" whose last member repeats "k0" */
+static void TestFindObjWidth(size_t width) {
+	string json = "{";
+	for (size_t i = 0; i < width; ++i)
+		json += "\"k" + to_string(i) + "\":" + to_string(i) + ",";
+	json += "\"k0\":-1}";
+	JsonValue v;
+	JsonDocument doc;
+	v.Init();
+	doc.Init();
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&v, json.c_str()));
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&doc, json.c_str()));
+	const JsonValue* objects[] = { &v, &doc._root };
+	for (size_t o = 0; o < 2; ++o) {
+		for (size_t i = 0; i < width; ++i) {
+			string key = "k" + to_string(i);
+			ST_EXPECT_EQ_SIZE_T(i, FindObjIndex(objects[o], key.c_str(), key.size()));
+			ST_EXPECT_EQ_DOUBLE(static_cast<double>(i), GetNumber(FindObjValue(objects[o], key.c_str(), key.size())));
+		}
+		ST_EXPECT_EQ_SIZE_T(JSON_KEY_NOT_EXIST, FindObjIndex(objects[o], "k", 1));
+		ST_EXPECT_EQ_SIZE_T(JSON_KEY_NOT_EXIST, FindObjIndex(objects[o], "k00", 3));
+		ST_EXPECT_TRUE(FindObjValue(objects[o], "", 0) == nullptr);
+	}
+	v.Free();
+	doc.Free();
+}
+
+static void TestFindObj() {
+	JsonValue v;
+	v.Init();
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&v, "{\"a\":1,\"\":2,\"a\\u0000b\":3,\"ab\":4}"));
+	ST_EXPECT_EQ_SIZE_T(0, FindObjIndex(&v, "a", 1));
+	ST_EXPECT_EQ_SIZE_T(1, FindObjIndex(&v, "", 0));
+	ST_EXPECT_EQ_SIZE_T(2, FindObjIndex(&v, "a\0b", 3));
+	ST_EXPECT_EQ_SIZE_T(3, FindObjIndex(&v, "ab", 2));
+	ST_EXPECT_EQ_SIZE_T(JSON_KEY_NOT_EXIST, FindObjIndex(&v, "b", 1));
+	v.Free();
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&v, "{}"));
+	ST_EXPECT_TRUE(FindObjValue(&v, "a", 1) == nullptr);
+	v.Free();
+
+	/* scanned, indexed on the first lookup, and indexed while parsing */
+	TestFindObjWidth(3);
+	TestFindObjWidth(JSON_OBJ_INDEX_MIN_SIZE);
+	TestFindObjWidth(JSON_OBJ_INDEX_EAGER_SIZE - 2);
+	TestFindObjWidth(JSON_OBJ_INDEX_EAGER_SIZE);
+	TestFindObjWidth(5000);
+}
+
+static void TestKeyIntern() {
+	const char* json = "[ {\"id\":1,\"name\":\"a\"}, {\"id\":2,\"n\\u0061me\":\"b\"}, {\"name\":\"c\",\"id\":3,\"x\":{\"id\":4}} ]";
+	JsonDocument doc;
+	JsonKeyStats stats;
+	doc.Init();
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&doc, json));
+	GetKeyStats(&doc, &stats);
+	ST_EXPECT_EQ_SIZE_T(8, stats._lookups);
+	ST_EXPECT_EQ_SIZE_T(5, stats._hits);
+	ST_EXPECT_EQ_SIZE_T(3, stats._distinct);
+	ST_EXPECT_EQ_DOUBLE(5.0 / 8.0, stats._hitRate);
+
+	/* one copy per distinct key, escaped or not, at any depth */
+	const char* id   = FindDocumentKey(&doc, "id", 2);
+	const char* name = FindDocumentKey(&doc, "name", 4);
+	ST_EXPECT_EQ_C_STR("id", id, 2);
+	ST_EXPECT_TRUE(GetObjKey(GetArrayElement(&doc._root, 0), 0) == id);
+	ST_EXPECT_TRUE(GetObjKey(GetArrayElement(&doc._root, 1), 0) == id);
+	ST_EXPECT_TRUE(GetObjKey(GetArrayElement(&doc._root, 2), 1) == id);
+	ST_EXPECT_TRUE(GetObjKey(GetObjValue(GetArrayElement(&doc._root, 2), 2), 0) == id);
+	ST_EXPECT_TRUE(GetObjKey(GetArrayElement(&doc._root, 0), 1) == name);
+	ST_EXPECT_TRUE(GetObjKey(GetArrayElement(&doc._root, 1), 1) == name);
+	ST_EXPECT_TRUE(GetObjKey(GetArrayElement(&doc._root, 2), 0) == name);
+	ST_EXPECT_TRUE(FindDocumentKey(&doc, "i", 1) == nullptr);
+
+	/* every way of parsing into a document interns, and a new parse starts over */
+	char insitu[] = "[{\"k\":1},{\"k\":2}]";
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseInsitu(&doc, insitu));
+	ST_EXPECT_TRUE(FindDocumentKey(&doc, "id", 2) == nullptr);
+	ST_EXPECT_TRUE(FindDocumentKey(&doc, "k", 1) == insitu + 3);
+	ST_EXPECT_TRUE(GetObjKey(GetArrayElement(&doc._root, 1), 0) == insitu + 3);
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseIndexed(&doc, json, strlen(json), 1));
+	GetKeyStats(&doc, &stats);
+	ST_EXPECT_EQ_SIZE_T(5, stats._hits);
+	ST_EXPECT_TRUE(GetObjKey(GetArrayElement(&doc._root, 2), 1) == FindDocumentKey(&doc, "id", 2));
+	JsonPushParser parser;
+	parser.Init(&doc);
+	for (const char* p = json; *p; ++p)
+		parser.Feed(p, 1);
+	ST_EXPECT_EQ_INT(JsonPushStatus::PUSH_DONE, parser.Finish());
+	parser.Free();
+	GetKeyStats(&doc, &stats);
+	ST_EXPECT_EQ_SIZE_T(5, stats._hits);
+	ST_EXPECT_TRUE(GetObjKey(GetArrayElement(&doc._root, 1), 1) == FindDocumentKey(&doc, "name", 4));
+
+	/* past the table limit keys are copied, and still compare by content */
+	string many = "{";
+	for (size_t i = 0; i < JSON_KEY_TABLE_MAX_SIZE + 10; ++i)
+		many += "\"" + to_string(i) + "\":0,";
+	many += "\"0\":1}";
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&doc, many.c_str()));
+	GetKeyStats(&doc, &stats);
+	ST_EXPECT_EQ_SIZE_T(JSON_KEY_TABLE_MAX_SIZE, stats._distinct);
+	ST_EXPECT_EQ_SIZE_T(1, stats._hits);
+	string last = to_string(JSON_KEY_TABLE_MAX_SIZE + 9);
+	ST_EXPECT_TRUE(FindDocumentKey(&doc, last.c_str(), last.size()) == nullptr);
+	ST_EXPECT_EQ_SIZE_T(JSON_KEY_TABLE_MAX_SIZE + 9, FindObjIndex(&doc._root, last.c_str(), last.size()));
+	doc.Free();
+
+	/* a tree of its own has no document to share keys through */
+	JsonValue v;
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&v, json));
+	ST_EXPECT_TRUE(GetObjKey(GetArrayElement(&v, 0), 0) != GetObjKey(GetArrayElement(&v, 1), 0));
+	v.Free();
+}
+
+static void TestShortString() {
+	ST_EXPECT_EQ_SIZE_T(16, sizeof(JsonValue));
+
+	/* around the longest string a value holds itself, parsed, set and copied */
+	const char* text = "0123456789abcdefg";
+	for (size_t size = 0; size <= 17; ++size) {
+		string json = "[\"" + string(text, size) + "\",{\"" + string(text, size) + "\":\"" + string(text, size) + "\"}]";
+		JsonValue v;
+		JsonDocument doc;
+		v.Init();
+		doc.Init();
+		ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&v, json.c_str()));
+		ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&doc, json.c_str()));
+		const JsonValue* roots[] = { &v, &doc._root };
+		for (size_t r = 0; r < 2; ++r) {
+			const JsonValue* e = GetArrayElement(roots[r], 0);
+			ST_EXPECT_TRUE(string(text, size) == string(GetString(e), GetStringSize(e)));
+			ST_EXPECT_EQ_INT('\0', GetString(e)[size]);
+			ST_EXPECT_TRUE(string(text, size) == GetObjKey(GetArrayElement(roots[r], 1), 0));
+			ST_EXPECT_TRUE(string(text, size) == GetString(GetObjValue(GetArrayElement(roots[r], 1), 0)));
+		}
+		JsonValue copy = *GetArrayElement(&v, 0);
+		ST_EXPECT_TRUE(string(text, size) == string(GetString(&copy), GetStringSize(&copy)));
+		size_t length;
+		char* out = JsonStringify(&v, &length);
+		ST_EXPECT_TRUE(json == string(out, length));
+		free(out);
+		SetString(GetArrayElement(&v, 0), text, 17 - size);
+		ST_EXPECT_TRUE(string(text, 17 - size) == string(GetString(GetArrayElement(&v, 0)), GetStringSize(GetArrayElement(&v, 0))));
+		v.Free();
+		doc.Free();
+	}
+}
+
+#define TEST_ROUNDTRIP(json) \
+	do { \
+		JsonValue v; \
+		size_t length; \
+		v.Init(); \
+		ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&v, json)); \
+		char* json2 = JsonStringify(&v, &length); \
+		ST_EXPECT_EQ_C_STR(json, json2, length); \
+		free(json2); \
+		v.Free(); \
+	}while(0)
+
+static bool AppendSink(const char* data, size_t size, void* user) {
+	static_cast<string*>(user)->append(data, size);
+	return true;
+}
+
+static bool FailingSink(const char*, size_t, void*) {
+	return false;
+}
+
+static string StringifyString(const JsonValue* v) {
+	size_t length;
+	char* json = JsonStringify(v, &length);
+	string s(json, length);
+	free(json);
+	return s;
+}
+
+static void TestWriter() {
+	/* whole trees come out as JsonStringify has them, strings longer than the buffer included */
+	string big = "[\"";
+	for (size_t i = 0; i < JSON_WRITER_BUFFER_SIZE / 2; ++i)
+		big += i % 7 ? "ab" : "\\n\\u0001";
+	big += "\", {\"k\\\"ey\": [1.5, -0, 1e300, true, false, null, {}, []]}]";
+	const char* inputs[] = { "null", "\"\"", "[]", "{\"a\":{\"b\":[1,2,{\"c\":\"\\u0000\"}]}}", big.c_str() };
+	for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i) {
+		JsonValue v;
+		JsonWriter writer;
+		string out;
+		ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&v, inputs[i]));
+		writer.Init(AppendSink, &out);
+		ST_EXPECT_TRUE(writer.Value(&v));
+		ST_EXPECT_TRUE(writer.Flush());
+		ST_EXPECT_TRUE(StringifyString(&v) == out);
+		ST_EXPECT_EQ_SIZE_T(out.size(), writer._written);
+		writer.Free();
+		v.Free();
+	}
+
+	/* built call by call, subtrees in between, top-level values on lines of their own */
+	JsonValue sub;
+	JsonParse(&sub, "{\"x\":[true]}");
+	string out;
+	JsonWriter writer;
+	writer.Init(AppendSink, &out);
+	writer.StartObject();
+	writer.Key("id", 2);
+	writer.Number(7);
+	writer.Key("tags", 4);
+	writer.StartArray();
+	writer.String("a\"b", 3);
+	writer.Value(&sub);
+	writer.Null();
+	writer.EndArray();
+	writer.Key("empty", 5);
+	writer.StartObject();
+	writer.EndObject();
+	writer.EndObject();
+	writer.Bool(false);
+	writer.Flush();
+	ST_EXPECT_TRUE(out == "{\"id\":7,\"tags\":[\"a\\\"b\",{\"x\":[true]},null],\"empty\":{}}\nfalse");
+	writer.Free();
+	sub.Free();
+
+	/* as a reader handler it minifies */
+	out.clear();
+	writer.Init(AppendSink, &out);
+	const char* pretty = " { \"a\" : [ 1 , \"x\\ty\" ] ,\n \"b\" : { } } ";
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseSax(&writer, pretty, strlen(pretty)));
+	writer.Flush();
+	ST_EXPECT_TRUE(out == "{\"a\":[1,\"x\\ty\"],\"b\":{}}");
+	writer.Free();
+
+	/* to a FILE* and to a descriptor */
+	FILE* file = tmpfile();
+	if (file) {
+		writer.Init(file);
+		writer.StartArray();
+		writer.Number(1);
+		writer.EndArray();
+		writer.Flush();
+		writer.Free();
+		fflush(file);
+		writer.Init(fileno(file));
+		writer.String("fd", 2);
+		writer.Flush();
+		writer.Free();
+		char read[16] = { 0 };
+		rewind(file);
+		ST_EXPECT_EQ_SIZE_T(7, fread(read, 1, sizeof(read), file));
+		ST_EXPECT_EQ_C_STR("[1]\"fd\"", read, 7);
+		fclose(file);
+	}
+
+	/* a failed sink fails every later call */
+	writer.Init(FailingSink, nullptr);
+	ST_EXPECT_TRUE(writer.StartArray());
+	ST_EXPECT_FALSE(writer.Flush());
+	ST_EXPECT_FALSE(writer.Number(1));
+	ST_EXPECT_FALSE(writer.EndArray());
+	writer.Free();
+}
+
+static void TestAccessArray() {
+	JsonValue a, e;
+	a.Init();
+	e.Init();
+	for (size_t capacity = 0; capacity <= 5; capacity += 5) {
+		SetArray(&a, capacity);
+		ST_EXPECT_EQ_SIZE_T(0, GetArraySize(&a));
+		ST_EXPECT_EQ_SIZE_T(capacity, GetArrayCapacity(&a));
+		for (size_t i = 0; i < 10; ++i)
+			SetNumber(PushBackArrayElement(&a), static_cast<double>(i));
+		ST_EXPECT_EQ_SIZE_T(10, GetArraySize(&a));
+		ST_EXPECT_TRUE(GetArrayCapacity(&a) >= 10);
+		ST_EXPECT_TRUE(StringifyString(&a) == "[0,1,2,3,4,5,6,7,8,9]");
+
+		PopBackArrayElement(&a);
+		EraseArrayElement(&a, 4, 0);
+		EraseArrayElement(&a, 8, 1);
+		EraseArrayElement(&a, 0, 2);
+		SetString(InsertArrayElement(&a, 0), "a string longer than a short one", 32);
+		SetNumber(InsertArrayElement(&a, 6), 7.5);
+		ST_EXPECT_TRUE(StringifyString(&a) == "[\"a string longer than a short one\",2,3,4,5,6,7.5,7]");
+
+		ReserveArray(&a, 100);
+		ST_EXPECT_EQ_SIZE_T(100, GetArrayCapacity(&a));
+		ShrinkArray(&a);
+		ST_EXPECT_EQ_SIZE_T(8, GetArrayCapacity(&a));
+		ClearArray(&a);
+		ST_EXPECT_EQ_SIZE_T(0, GetArraySize(&a));
+		ST_EXPECT_EQ_SIZE_T(8, GetArrayCapacity(&a));
+		ShrinkArray(&a);
+		ST_EXPECT_EQ_SIZE_T(0, GetArrayCapacity(&a));
+	}
+
+	/* a value moves in without a copy and the source is left null */
+	SetString(&e, "moved in as it is, pointer and all", 34);
+	const char* str = GetString(&e);
+	JsonMove(PushBackArrayElement(&a), &e);
+	ST_EXPECT_EQ_INT(JsonType::JSON_NULL, GetType(&e));
+	ST_EXPECT_TRUE(GetString(GetArrayElement(&a, 0)) == str);
+	a.Free();
+
+	/* parsed arrays grow out of the heap or the document arena they were built in */
+	JsonDocument doc;
+	doc.Init();
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&a, "[\"a string longer than a short one\",[1]]"));
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&doc, "[\"a string longer than a short one\",[1]]"));
+	JsonValue* roots[] = { &a, &doc._root };
+	for (size_t r = 0; r < 2; ++r) {
+		ST_EXPECT_EQ_SIZE_T(2, GetArrayCapacity(roots[r]));
+		SetBoolean(PushBackArrayElement(GetArrayElement(roots[r], 1)), true);
+		EraseArrayElement(roots[r], 0, 1);
+		ST_EXPECT_EQ_INT(JsonType::JSON_NULL, GetType(InsertArrayElement(roots[r], 1)));
+		ST_EXPECT_TRUE(StringifyString(roots[r]) == "[[1,true],null]");
+	}
+	doc._root.Free();
+	doc.Free();
+	a.Free();
+}
+
+static void TestAccessObject() {
+	JsonValue o;
+	o.Init();
+	SetObject(&o, 2);
+	ST_EXPECT_EQ_SIZE_T(2, GetObjCapacity(&o));
+	SetNumber(SetObjectValue(&o, "a", 1), 1.0);
+	SetString(SetObjectValue(&o, "b", 1), "x", 1);
+	SetNumber(SetObjectValue(&o, "a", 1), 2.0);
+	SetArray(SetObjectValue(&o, "a\0b", 3), 0);
+	ST_EXPECT_TRUE(StringifyString(&o) == "{\"a\":2,\"b\":\"x\",\"a\\u0000b\":[]}");
+	RemoveObjectValue(&o, 0);
+	ST_EXPECT_EQ_SIZE_T(JSON_KEY_NOT_EXIST, FindObjIndex(&o, "a", 1));
+	ST_EXPECT_EQ_SIZE_T(1, FindObjIndex(&o, "a\0b", 3));
+	ShrinkObj(&o);
+	ST_EXPECT_EQ_SIZE_T(2, GetObjCapacity(&o));
+	ClearObj(&o);
+	ST_EXPECT_EQ_SIZE_T(0, GetObjSize(&o));
+
+	/* lookups stay right through the hash index as it is kept up, dropped and rebuilt */
+	for (size_t round = 0; round < 2; ++round) {
+		for (size_t i = 0; i < 300; ++i) {
+			string key = "k" + to_string(i);
+			SetNumber(SetObjectValue(&o, key.c_str(), key.size()), static_cast<double>(i));
+			if (i % 7 == 0)
+				ST_EXPECT_EQ_SIZE_T(i / 2, FindObjIndex(&o, ("k" + to_string(i / 2)).c_str(), ("k" + to_string(i / 2)).size()));
+		}
+		ST_EXPECT_EQ_SIZE_T(300, GetObjSize(&o));
+		for (size_t i = 0; i < 300; i += 2)
+			RemoveObjectValue(&o, FindObjIndex(&o, ("k" + to_string(i)).c_str(), ("k" + to_string(i)).size()));
+		for (size_t i = 0; i < 300; ++i) {
+			string key = "k" + to_string(i);
+			JsonValue* v = FindObjValue(&o, key.c_str(), key.size());
+			ST_EXPECT_TRUE(i % 2
+				               ? v && GetNumber(v) == static_cast<double>(i)
+				               : v == nullptr);
+		}
+		ClearObj(&o);
+	}
+	o.Free();
+
+	JsonDocument doc;
+	doc.Init();
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&doc, "{\"a\":1,\"b\":{}}"));
+	RemoveObjectValue(&doc._root, 0);
+	SetString(SetObjectValue(GetObjValue(&doc._root, 0), "c", 1), "a string longer than a short one", 32);
+	SetNumber(SetObjectValue(&doc._root, "d", 1), 4.0);
+	ST_EXPECT_TRUE(StringifyString(&doc._root) == "{\"b\":{\"c\":\"a string longer than a short one\"},\"d\":4}");
+	doc._root.Free();
+	doc.Free();
+}
+
+static void TestValue() {
+	const char* json = "{\"name\":\"a string longer than a short one\",\"list\":[1,[2,3],{\"k\":null}]}";
+	Value a;
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, a.Parse(json));
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, a.Parse(json));
+
+	/* a copy is equal and shares nothing */
+	Value b = a.DeepCopy();
+	ST_EXPECT_TRUE(StringifyString(b.Get()) == json);
+	ST_EXPECT_TRUE(GetString(GetObjValue(b.Get(), 0)) != GetString(GetObjValue(a.Get(), 0)));
+	SetNumber(GetArrayElement(GetObjValue(b.Get(), 1), 0), 5.0);
+	ST_EXPECT_TRUE(StringifyString(a.Get()) == json);
+
+	/* moving and swapping hand the tree over as it is */
+	const char* name = GetString(GetObjValue(a.Get(), 0));
+	Value c(std::move(a));
+	ST_EXPECT_EQ_INT(JsonType::JSON_NULL, GetType(a.Get()));
+	ST_EXPECT_TRUE(GetString(GetObjValue(c.Get(), 0)) == name);
+	a = std::move(c);
+	ST_EXPECT_TRUE(GetString(GetObjValue(a.Get(), 0)) == name);
+	a.Swap(b);
+	ST_EXPECT_TRUE(GetString(GetObjValue(b.Get(), 0)) == name);
+	ST_EXPECT_EQ_DOUBLE(5.0, GetNumber(GetArrayElement(GetObjValue(a.Get(), 1), 0)));
+
+	/* a subtree moves from one tree to another without a copy */
+	JsonValue* list = GetObjValue(b.Get(), 1);
+	JsonValue* inner = GetArrayElement(list, 1);
+	const JsonValue* elements = GetArrayElement(inner, 0);
+	Value sub;
+	sub.Take(inner);
+	ST_EXPECT_EQ_INT(JsonType::JSON_NULL, GetType(inner));
+	sub.Give(PushBackArrayElement(GetObjValue(a.Get(), 1)));
+	ST_EXPECT_TRUE(GetArrayElement(GetArrayElement(GetObjValue(a.Get(), 1), 3), 0) == elements);
+	ST_EXPECT_TRUE(StringifyString(a.Get()) == "{\"name\":\"a string longer than a short one\",\"list\":[5,[2,3],{\"k\":null},[2,3]]}");
+	ST_EXPECT_TRUE(StringifyString(b.Get()) == "{\"name\":\"a string longer than a short one\",\"list\":[1,null,{\"k\":null}]}");
+
+	/* the C-style calls the handles are made of */
+	JsonValue v, w;
+	JsonInit(&v);
+	JsonInit(&w);
+	JsonCopy(&v, a.Get());
+	JsonCopy(&v, GetObjValue(&v, 1));
+	ST_EXPECT_TRUE(StringifyString(&v) == "[5,[2,3],{\"k\":null},[2,3]]");
+	JsonSwap(&v, &w);
+	ST_EXPECT_EQ_INT(JsonType::JSON_NULL, GetType(&v));
+	JsonFree(&w);
+	ST_EXPECT_EQ_INT(JsonType::JSON_NULL, GetType(&w));
+}
+
+static void TestDocument() {
+	const char* json = "[{\"id\":1,\"tag\":\"a string longer than a short one\"},{\"id\":2,\"tag\":\"b\"}]";
+	Document a;
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, a.Parse(json));
+	SetString(SetObjectValue(GetArrayElement(a.Root(), 1), "extra", 5), "set on the heap after parsing", 29);
+
+	/* the copy has an arena of its own, where keys are shared again */
+	Document b = a.DeepCopy();
+	ST_EXPECT_TRUE(StringifyString(b.Root()) == StringifyString(a.Root()));
+	ST_EXPECT_TRUE(GetObjKey(GetArrayElement(b.Root(), 0), 0) == GetObjKey(GetArrayElement(b.Root(), 1), 0));
+	ST_EXPECT_TRUE(GetObjKey(GetArrayElement(b.Root(), 0), 0) == FindDocumentKey(b.Get(), "id", 2));
+	ST_EXPECT_TRUE(GetObjKey(GetArrayElement(b.Root(), 0), 0) != GetObjKey(GetArrayElement(a.Root(), 0), 0));
+
+	/* a document moves with its arena, and what was moved from is empty */
+	const JsonValue* first = GetArrayElement(a.Root(), 0);
+	Document c(std::move(a));
+	ST_EXPECT_TRUE(GetArrayElement(c.Root(), 0) == first);
+	ST_EXPECT_EQ_INT(JsonType::JSON_NULL, GetType(a.Root()));
+	a = std::move(b);
+	b.Swap(c);
+	ST_EXPECT_TRUE(GetArrayElement(b.Root(), 0) == first);
+	ST_EXPECT_TRUE(StringifyString(a.Root()) == StringifyString(b.Root()));
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, b.Parse("[]"));
+	ST_EXPECT_EQ_SIZE_T(0, GetArraySize(b.Root()));
+}
+
+struct BindTag {
+	string name;
+	JsonOptional<double> weight;
+};
+ST_JSON_BIND(BindTag, name, weight)
+
+struct BindRecord {
+	int id;
+	unsigned char level;
+	bool active;
+	double score;
+	vector<BindTag> tags;
+	vector<vector<int>> grid;
+	JsonOptional<BindTag> owner;
+	JsonOptional<vector<bool>> flags;
+};
+ST_JSON_BIND(BindRecord, id, level, active, score, tags, grid, owner, flags)
+
+static string WriteBoundString(const BindRecord& record) {
+	string out;
+	JsonWriter writer;
+	writer.Init(AppendSink, &out);
+	JsonWriteBound(&writer, record);
+	writer.Flush();
+	writer.Free();
+	return out;
+}
+
+static void TestBind() {
+	/* members in any order, unknown keys skipped whatever they hold, escaped keys matched */
+	const char* json = " { \"grid\" : [[1,2],[],[3]], \"tags\":[{\"name\":\"a\\tb\",\"weight\":0.5},{\"name\":\"c\",\"weight\":null}],"
+	                   "\"skip\":{\"x\":[1,{\"y\":\"\\u00e9\"}]},\"id\":-7,\"\\u006cevel\":200,\"active\":true,\"score\":1e2,"
+	                   "\"flags\":[true,false] } ";
+	BindRecord r;
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseBound(&r, json));
+	ST_EXPECT_EQ_INT(-7, r.id);
+	ST_EXPECT_EQ_INT(200, r.level);
+	ST_EXPECT_TRUE(r.active);
+	ST_EXPECT_EQ_DOUBLE(100.0, r.score);
+	ST_EXPECT_EQ_SIZE_T(2, r.tags.size());
+	ST_EXPECT_TRUE(r.tags[0].name == "a\tb");
+	ST_EXPECT_TRUE(r.tags[0].weight._has);
+	ST_EXPECT_EQ_DOUBLE(0.5, r.tags[0].weight._value);
+	ST_EXPECT_FALSE(r.tags[1].weight._has);
+	ST_EXPECT_EQ_SIZE_T(3, r.grid.size());
+	ST_EXPECT_EQ_SIZE_T(0, r.grid[1].size());
+	ST_EXPECT_EQ_INT(3, r.grid[2][0]);
+	ST_EXPECT_FALSE(r.owner._has);
+	ST_EXPECT_TRUE(r.flags._has);
+	ST_EXPECT_TRUE(r.flags._value[0] && !r.flags._value[1]);
+
+	/* written back in declaration order, optional members without a value left out */
+	const char* written = "{\"id\":-7,\"level\":200,\"active\":true,\"score\":100,\"tags\":[{\"name\":\"a\\tb\",\"weight\":0.5},"
+	                      "{\"name\":\"c\"}],\"grid\":[[1,2],[],[3]],\"flags\":[true,false]}";
+	ST_EXPECT_TRUE(WriteBoundString(r) == written);
+	r.owner._has         = true;
+	r.owner._value.name  = "o";
+	r.tags[1].weight._has = true;
+	BindRecord back;
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseBound(&back, WriteBoundString(r).c_str()));
+	ST_EXPECT_TRUE(WriteBoundString(back) == WriteBoundString(r));
+	ST_EXPECT_TRUE(back.owner._has && back.owner._value.name == "o");
+
+	/* what does not fit the struct */
+	const char* base = "\"level\":1,\"active\":false,\"score\":0,\"tags\":[],\"grid\":[]";
+	struct {
+		RetType _ret;
+		string _json;
+	} cases[] = {
+		{ RetType::PARSE_OK, string("{\"id\":1,") + base + "}" },
+		{ RetType::PARSE_MISSING_FIELD, string("{") + base + "}" },
+		{ RetType::PARSE_MISSING_FIELD, string("{\"id\":1,") + base + ",\"tags\":[{}]}" },
+		{ RetType::PARSE_TYPE_MISMATCH, string("{\"id\":\"1\",") + base + "}" },
+		{ RetType::PARSE_TYPE_MISMATCH, string("{\"id\":1.5,") + base + "}" },
+		{ RetType::PARSE_TYPE_MISMATCH, string("{\"id\":3e9,") + base + "}" },
+		{ RetType::PARSE_TYPE_MISMATCH, string("{\"id\":1,") + base + ",\"level\":256}" },
+		{ RetType::PARSE_TYPE_MISMATCH, string("{\"id\":1,") + base + ",\"active\":null}" },
+		{ RetType::PARSE_TYPE_MISMATCH, string("{\"id\":1,") + base + ",\"grid\":[[1],{}]}" },
+		{ RetType::PARSE_TYPE_MISMATCH, "[]" },
+		{ RetType::PARSE_MISSING_KEY, string("{\"id\":1,") + base + ",\"grid\":[[1],{x}]}" },
+		{ RetType::PARSE_INVALID_VALUE, string("{\"id\":tru,") + base + "}" },
+		{ RetType::PARSE_MISSING_QUOTATION_MARK, string("{\"id\":1,") + base + ",\"owner\":{\"name\":\"o}" },
+		{ RetType::PARSE_MISSING_COLON, string("{\"id\" 1,") + base + "}" },
+		{ RetType::PARSE_MISSING_KEY, string("{\"id\":1,") + base + ",}" },
+		{ RetType::LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, string("{\"id\":1,") + base },
+		{ RetType::PARSE_MISSING_COMMA_OR_SQUARE_BRACKET, string("{\"id\":1,") + base + ",\"grid\":[[1}" },
+		{ RetType::PARSE_ROOT_NOT_SINGULAR, string("{\"id\":1,") + base + "} x" },
+		{ RetType::PARSE_EXPECT_VALUE, " " },
+	};
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		BindRecord bad;
+		ST_EXPECT_EQ_INT(cases[i]._ret, JsonParseBound(&bad, cases[i]._json.c_str(), cases[i]._json.size()));
+	}
+
+	/* the other bound types work at the root too */
+	vector<string> strings;
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseBound(&strings, "[\"x\", \"\\\"y\\\"\"]"));
+	ST_EXPECT_TRUE(strings.size() == 2 && strings[1] == "\"y\"");
+	long long wide = 0;
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseBound(&wide, "-9007199254740992"));
+	ST_EXPECT_TRUE(wide == -9007199254740992LL);
+}
+
+static string BinaryString(const char* data, size_t size) {
+	return string(data, size);
+}
+
+/* through both formats and back, into a value and into a document, the text stays the same */
+static void TestBinaryRoundTrip(const string& json) {
+	JsonValue v;
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&v, json.c_str(), json.size()));
+	string text = StringifyString(&v);
+	for (int format = 0; format < 2; ++format) {
+		size_t size;
+		char* data = format
+			             ? JsonEncodeMsgPack(&v, &size)
+			             : JsonEncodeCbor(&v, &size);
+		JsonValue back;
+		JsonDocument doc;
+		doc.Init();
+		ST_EXPECT_EQ_INT(RetType::PARSE_OK, format ? JsonDecodeMsgPack(&back, data, size) : JsonDecodeCbor(&back, data, size));
+		ST_EXPECT_EQ_INT(RetType::PARSE_OK, format ? JsonDecodeMsgPack(&doc, data, size) : JsonDecodeCbor(&doc, data, size));
+		ST_EXPECT_TRUE(StringifyString(&back) == text);
+		ST_EXPECT_TRUE(StringifyString(&doc._root) == text);
+		/* every proper prefix ends inside an item */
+		for (size_t cut = 0; cut < size && cut < 64; ++cut) {
+			JsonValue part;
+			ST_EXPECT_EQ_INT(RetType::PARSE_INVALID_BINARY, format ? JsonDecodeMsgPack(&part, data, cut) : JsonDecodeCbor(&part, data, cut));
+			ST_EXPECT_EQ_INT(JsonType::JSON_NULL, GetType(&part));
+		}
+		back.Free();
+		doc.Free();
+		free(data);
+	}
+	v.Free();
+}
+
+static void TestBinary() {
+	TestBinaryRoundTrip("null");
+	TestBinaryRoundTrip("[true,false,null,\"\",\"short\",\"a string longer than a short one\"]");
+	TestBinaryRoundTrip("[0,-0,1,-1,23,24,-24,-25,127,128,-32,-33,255,256,-128,-129,65535,65536,-32768,-32769]");
+	TestBinaryRoundTrip("[4294967295,4294967296,-2147483648,-2147483649,9007199254740993,-9223372036854775808,"
+	                    "18446744073709549568,18446744073709551616,-9223372036854777856]");
+	TestBinaryRoundTrip("[1.5,0.1,-2.25e-300,1e300,3.4028234663852886e38,1.401298464324817e-45]");
+	TestBinaryRoundTrip("{\"a\":{\"b\":[{},[],{\"\":\"\\u0000\"}]},\"\\u00e9\":1}");
+	string wide = "{";
+	for (size_t i = 0; i < 200; ++i)
+		wide += (i ? ",\"k" : "\"k") + to_string(i) + "\":" + to_string(i);
+	wide += "}";
+	TestBinaryRoundTrip(wide);
+	TestBinaryRoundTrip("[\"" + string(40, 'x') + "\",\"" + string(300, 'y') + "\",\"" + string(70000, 'z') + "\"]");
+
+	/* the encodings are the shortest ones */
+	JsonValue v;
+	size_t size;
+	JsonParse(&v, "{\"a\":[1,-1,1.5,0.1,true,null]}");
+	char* data = JsonEncodeCbor(&v, &size);
+	ST_EXPECT_TRUE(BinaryString(data, size) == string("\xA1\x61\x61\x86\x01\x20\xFA\x3F\xC0\x00\x00"
+		"\xFB\x3F\xB9\x99\x99\x99\x99\x99\x9A\xF5\xF6", 22));
+	free(data);
+	data = JsonEncodeMsgPack(&v, &size);
+	ST_EXPECT_TRUE(BinaryString(data, size) == string("\x81\xA1\x61\x96\x01\xFF\xCA\x3F\xC0\x00\x00"
+		"\xCB\x3F\xB9\x99\x99\x99\x99\x99\x9A\xC3\xC0", 22));
+	free(data);
+	v.Free();
+
+	/* decoded objects are indexed like parsed ones, keys shared in a document */
+	JsonParse(&v, wide.c_str());
+	data = JsonEncodeCbor(&v, &size);
+	JsonDocument doc;
+	doc.Init();
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonDecodeCbor(&doc, data, size));
+	ST_EXPECT_EQ_DOUBLE(123.0, GetNumber(FindObjValue(&doc._root, "k123", 4)));
+	ST_EXPECT_TRUE(GetObjKey(&doc._root, 7) == FindDocumentKey(&doc, "k7", 2));
+	free(data);
+	doc.Free();
+	v.Free();
+
+	/* what other encoders write: half floats, tags, undefined, the longer length forms */
+	struct {
+		string _data;
+		const char* _json;
+	} cbor[] = {
+		{ string("\xF9\x3C\x00", 3), "1" },
+		{ string("\xF9\xC4\x00", 3), "-4" },
+		{ string("\xF9\x00\x01", 3), "5.960464477539063e-8" },
+		{ string("\xC1\x1A\x51\x4B\x67\xB0", 6), "1363896240" },
+		{ string("\xF7", 1), "null" },
+		{ string("\x98\x02\x18\x18\x3B\x00\x00\x00\x00\x00\x00\x00\x01", 13), "[24,-2]" },
+		{ string("\xB8\x01\x78\x01\x6B\x7A\x00\x00\x00\x00", 10), "{\"k\":\"\"}" },
+	};
+	for (size_t i = 0; i < sizeof(cbor) / sizeof(cbor[0]); ++i) {
+		ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonDecodeCbor(&v, cbor[i]._data.data(), cbor[i]._data.size()));
+		ST_EXPECT_TRUE(StringifyString(&v) == cbor[i]._json);
+		v.Free();
+	}
+	struct {
+		string _data;
+		const char* _json;
+	} msgpack[] = {
+		{ string("\xD0\x80", 2), "-128" },
+		{ string("\xD3\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFE", 9), "-2" },
+		{ string("\xCF\x00\x00\x00\x01\x00\x00\x00\x00", 9), "4294967296" },
+		{ string("\xDC\x00\x01\xD9\x01\x61", 6), "[\"a\"]" },
+		{ string("\xDF\x00\x00\x00\x01\xDA\x00\x01\x6B\xDB\x00\x00\x00\x00", 14), "{\"k\":\"\"}" },
+	};
+	for (size_t i = 0; i < sizeof(msgpack) / sizeof(msgpack[0]); ++i) {
+		ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonDecodeMsgPack(&v, msgpack[i]._data.data(), msgpack[i]._data.size()));
+		ST_EXPECT_TRUE(StringifyString(&v) == msgpack[i]._json);
+		v.Free();
+	}
+
+	/* indefinite lengths, byte strings, non-string keys, bin and ext, counts larger than the data, trailing bytes */
+	const string badCbor[] = { string("\x9F\xFF", 2), string("\x41\x00", 2), string("\xA1\x01\x02", 3), string("\xFF", 1),
+	                           string("\xF8\x20", 2), string("\x9B\x00\x00\x00\x01\x00\x00\x00\x00\x00", 10) };
+	for (size_t i = 0; i < sizeof(badCbor) / sizeof(badCbor[0]); ++i) {
+		ST_EXPECT_EQ_INT(RetType::PARSE_INVALID_BINARY, JsonDecodeCbor(&v, badCbor[i].data(), badCbor[i].size()));
+		ST_EXPECT_EQ_INT(JsonType::JSON_NULL, GetType(&v));
+	}
+	const string badMsgPack[] = { string("\xC4\x01\x00", 3), string("\xD4\x01\x00", 3), string("\xC1", 1),
+	                              string("\x81\x01\x02", 3), string("\xDD\xFF\xFF\xFF\xFF\x00", 6) };
+	for (size_t i = 0; i < sizeof(badMsgPack) / sizeof(badMsgPack[0]); ++i) {
+		ST_EXPECT_EQ_INT(RetType::PARSE_INVALID_BINARY, JsonDecodeMsgPack(&v, badMsgPack[i].data(), badMsgPack[i].size()));
+		ST_EXPECT_EQ_INT(JsonType::JSON_NULL, GetType(&v));
+	}
+	ST_EXPECT_EQ_INT(RetType::PARSE_ROOT_NOT_SINGULAR, JsonDecodeCbor(&v, "\x01\x02", 2));
+	ST_EXPECT_EQ_INT(RetType::PARSE_ROOT_NOT_SINGULAR, JsonDecodeMsgPack(&v, "\x01\x02", 2));
+	/* a failure deep inside frees what was decoded before it */
+	ST_EXPECT_EQ_INT(RetType::PARSE_INVALID_BINARY, JsonDecodeCbor(&v, "\x82\x6E" "abcdefghijklmn" "\x41", 17));
+	ST_EXPECT_EQ_INT(JsonType::JSON_NULL, GetType(&v));
+}
+
+/* the frozen tree holds what the tree held, and finds every key the tree finds */
+static bool SameFrozen(const JsonValue* v, const JsonFrozenValue* f) {
+	if (GetType(v) != GetType(f))
+		return false;
+	switch (GetType(v)) {
+		case JsonType::JSON_NUMBER: return GetNumber(v) == GetNumber(f);
+		case JsonType::JSON_STRING:
+			return GetStringSize(v) == GetStringSize(f) && memcmp(GetString(v), GetString(f), GetStringSize(v)) == 0 &&
+				GetString(f)[GetStringSize(f)] == '\0';
+		case JsonType::JSON_ARRAY:
+			if (GetArraySize(v) != GetArraySize(f))
+				return false;
+			for (size_t i = 0; i < GetArraySize(v); ++i)
+				if (!SameFrozen(GetArrayElement(v, i), GetArrayElement(f, i)))
+					return false;
+			return true;
+		case JsonType::JSON_OBJECT:
+			if (GetObjSize(v) != GetObjSize(f))
+				return false;
+			for (size_t i = 0; i < GetObjSize(v); ++i) {
+				if (GetObjKeySize(v, i) != GetObjKeySize(f, i) ||
+					memcmp(GetObjKey(v, i), GetObjKey(f, i), GetObjKeySize(v, i) + 1) != 0 ||
+					FindObjIndex(v, GetObjKey(v, i), GetObjKeySize(v, i)) != FindObjIndex(f, GetObjKey(f, i), GetObjKeySize(f, i)) ||
+					!SameFrozen(GetObjValue(v, i), GetObjValue(f, i)))
+					return false;
+			}
+			return true;
+		default: return true;
+	}
+}
+
+static void TestFreeze() {
+	string json = "{\"n\":[0,-1.5,1e300],\"s\":[\"\",\"short\",\"a string longer than a short one\",\"a\\u0000b\"],"
+	              "\"b\":[true,false,null],\"e\":[{},[]],\"dup\":1,\"dup\":2,\"wide\":{";
+	for (size_t i = 0; i < 200; ++i)
+		json += (i ? ",\"k" : "\"k") + to_string(i) + "\":[" + to_string(i) + "]";
+	json += "},\"mid\":{";
+	for (size_t i = 0; i < 20; ++i)
+		json += (i ? ",\"m" : "\"m") + to_string(i) + "\":" + to_string(i);
+	json += "}}";
+	JsonValue v;
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&v, json.c_str()));
+	/* members added after parsing, in a block with room to spare */
+	SetNumber(SetObjectValue(GetObjValue(&v, 7), "added", 5), 42);
+
+	size_t size;
+	char* image = JsonFreeze(&v, &size);
+	ST_EXPECT_EQ_SIZE_T(0, size % 8);
+	const JsonFrozenValue* root = JsonFrozenRoot(image, size);
+	ST_EXPECT_TRUE(root != nullptr);
+	ST_EXPECT_TRUE(SameFrozen(&v, root));
+	ST_EXPECT_EQ_DOUBLE(123.0, GetNumber(GetArrayElement(FindObjValue(FindObjValue(root, "wide", 4), "k123", 4), 0)));
+	ST_EXPECT_EQ_DOUBLE(42.0, GetNumber(FindObjValue(FindObjValue(root, "mid", 3), "added", 5)));
+	ST_EXPECT_EQ_DOUBLE(1.0, GetNumber(FindObjValue(root, "dup", 3)));
+	ST_EXPECT_TRUE(FindObjValue(FindObjValue(root, "wide", 4), "k200", 4) == nullptr);
+	ST_EXPECT_TRUE(FindObjValue(root, "x", 1) == nullptr);
+
+	/* nothing in it points anywhere: a copy elsewhere reads the same, and so does the file mapped back */
+	char* moved = static_cast<char*>(malloc(size));
+	memcpy(moved, image, size);
+	free(image);
+	ST_EXPECT_TRUE(SameFrozen(&v, JsonFrozenRoot(moved, size)));
+	const char* path = "st_json_test_file.frozen";
+	ST_EXPECT_TRUE(JsonFreezeFile(&v, path));
+	JsonMappedFile file;
+	ST_EXPECT_TRUE(file.Open(path));
+	ST_EXPECT_EQ_SIZE_T(size, file._size);
+	ST_EXPECT_TRUE(memcmp(file._data, moved, size) == 0);
+	ST_EXPECT_TRUE(file._size == size && SameFrozen(&v, JsonFrozenRoot(file._data, file._size)));
+	file.Close();
+	remove(path);
+
+	/* headers that are not one */
+	ST_EXPECT_TRUE(JsonFrozenRoot(moved, size - 8) == nullptr);
+	ST_EXPECT_TRUE(JsonFrozenRoot(moved, 16) == nullptr);
+	ST_EXPECT_TRUE(JsonFrozenRoot("", 0) == nullptr);
+	moved[8] ^= 0xFF;
+	ST_EXPECT_TRUE(JsonFrozenRoot(moved, size) == nullptr);
+	free(moved);
+	v.Free();
+
+	/* a scalar root lives in the header */
+	JsonParse(&v, "\"a string longer than a short one\"");
+	image = JsonFreeze(&v, &size);
+	ST_EXPECT_TRUE(SameFrozen(&v, JsonFrozenRoot(image, size)));
+	free(image);
+	v.Free();
+}
+
+static void TestStats() {
+	const char* json = "{\"a\":[1,\"x\\n\",true,null],\"b\":{\"c\":\"\\u00e9\"}}";
+	JsonStats stats;
+	JsonValue v;
+	stats.Init();
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&v, json, strlen(json), &stats));
+	ST_EXPECT_EQ_SIZE_T(2, GetObjSize(&v));
+#ifdef ST_JSON_STATS
+	ST_EXPECT_EQ_SIZE_T(strlen(json), stats._bytes);
+	ST_EXPECT_EQ_SIZE_T(2, stats._nodes[static_cast<size_t>(JsonType::JSON_OBJECT)]);
+	ST_EXPECT_EQ_SIZE_T(1, stats._nodes[static_cast<size_t>(JsonType::JSON_ARRAY)]);
+	ST_EXPECT_EQ_SIZE_T(2, stats._nodes[static_cast<size_t>(JsonType::JSON_STRING)]);
+	ST_EXPECT_EQ_SIZE_T(1, stats._nodes[static_cast<size_t>(JsonType::JSON_NUMBER)]);
+	ST_EXPECT_EQ_SIZE_T(1, stats._nodes[static_cast<size_t>(JsonType::JSON_TRUE)]);
+	ST_EXPECT_EQ_SIZE_T(0, stats._nodes[static_cast<size_t>(JsonType::JSON_FALSE)]);
+	ST_EXPECT_EQ_SIZE_T(1, stats._nodes[static_cast<size_t>(JsonType::JSON_NULL)]);
+	/* keys a, b, c, then "x\n" and the two bytes of the e acute, from \n and \u00e9 */
+	ST_EXPECT_EQ_SIZE_T(7, stats._stringBytes);
+	ST_EXPECT_EQ_SIZE_T(8, stats._escapedBytes);
+	ST_EXPECT_EQ_SIZE_T(2, stats._maxDepth);
+	ST_EXPECT_TRUE(stats._allocs >= 3);
+	ST_EXPECT_TRUE(stats._allocBytes >= 3 * 2 * sizeof(JsonValue));
+	ST_EXPECT_TRUE(stats._stackHighWater >= 4 * sizeof(JsonValue));
+
+	/* a stringify adds to the same collector */
+	size_t length;
+	JsonStats parsed = stats;
+	char* out        = JsonStringify(&v, &length, &stats);
+	ST_EXPECT_TRUE(string(out) == "{\"a\":[1,\"x\\n\",true,null],\"b\":{\"c\":\"\xC3\xA9\"}}");
+	ST_EXPECT_EQ_SIZE_T(parsed._bytes + length, stats._bytes);
+	ST_EXPECT_EQ_SIZE_T(4, stats._nodes[static_cast<size_t>(JsonType::JSON_OBJECT)]);
+	ST_EXPECT_EQ_SIZE_T(14, stats._stringBytes);
+	ST_EXPECT_EQ_SIZE_T(10, stats._escapedBytes);
+	ST_EXPECT_EQ_SIZE_T(2, stats._maxDepth);
+	ST_EXPECT_TRUE(stats._allocs > parsed._allocs);
+	free(out);
+	v.Free();
+
+	/* a failed parse reports how far it read and no nodes */
+	JsonDocument doc;
+	doc.Init();
+	stats.Init();
+	ST_EXPECT_EQ_INT(RetType::PARSE_MISSING_COMMA_OR_SQUARE_BRACKET, JsonParse(&doc, "[1,[2]", 6, &stats));
+	ST_EXPECT_EQ_SIZE_T(6, stats._bytes);
+	ST_EXPECT_EQ_SIZE_T(0, stats._nodes[static_cast<size_t>(JsonType::JSON_NUMBER)]);
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&doc, json, strlen(json), &stats));
+	ST_EXPECT_EQ_SIZE_T(6 + strlen(json), stats._bytes);
+	ST_EXPECT_EQ_SIZE_T(2, stats._nodes[static_cast<size_t>(JsonType::JSON_STRING)]);
+	doc.Free();
+#else
+	/* built without ST_JSON_STATS the collector is left alone */
+	ST_EXPECT_EQ_SIZE_T(0, stats._bytes);
+	ST_EXPECT_EQ_SIZE_T(0, stats._allocs);
+	char* out = JsonStringify(&v, nullptr, &stats);
+	ST_EXPECT_TRUE(string(out) == "{\"a\":[1,\"x\\n\",true,null],\"b\":{\"c\":\"\xC3\xA9\"}}");
+	ST_EXPECT_EQ_SIZE_T(0, stats._bytes);
+	free(out);
+	v.Free();
+#endif
+}
+
+/* hands out heap blocks and counts them, so a block freed elsewhere or never freed shows */
+struct CountingPolicy {
+	std::atomic<size_t> _allocs, _live; /* JsonParseLines calls from its workers */
+
+	CountingPolicy() : _allocs(0), _live(0) {}
+
+	void* Malloc(size_t size) {
+		++_allocs;
+		++_live;
+		return malloc(size);
+	}
+
+	void* Realloc(void* ptr, size_t size) {
+		++_allocs;
+		return realloc(ptr, size);
+	}
+
+	void Free(void* ptr) {
+		--_live;
+		free(ptr);
+	}
+};
+
+static void TestAllocator() {
+	CountingPolicy policy;
+	JsonAllocator allocator = MakeJsonAllocator(&policy);
+	string json = "{\"name\":\"a string longer than a short one\",\"list\":[1,\"x\",[],{}],\"wide\":{";
+	for (size_t i = 0; i < 20; ++i)
+		json += (i ? ",\"k" : "\"k") + to_string(i) + "\":" + to_string(i);
+	json += "}}";
+	JsonValue v;
+	size_t allocs = policy._allocs;
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&v, json.c_str(), json.size(), &allocator));
+	ST_EXPECT_TRUE(policy._allocs > allocs);
+	ST_EXPECT_TRUE(policy._live > 0);
+	ST_EXPECT_TRUE((v._flags & JSON_VALUE_ALLOCATED) != 0);
+	ST_EXPECT_EQ_DOUBLE(7.0, GetNumber(FindObjValue(FindObjValue(&v, "wide", 4), "k7", 2)));
+	ST_EXPECT_EQ_C_STR("a string longer than a short one", GetString(FindObjValue(&v, "name", 4)), 32);
+
+	/* the text from the allocator goes back to it */
+	size_t length;
+	size_t live = policy._live;
+	char* out   = JsonStringify(&v, &length, &allocator);
+	ST_EXPECT_TRUE(string(out, length) == json);
+	ST_EXPECT_EQ_SIZE_T(live + 1, policy._live);
+	allocator._free(allocator._user, out);
+
+	/* edits stay with the allocator of what they replace or grow, new keys too */
+	JsonValue* added = SetObjectValue(&v, "added", 5);
+	ST_EXPECT_TRUE(GetAllocator(added) == nullptr);
+	SetString(added, "another string longer than short", 32, GetAllocator(&v));
+	ST_EXPECT_TRUE(GetAllocator(added) == &allocator);
+	SetNumber(PushBackArrayElement(FindObjValue(&v, "list", 4)), 5);
+	SetString(FindObjValue(&v, "name", 4), "replaced by a string from the same allocator", 44);
+	ST_EXPECT_TRUE(GetAllocator(FindObjValue(&v, "name", 4)) == &allocator);
+	RemoveObjectValue(FindObjValue(&v, "wide", 4), 3);
+	ST_EXPECT_EQ_SIZE_T(4, GetObjSize(&v));
+	ST_EXPECT_TRUE((v._flags & JSON_VALUE_ALLOCATED) != 0);
+	ST_EXPECT_EQ_SIZE_T(5, GetArraySize(FindObjValue(&v, "list", 4)));
+	JsonValue copy;
+	copy.Init();
+	JsonCopy(&copy, &v, &allocator);
+	ST_EXPECT_TRUE(GetAllocator(&copy) == &allocator);
+	v.Free();
+	ST_EXPECT_EQ_SIZE_T(4, GetObjSize(&copy));
+	ST_EXPECT_EQ_C_STR("another string longer than short", GetString(FindObjValue(&copy, "added", 5)), 32);
+
+	/* the other parsers, the encoders and the writer give back all they take */
+	allocs = policy._allocs;
+	size_t size;
+	char* data = JsonEncodeCbor(&copy, &size, &allocator);
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonDecodeCbor(&v, data, size, &allocator));
+	ST_EXPECT_TRUE(GetAllocator(&v) == &allocator);
+	allocator._free(allocator._user, data);
+	v.Free();
+	data = JsonEncodeMsgPack(&copy, &size, &allocator);
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonDecodeMsgPack(&v, data, size, &allocator));
+	allocator._free(allocator._user, data);
+	v.Free();
+	data = JsonFreeze(&copy, &size, &allocator);
+	ST_EXPECT_EQ_DOUBLE(7.0, GetNumber(FindObjValue(FindObjValue(JsonFrozenRoot(data, size), "wide", 4), "k7", 2)));
+	allocator._free(allocator._user, data);
+	copy.Free();
+	ST_EXPECT_EQ_SIZE_T(0, policy._live);
+
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseIndexed(&v, json.c_str(), json.size(), 2, &allocator));
+	ST_EXPECT_TRUE(GetAllocator(&v) == &allocator);
+	v.Free();
+	string insitu = json;
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseInsitu(&v, &insitu[0], insitu.size(), &allocator));
+	v.Free();
+	JsonPushParser parser;
+	parser.Init(&v, &allocator);
+	parser.Feed(json.c_str(), json.size() / 2);
+	parser.Feed(json.c_str() + json.size() / 2, json.size() - json.size() / 2);
+	ST_EXPECT_EQ_INT(JsonPushStatus::PUSH_DONE, parser.Finish());
+	parser.Free();
+	ST_EXPECT_TRUE(GetAllocator(&v) == &allocator);
+	v.Free();
+	ST_EXPECT_EQ_SIZE_T(0, policy._live);
+
+	JsonLazyDocument lazy;
+	lazy.Init(&allocator);
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseLazy(&lazy, json.c_str(), json.size()));
+	ST_EXPECT_EQ_DOUBLE(7.0, GetNumber(GetLazyValue(&lazy, FindLazyObjValue(&lazy, FindLazyObjValue(&lazy, GetLazyRoot(&lazy), "wide", 4), "k7", 2))));
+	lazy.Free();
+	const char* paths[] = { "/wide/k7", "/list/*" };
+	JsonPathSet set;
+	JsonProjection proj;
+	set.Init(&allocator);
+	proj.Init(&allocator);
+	ST_EXPECT_TRUE(JsonCompilePaths(&set, paths, 2));
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseProjected(&proj, &set, json.c_str(), json.size()));
+	ST_EXPECT_EQ_SIZE_T(5, GetMatchCount(&proj));
+	proj.Free();
+	set.Free();
+	ST_EXPECT_EQ_SIZE_T(0, policy._live);
+
+	string written;
+	JsonWriter writer;
+	writer.Init(AppendSink, &written, &allocator);
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseSax(&writer, json.c_str(), json.size(), &allocator));
+	writer.Flush();
+	writer.Free();
+	ST_EXPECT_TRUE(written == json);
+	BindTag tag;
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseBound(&tag, "{\"name\":\"t\",\"weight\":2}", 23, &allocator));
+	ST_EXPECT_TRUE(tag.name == "t");
+	string lines = MakeLines(20000);
+	LinesState state = { 0, 0, 0, 0, static_cast<size_t>(-1) };
+	ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParseLines(lines.data(), lines.size(), 2, CheckLine, &state, &allocator));
+	ST_EXPECT_EQ_SIZE_T(0, state._mismatches);
+	ST_EXPECT_TRUE(policy._allocs > allocs);
+	ST_EXPECT_EQ_SIZE_T(0, policy._live);
+
+	/* nothing is kept from a failed parse */
+	const char* bad = "[\"a string longer than a short one\",{\"k\":[1 2]}]";
+	ST_EXPECT_EQ_INT(RetType::PARSE_MISSING_COMMA_OR_SQUARE_BRACKET, JsonParse(&v, bad, strlen(bad), &allocator));
+	ST_EXPECT_EQ_SIZE_T(0, policy._live);
+
+	/* a document takes its arena, keys and stacks from the allocator and gives them back when freed */
+	allocs = policy._allocs;
+	{
+		Document doc(&allocator);
+		ST_EXPECT_EQ_INT(RetType::PARSE_OK, doc.Parse(json.c_str(), json.size()));
+		ST_EXPECT_TRUE(policy._allocs > allocs);
+		ST_EXPECT_TRUE(policy._live > 0);
+		ST_EXPECT_TRUE((doc.Root()->_flags & JSON_VALUE_BORROWED) != 0);
+		Document copied = doc.DeepCopy();
+		Document moved(std::move(doc));
+		ST_EXPECT_EQ_INT(RetType::PARSE_OK, doc.Parse("[1,2]"));
+		ST_EXPECT_EQ_DOUBLE(19.0, GetNumber(FindObjValue(FindObjValue(copied.Root(), "wide", 4), "k19", 3)));
+		ST_EXPECT_EQ_DOUBLE(19.0, GetNumber(FindObjValue(FindObjValue(moved.Root(), "wide", 4), "k19", 3)));
+	}
+	ST_EXPECT_EQ_SIZE_T(0, policy._live);
+}
+
+static void TestStringifyNumber() {
+	TEST_ROUNDTRIP("0");
+	TEST_ROUNDTRIP("-0");
+	TEST_ROUNDTRIP("1");
+	TEST_ROUNDTRIP("-1");
+	TEST_ROUNDTRIP("1.5");
+	TEST_ROUNDTRIP("-1.5");
+	TEST_ROUNDTRIP("3.25");
+	TEST_ROUNDTRIP("0.1");
+	TEST_ROUNDTRIP("100123");
+	TEST_ROUNDTRIP("0.000001");
+	TEST_ROUNDTRIP("1e-7");
+	TEST_ROUNDTRIP("1e+21");
+	TEST_ROUNDTRIP("1.234e+25");
+	TEST_ROUNDTRIP("1.234e-10");
+	TEST_ROUNDTRIP("123456789012345680");
+
+	TEST_ROUNDTRIP("1.0000000000000002"); /* the smallest number > 1 */
+	TEST_ROUNDTRIP("5e-324");             /* minimum denormal */
+	TEST_ROUNDTRIP("-5e-324");
+	TEST_ROUNDTRIP("2.225073858507201e-308"); /* Max subnormal double */
+	TEST_ROUNDTRIP("-2.225073858507201e-308");
+	TEST_ROUNDTRIP("2.2250738585072014e-308"); /* Min normal positive double */
+	TEST_ROUNDTRIP("-2.2250738585072014e-308");
+	TEST_ROUNDTRIP("1.7976931348623157e+308"); /* Max double */
+	TEST_ROUNDTRIP("-1.7976931348623157e+308");
+	TEST_ROUNDTRIP("[0.1,0.2,0.30000000000000004]");
+
+	{
+		/* every double must come back unchanged */
+		static const double values[] = { 0.3, 2.0 / 3.0, 1e23, 9007199254740993.0, 4.9406564584124654e-324, 1e-300 * 1e-10 };
+		for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+			JsonValue v, v2;
+			v.Init();
+			v2.Init();
+			SetNumber(&v, values[i]);
+			char* json = JsonStringify(&v, nullptr);
+			ST_EXPECT_EQ_INT(RetType::PARSE_OK, JsonParse(&v2, json));
+			ST_EXPECT_EQ_DOUBLE(values[i], GetNumber(&v2));
+			free(json);
+		}
+	}
+}
+
+/* a special byte at every position of strings long enough to span several scanned blocks */
+static void TestStringifyEscape() {
+	const char specials[] = { '"', '\\', '\n', '\x01', '\x1F', '\0' };
+	const char* escapes[] = { "\\\"", "\\\\", "\\n", "\\u0001", "\\u001F", "\\u0000" };
+	for (size_t size = 1; size <= 70; size += 3) {
+		for (size_t at = 0; at < size; ++at) {
+			string text(size, 'x');
+			text[at] = specials[(size + at) % 6];
+			string expect = "\"" + string(at, 'x') + escapes[(size + at) % 6] + string(size - at - 1, 'x') + "\"";
+			JsonValue v;
+			v.Init();
+			SetString(&v, text.data(), text.size());
+			ST_EXPECT_TRUE(StringifyString(&v) == expect);
+			v.Free();
+		}
+	}
+}
+
 static void TestStringify() {
 	JsonValue v;
 	JsonValue* temp=nullptr;
@@ -299,12 +1983,14 @@ static void TestStringify() {
 
 	v._type=JsonType::JSON_ARRAY;
 	v._arrData=(JsonValue*)malloc(2*sizeof(JsonValue));
-	v._arrSize=2;
+	v.SetSize(2);
 
 	temp=&v._arrData[0];
+	temp->Init();
 	SetNumber(temp,125);
 
 	temp=&v._arrData[1];
+	temp->Init();
 	SetBoolean(temp, true);
 	
 	str=JsonStringify(&v,nullptr);
@@ -328,6 +2014,7 @@ int main() {
 	TestParseMissingQuotationMark();
 	TestParseInValidValue();
 	TestParseString();
+	TestParseWhitespace();
 	TestAccessBoolean();
 	TestInvalidStringEscape();
 	TestInvalidStringChar();
@@ -335,7 +2022,32 @@ int main() {
 	TestParseInvalidUnicodeSurrogate();
 	 TestParseArray();
 	TestParseObject();
+	TestParseDocument();
+	TestParseInsitu();
+	TestParseLength();
+	TestParseFile();
+	TestParseSax();
+	TestPushParser();
+	TestParseLines();
+	TestParseIndexed();
+	TestParseLazy();
+	TestParseProjected();
+	TestFindObj();
+	TestKeyIntern();
+	TestShortString();
+	TestWriter();
+	TestAccessArray();
+	TestAccessObject();
+	TestValue();
+	TestDocument();
+	TestBind();
+	TestBinary();
+	TestFreeze();
+	TestStats();
+	TestAllocator();
 	TestStringify();
+	TestStringifyEscape();
+	TestStringifyNumber();
 	ST_LOG_STAT();
 
 	return 0;